@@ -16,10 +16,30 @@
 **         Code has been modified in order to be compatible with Microchip PIC MCUs.
 **************************************************************************/
 
-#include <p18f2553.h>
+#include "hal.h"
 #include "MM5450.h"
+#include "bench.h"
 #include "macros.h"
-#include <timers.h>
+
+/* 
+**--------------------------------------------------------------------------- 
+** Abstract: Double buffered shift-out. The main loop writes the back buffer and commits it, the low
+**           priority Timer2 interrupt (MM5450_isr) takes it as front buffer and clocks it out, one
+**           clock edge per interrupt. Only the ISR changes mm_front, and it never runs between
+**           MM5450_back() and MM5450_commit() because TMR2IE is off meanwhile.
+**           Doble buffer: el bucle principal escriu el buffer de darrera i la interrupcio l'envia
+**--------------------------------------------------------------------------- 
+*/ 
+
+static uint8_t mm_buf[2][arrayLen];	// front (being sent) and back (written by the main loop)
+static volatile uint8_t mm_front;	// index of the front buffer
+static volatile uint8_t mm_ready;	// back buffer committed, not taken by the ISR yet
+static volatile uint8_t mm_busy;	// transfer in progress (written by the ISR)
+static uint8_t mm_clock;		// clock pin is high (ISR only)
+static uint8_t mm_nbits;		// bits clocked in, start bit included (ISR only)
+static uint8_t mm_last[arrayLen];	// last image committed (main loop only)
+uint16_t MM5450_transfers;		// images committed by MM5450_update()
+uint16_t MM5450_skipped;		// MM5450_update() calls with the same image, not sent
 
 /* 
 **--------------------------------------------------------------------------- 
@@ -40,101 +60,158 @@ void MM5450_init(void)
 	MMData_dir_outp();
 	MMData_passive();
 
+	// Shift-out on the Timer2 interrupt (low priority), enabled by MM5450_commit()
+	mm_front = 0;
+	mm_ready = 0;
+	mm_busy = 0;
+	mm_clock = 0;
+	MM5450_transfers = 0;
+	MM5450_skipped = 0;
+	PIE1bits.TMR2IE = 0;
+	IPR1bits.TMR2IP = 0;
+
 }
 
 /* 
 **--------------------------------------------------------------------------- 
-** Abstract: This 2 functions wait for 20 and 50 us 
-**           Aquestes 2 funcions esperen durant 20 i 50 us
+** Abstract: Back buffer of the display. The ISR is held off until MM5450_commit(), keep it short
+**           Buffer de darrera. La interrupcio queda aturada fins a MM5450_commit()
 ** Parameters: none
-** Returns: none
+** Returns: pointer to the back buffer (arrayLen bytes, same layout as ledArray)
 **--------------------------------------------------------------------------- 
 */ 
 
-void delay20us(void)
-{
-	timer3_start(T3CK1);
-	//while (timer3_get()<TIME20us){
-	while (ReadTimer3()<1){	// 1=1,5us 3=5us | old value 13=20us
-	}
-	timer3_stop();
-
+uint8_t *MM5450_back(void) {
+	PIE1bits.TMR2IE = 0;	// the ISR can not swap the buffers meanwhile
+	return mm_buf[mm_front ^ 1];
 }
 
-void delay50us(void)
-{
-	timer3_start(T3CK1);
-	//while (timer3_get()<TIME50us){
-	while (ReadTimer3()<3){   // 3=5us 8=12,5us  | old value 31=50us
-	}
-	timer3_stop();
+/* 
+**--------------------------------------------------------------------------- 
+** Abstract: Send the back buffer. If a transfer is in progress it is sent after it, if it is
+**           committed again before that only the last image is sent
+**           Envia el buffer de darrera, en acabar la transferencia en curs si n'hi ha
+** Parameters: none
+** Returns: none
+**--------------------------------------------------------------------------- 
+*/ 
 
+void MM5450_commit(void) {
+	mm_ready = 1;
+	PIE1bits.TMR2IE = 1;
 }
 
 /* 
 **--------------------------------------------------------------------------- 
-** Abstract: Subroutine that sends all of the DATABITS to the chip. It begins by first sending the startbit, then it
-**           sends all the bits in each byte of the ledArray.
-**           Subrutina que envia tots els DATABITS al chip MM5450. Primer envia l'Start of Frame i desprs la resta de bits del ledArray
+** Abstract: Copy a whole ledArray on the back buffer and send it. It does not wait for the transfer
+**           Copia el ledArray al buffer de darrera i l'envia. No espera
 ** Parameters: pointer ledArray
 ** Returns: none
 **--------------------------------------------------------------------------- 
 */ 
 
 void sendDatabits(uint8_t *ledArray_buf) {
+	uint8_t *back;
+	uint8_t i;
+	BENCH_MARK(mark)
 
-	uint8_t temp_byte;	// temporary byte store
-	uint8_t nbits;		// bit position counter within a byte
-	uint8_t MMbits;
-	uint8_t nbytes;
-
-	MMbits=35;
-	nbytes=5;
-
-	//Start of frame
-  	MMClock_passive();
-  	delay20us();
-	MMData_active();
-	delay20us();
-  	MMClock_active();
-	delay50us();
-  	delay50us();
-  	MMClock_passive();
-  	delay20us();
-	
+	BENCH_BEGIN(mark)
+	back = MM5450_back();
+	for(i = 0; i < arrayLen; i++) {
+		back[i] = ledArray_buf[i];
+		mm_last[i] = ledArray_buf[i];
+	}
+	MM5450_commit();
+	BENCH_END(BENCH_SEND, mark)
+}
 
-	do
-	{// end nbytes do loop
-		temp_byte=*ledArray_buf;	//store byte termporary
-		nbits=8;
-		delay50us();
-		//delay50us();
-		delay50us();
-		while(nbits-- && MMbits--)	//send 8 bits
-		{
-			if (temp_byte & 0x80){
-				MMData_active();
-				delay20us();
-				MMClock_active();
-	  			delay50us();
-	  			MMClock_passive();
-	  			delay20us();
-			}else{
-				MMData_passive();
-				delay20us();
-	  			MMClock_active();
-	  			delay50us();
-	  			MMClock_passive();
-	  			delay20us();
-			}
-			temp_byte <<= 1;	// next bit (desplaa els bits cap a la dreta) 0101 -->0010
-		}// end nbits while loop
-		++ledArray_buf;	// next byte from buffer
-	
-	} while(--nbytes);
-	MMData_passive();
-		
+/* 
+**--------------------------------------------------------------------------- 
+** Abstract: Send a complete ledArray only if it differs from the last one sent. MM5450_transfers and
+**           MM5450_skipped count both cases
+**           Envia el ledArray nomes si ha canviat des del darrer enviat
+** Parameters: pointer ledArray
+** Returns: 1 if it has been sent, 0 if it was the same image
+**--------------------------------------------------------------------------- 
+*/ 
+
+uint8_t MM5450_update(uint8_t *ledArray_buf) {
+	uint8_t i;
+
+	for(i = 0; i < arrayLen; i++) {
+		if(ledArray_buf[i] != mm_last[i]) {
+			sendDatabits(ledArray_buf);
+			++MM5450_transfers;
+			return 1;
+		}
+	}
+	++MM5450_skipped;
+	return 0;
+}
+
+/* 
+**--------------------------------------------------------------------------- 
+** Abstract: Part of the low priority ISR. Each Timer2 period (PWM period, 99us) moves the clock
+**           one edge: the data pin is set with the clock low and the bit is taken on the rising
+**           edge. First the start bit, then the 35 bits of the front buffer, MSB of byte 0 first.
+**           Part de la ISR de baixa prioritat, un flanc del rellotge a cada periode del Timer2
+** Parameters: none
+** Returns: none
+**--------------------------------------------------------------------------- 
+*/ 
+
+void MM5450_isr(void) {
+	uint8_t n;
+
+	if(!PIE1bits.TMR2IE || !PIR1bits.TMR2IF) return;
+	PIR1bits.TMR2IF = 0;
+
+	if(!mm_busy) {
+		if(!mm_ready) {
+			PIE1bits.TMR2IE = 0;	// nothing to send, MM5450_commit() enables it again
+			return;
+		}
+		mm_front ^= 1;		// the committed back buffer is the new front
+		mm_ready = 0;
+		mm_busy = 1;
+		mm_nbits = 0;
+		MMData_active();	// start bit, clock is low
+		return;
+	}
+
+	if(!mm_clock) {
+		MMClock_active();	// MM5450 takes the data pin
+		mm_clock = 1;
+		++mm_nbits;
+		return;
+	}
+
+	MMClock_passive();
+	mm_clock = 0;
+	if(mm_nbits == DATABITS) {	// start bit + 35 bits, outputs are latched
+		MMData_passive();
+		mm_busy = 0;
+		return;
+	}
+	n = mm_nbits - 1;		// next data bit
+	if(mm_buf[mm_front][n >> 3] & (0x80 >> (n & 7))) {
+		MMData_active();
+	}else{
+		MMData_passive();
+	}
+}
+
+/* 
+**--------------------------------------------------------------------------- 
+** Abstract: A transfer is in progress or waiting
+**           Hi ha una transferencia en curs o pendent
+** Parameters: none
+** Returns: 1 if busy, 0 if the MM5450 shows the last committed buffer
+**--------------------------------------------------------------------------- 
+*/ 
 
+uint8_t MM5450_busy(void) {
+	return mm_busy || mm_ready;
 }
 
 /* 
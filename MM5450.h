@@ -22,35 +22,7 @@
 
 #include "macros.h"
 
-//************************TRISx_Clock****************************************
-//PIC: Select TRISx for Clock
-#define MMClock_dir_outp()	TRISAbits.TRISA3=0
-//****************************************************************
-
-//**************************LATx_Clock**************************************
-//PIC: Put a bit of an Output at High.
-#define MMClock_active()	LATAbits.LATA3=1
- //*****************************************************************
-
-//**************************LATx_Clock**************************************
-//PIC: Put a bit of an Output at Low
-#define MMClock_passive()	LATAbits.LATA3=0
-//*****************************************************************
-
-//************************TRISx_Data****************************************
-//PIC: Select TRISx for Data
-#define MMData_dir_outp()	TRISAbits.TRISA2=0
-//****************************************************************
-
-//**************************LATx_Data**************************************
-//PIC: Put a bit of an Output at High.
-#define MMData_active()	LATAbits.LATA2=1
- //*****************************************************************
-
-//**************************LATx_Data**************************************
-//PIC: Put a bit of an Output at Low
-#define MMData_passive()	LATAbits.LATA2=0
-//*****************************************************************
+// MMClock_xxx and MMData_xxx pins are on the HAL (hal_pic18.h)
 
 #define BITSB 8                        // number of bits per byte, used for code clarity
 #define DATABITS 36                    // what we must send to the chip in order to control the lights (1+35)
@@ -59,19 +31,29 @@
 // The following line just computes the number of bytes we will need in the ledArray to hold all of
 // bits of data for the signal; it could be declared statically.
 #define arrayLen  (((DATABITS-1)/BITSB) + 1)
+
+// Segments of a 7 segment digit (bit 7 first) as a ledArray byte: bit 7 goes to the first output of
+// the byte (bit 0), same as setLight(i, bit 8-i) for i=1..8. Constant, computed by the compiler
+#define MM5450_GLYPH(seg)	((((seg)&0x80)>>7)|(((seg)&0x40)>>5)|(((seg)&0x20)>>3)|(((seg)&0x10)>>1)| \
+				 (((seg)&0x08)<<1)|(((seg)&0x04)<<3)|(((seg)&0x02)<<5)|(((seg)&0x01)<<7))
  
-#define TIME20us	us2cntT3CON8(10)
-#define TIME50us	us2cntT3CON8(25)
 
 typedef enum {                         // this exists primarily for code clarity
   OFF, ON
 } ledState;
 
+// Refreshes of the display sent and not sent because the image had not changed (MM5450_update)
+extern uint16_t MM5450_transfers;
+extern uint16_t MM5450_skipped;
+
 //Function Prototypes
 extern void MM5450_init(void);
-extern void delay20us(void);
-extern void delay50us(void);
 extern void sendDatabits(uint8_t *ledArray_buf);
+extern uint8_t MM5450_update(uint8_t *ledArray_buf);
+extern uint8_t *MM5450_back(void);
+extern void MM5450_commit(void);
+extern uint8_t MM5450_busy(void);
+extern void MM5450_isr(void);
 extern void toggleLight(uint8_t pin, uint8_t *ledArray_buf);
 extern void setLight(uint8_t pin, uint8_t val,uint8_t *ledArray_buf);
 extern void allOn(uint8_t *ledArray_buf);
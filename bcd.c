@@ -0,0 +1,126 @@
+/*************************************************************************
+**  HARLEY DAVIDSON Sportster 883/1200 - J1850 VPW Interface
+**  Released under GNU GENERAL PUBLIC LICENSE
+**  Main MCU: MICROCHIP PIC18F2553
+**  Homepage: www.momex.cat
+**  Contact: morales.xavier@momex.cat
+**
+**
+**  Revision History
+**  11/06/2016   XM  v1.00   Initial Release on Github
+**
+**
+**   NOTE: The value is split in 4 nibbles n3..n0 (4096*n3 + 256*n2 + 16*n1 + n0)
+**         and each power of 16 is written in decimal:
+**           4096 = 4*1000 + 0*100 + 9*10 + 6
+**            256 =          2*100 + 5*10 + 6
+**             16 =                  1*10 + 6
+**         so the units, tens, hundreds and thousands are small sums of the
+**         nibbles. The carries between them are divisions by 10 of values
+**         below 1029, done with BCD_DIV10 (hardware 8x8 multiplier).
+**************************************************************************/
+
+#include "bcd.h"
+#include "macros.h"
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Decimal digits of a 16 bit value
+**           Digits decimals d'un valor de 16 bits
+** Parameters: value, array of BCD_DIGITS bytes for the result (bcd[0]=units ... bcd[4]=ten thousands)
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+void bcd_split(uint16_t val, uint8_t *bcd)
+{
+	uint8_t n0, n1, n2, n3, q;
+	uint16_t sum;
+
+	n0 = (uint8_t)val & 0x0F;
+	n1 = (uint8_t)val >> 4;
+	n2 = (uint8_t)(val >> 8) & 0x0F;
+	n3 = (uint8_t)(val >> 8) >> 4;
+
+	sum = 6 * (uint16_t)(n3 + n2 + n1) + n0;	// units, up to 285
+	q = BCD_DIV10(sum);
+	bcd[0] = (uint8_t)sum - 10 * q;
+
+	sum = q + 9 * n3 + 5 * n2 + n1;		// tens, up to 253
+	q = BCD_DIV10(sum);
+	bcd[1] = (uint8_t)sum - 10 * q;
+
+	sum = q + 2 * n2;			// hundreds, up to 55
+	q = BCD_DIV10(sum);
+	bcd[2] = (uint8_t)sum - 10 * q;
+
+	sum = q + 4 * n3;			// thousands, up to 65
+	q = BCD_DIV10(sum);
+	bcd[3] = (uint8_t)sum - 10 * q;
+	bcd[4] = q;
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Switch OFF the leading zeros: a 0 is OFF when all the digits on its left are OFF (a thousands
+**           value of 10 is shown OFF too). The units are always shown
+**           Apaga els zeros de l'esquerra
+** Parameters: digits, index of the highest digit
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+static void bcd_blank(uint8_t *digits, uint8_t top)
+{
+	if(digits[top] == 0)
+	{
+		digits[top] = BCD_OFF;
+	}
+	while(--top && digits[top] == 0 && digits[top + 1] == BCD_OFF)
+	{
+		digits[top] = BCD_OFF;
+	}
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Digits of the rpm mode: thousands on digits[3], hundreds, tens rounded down to 0 or 5 and
+**           a fixed 0 on the units. Idle (651-849 rpm) is always shown as 800. Leading zeros are OFF
+**           Digits del mode rpm, arrodonit a 50 rpm i amb els zeros de l'esquerra apagats
+** Parameters: rpm, array of 4 digits (digits[0]=units)
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+void bcd_rpm(uint16_t rpm, uint8_t *digits)
+{
+	uint8_t bcd[BCD_DIGITS];
+
+	if(rpm > 650 && rpm < 850)	//rpms are not constant at idle, this will force rpm to be at 800 all the time while idling
+	{
+		rpm = 800;
+	}
+	bcd_split(rpm, bcd);
+	digits[3] = 10 * bcd[4] + bcd[3];	// rpm/1000
+	digits[2] = bcd[2];
+	digits[1] = (bcd[1] < 5) ? 0 : 5;
+	digits[0] = 0;
+	bcd_blank(digits, 3);
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Digits 2..0 of the speed and temperature modes (value modulo 1000), leading zeros OFF.
+**           digits[3] is not modified (it is the RPM bar on these modes)
+**           Digits 2..0 dels modes velocitat i temperatura, amb els zeros de l'esquerra apagats
+** Parameters: value, array of 4 digits (digits[0]=units)
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+void bcd_value(uint16_t val, uint8_t *digits)
+{
+	uint8_t bcd[BCD_DIGITS];
+
+	bcd_split(val, bcd);
+	digits[2] = bcd[2];
+	digits[1] = bcd[1];
+	digits[0] = bcd[0];
+	bcd_blank(digits, 2);
+}
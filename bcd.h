@@ -0,0 +1,36 @@
+/*************************************************************************
+**  HARLEY DAVIDSON Sportster 883/1200 - J1850 VPW Interface
+**  Released under GNU GENERAL PUBLIC LICENSE
+**  Main MCU: MICROCHIP PIC18F2553
+**  Homepage: www.momex.cat
+**  Contact: morales.xavier@momex.cat
+**
+**
+**  Revision History
+**  11/06/2016   XM  v1.00   Initial Release on Github
+**
+**
+**   NOTE: Binary to decimal digits for the 4x7 segment display without any
+**         division (the PIC18 has no divide instruction, each / or % of a
+**         16 bit value calls the C18 library). Checked against the division
+**         code for 0..65535 by host/bcd_bench.c
+**         Conversio a digits decimals sense divisions.
+**************************************************************************/
+
+#ifndef __BCD_H__	//if bcd.h has not been defined--> define it || if yes --> do nothing
+#define __BCD_H__
+
+#include "macros.h"
+
+#define BCD_DIGITS	5	// 65535 has 5 decimal digits
+#define BCD_OFF		10	// digit OFF, see display4x7seg on tacho.c
+
+// x/10 for 0 <= x < 1029 with one multiplication (205/2048 = 0.1001)
+#define BCD_DIV10(x)	((uint8_t)(((uint16_t)(x) * 205) >> 11))
+
+//Function Prototypes
+extern void bcd_split(uint16_t val, uint8_t *bcd);
+extern void bcd_rpm(uint16_t rpm, uint8_t *digits);
+extern void bcd_value(uint16_t val, uint8_t *digits);
+
+#endif // __BCD_H__
@@ -0,0 +1,244 @@
+/*************************************************************************
+**  HARLEY DAVIDSON Sportster 883/1200 - J1850 VPW Interface
+**  Released under GNU GENERAL PUBLIC LICENSE
+**  Main MCU: MICROCHIP PIC18F2553
+**  Homepage: www.momex.cat
+**  Contact: morales.xavier@momex.cat
+**
+**
+**  Revision History
+**  11/06/2016   XM  v1.00   Initial Release on Github
+**
+**
+**   NOTE: bench_begin() and bench_end() are called from both ISRs and from
+**         the main loop, the interrupt pragmas of main.c save .tmpdata on
+**         the benchmark build. The ISR cycles are kept on two counters,
+**         bench_high only written by the high priority ISR and bench_low
+**         by the low priority one. The context saving of the compiler is
+**         not seen by the probes.
+**************************************************************************/
+
+#include "hal.h"
+#include "usart_tx.h"
+#include "bench.h"
+#include "macros.h"
+
+#if BENCH
+
+#if !USART_LOG_BINARY
+#error "the results are a USART_LOG_BENCH record, set USART_LOG_BINARY to 1 in usart_tx.h"
+#endif
+
+typedef struct {
+	uint16_t runs;
+	uint16_t min;
+	uint16_t max;
+	uint32_t sum;
+} bench_probe;
+
+static bench_probe bench_probes[BENCH_PROBES];
+static volatile uint16_t bench_high;	// cycles of the high priority ISR so far
+static volatile uint16_t bench_low;	// cycles of the low priority ISR so far, high ones not included
+static uint16_t bench_empty;		// cycles of an empty probe
+static uint16_t bench_last_runs;	// BENCH_RX_EDGE runs at the last bench_task()
+static uint8_t bench_idle;		// bench_task() calls without bus activity
+static uint8_t bench_state;		// BENCH_RUN, BENCH_SENDING or BENCH_DONE
+static uint8_t bench_record[BENCH_RECORD_LEN];
+static bench_probe bench_copy[BENCH_PROBES];	// probes when the record is built, the ISRs go on counting
+
+#define BENCH_RUN	0	// waiting for frames and for the end of them
+#define BENCH_SENDING	1	// record given to usart_tx_send()
+#define BENCH_DONE	2	// record sent, bench_done() called
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Internal function, read a counter of an ISR (16 bits, two reads have to match)
+**           Funcio interna, llegeix un comptador d'una ISR
+** Parameters: counter
+** Returns: value
+**---------------------------------------------------------------------------
+*/
+static uint16_t bench_get(volatile uint16_t *counter)
+{
+	uint16_t value;
+
+	do
+	{
+		value = *counter;
+	} while(value != *counter);
+	return value;
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Start Timer3 on 1:1 (one count per instruction cycle) and clear the probes. The cycles
+**           of an empty probe are measured here, so it has to be called before the interrupts are
+**           enabled
+**           Engega el Timer3 a 1:1 i buida les mesures
+** Parameters: none
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+void bench_init(void)
+{
+	bench_mark m;
+	uint8_t i;
+
+	timer3_start(T3CK1);
+	bench_empty = 0;
+	bench_high = 0;
+	bench_low = 0;
+	bench_begin(&m);
+	bench_end(BENCH_REFRESH, &m);
+	bench_empty = bench_probes[BENCH_REFRESH].max;
+	for(i = 0; i < BENCH_PROBES; i++)
+	{
+		bench_probes[i].runs = 0;
+		bench_probes[i].min = 0xFFFF;
+		bench_probes[i].max = 0;
+		bench_probes[i].sum = 0;
+	}
+	bench_last_runs = 0;
+	bench_idle = 0;
+	bench_state = BENCH_RUN;
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Start of a probe
+**           Inici d'una mesura
+** Parameters: mark of the caller (local variable, BENCH_MARK)
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+void bench_begin(bench_mark *m)
+{
+	m->high = bench_get(&bench_high);
+	m->low = bench_get(&bench_low);
+	m->start = timer3_get();
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: End of a probe. The cycles of the ISRs in the middle and of the probe itself are taken
+**           out. The cycles of an ISR probe are added to its ISR counter, so they are taken out of
+**           the probes it has interrupted
+**           Final d'una mesura
+** Parameters: BENCH_xxx, mark given to bench_begin()
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+void bench_end(uint8_t probe, bench_mark *m)
+{
+	bench_probe *p;
+	uint16_t cycles;
+
+	cycles = timer3_get() - m->start;
+	cycles -= bench_get(&bench_high) - m->high;
+	if(probe != BENCH_ISR_LOW) cycles -= bench_get(&bench_low) - m->low;	// the high ISR never interrupts itself
+	cycles -= bench_empty;
+	if(cycles & 0x8000) cycles = 0;	// ISR that ended between the timer and the counter reads
+
+	if(probe == BENCH_ISR_HIGH) bench_high += cycles + bench_empty;
+	else if(probe == BENCH_ISR_LOW) bench_low += cycles + bench_empty;
+
+	p = &bench_probes[probe];
+	if(cycles < p->min) p->min = cycles;
+	if(cycles > p->max) p->max = cycles;
+	if(p->runs == 0xFFFF) return;	// the average stays on the first runs
+	++p->runs;
+	p->sum += cycles;
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Empty function, the gpsim script stops here once the record has been sent
+**           Funcio buida, punt d'aturada del guio de gpsim
+** Parameters: none
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+void bench_done(void)
+{
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Task of the main loop, every BENCH_MS. After some bus edges and BENCH_IDLE_MS without
+**           any, the results are sent as a USART_LOG_BENCH record and bench_done() is called. The
+**           probes go on counting, new frames start a new run
+**           Tasca del bucle principal. Envia els resultats quan el bus queda inactiu
+** Parameters: none
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+void bench_task(void)
+{
+	bench_probe *p;
+	uint8_t *rec;
+	uint16_t runs;
+	uint8_t i;
+
+	runs = bench_get((volatile uint16_t *)&bench_probes[BENCH_RX_EDGE].runs);	// bus activity
+	if(runs != bench_last_runs)
+	{
+		bench_last_runs = runs;
+		bench_idle = 0;
+		bench_state = BENCH_RUN;
+		return;
+	}
+	if(bench_state == BENCH_SENDING && !usart_tx_busy())
+	{
+		bench_state = BENCH_DONE;
+		bench_done();
+	}
+	if(bench_state != BENCH_RUN || runs == 0 || ++bench_idle < BENCH_IDLE_MS / BENCH_MS) return;
+	if(usart_tx_busy()) return;	// record of another module
+
+	INTCONbits.GIEL = 0;	// the low priority ISR is still measured, the high one is quiet without frames
+	for(i = 0; i < BENCH_PROBES; i++) bench_copy[i] = bench_probes[i];
+	INTCONbits.GIEL = 1;
+
+	rec = bench_record;
+	rec[0] = USART_LOG_BENCH;
+	rec[1] = BENCH_PROBES;
+	rec[2] = (uint8_t)bench_empty;
+	rec[3] = (uint8_t)(bench_empty >> 8);
+	rec += BENCH_RECORD_HEADER;
+	for(i = 0, p = bench_copy; i < BENCH_PROBES; i++, p++, rec += 8)
+	{
+		if(p->runs == 0) p->min = 0;
+		else p->sum /= p->runs;	// average
+		rec[0] = (uint8_t)p->runs;
+		rec[1] = (uint8_t)(p->runs >> 8);
+		rec[2] = (uint8_t)p->min;
+		rec[3] = (uint8_t)(p->min >> 8);
+		rec[4] = (uint8_t)p->sum;
+		rec[5] = (uint8_t)(p->sum >> 8);
+		rec[6] = (uint8_t)p->max;
+		rec[7] = (uint8_t)(p->max >> 8);
+	}
+	usart_tx_send(bench_record, BENCH_RECORD_LEN);
+	bench_state = BENCH_SENDING;
+}
+#else
+void bench_init(void)
+{
+}
+
+void bench_begin(bench_mark *m)
+{
+}
+
+void bench_end(uint8_t probe, bench_mark *m)
+{
+}
+
+void bench_task(void)
+{
+}
+
+void bench_done(void)
+{
+}
+#endif // BENCH
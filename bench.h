@@ -0,0 +1,83 @@
+/*************************************************************************
+**  HARLEY DAVIDSON Sportster 883/1200 - J1850 VPW Interface
+**  Released under GNU GENERAL PUBLIC LICENSE
+**  Main MCU: MICROCHIP PIC18F2553
+**  Homepage: www.momex.cat
+**  Contact: morales.xavier@momex.cat
+**
+**
+**  Revision History
+**  11/06/2016   XM  v1.00   Initial Release on Github
+**
+**
+**   NOTE: Benchmark build. With BENCH 1 the probes of the ISRs, of the
+**         receiver and of the display refresh count their instruction
+**         cycles with Timer3 (1:1, free running). The cycles of the ISRs
+**         that run in the middle of a probe are not counted on it. When
+**         the bus has been idle for BENCH_IDLE_MS after some frames the
+**         results are sent as a USART_LOG_BENCH record and bench_done()
+**         is called, the breakpoint of the gpsim run (host/vpw_stim.c).
+**         host/bench.sh builds it, runs it and compares the results with
+**         host/bench_baseline.txt.
+**         Mesura de cicles de les parts critiques del firmware.
+**************************************************************************/
+
+#ifndef __BENCH_H__	//if bench.h has not been defined--> define it || if yes --> do nothing
+#define __BENCH_H__
+
+#include "macros.h"
+
+// 1: benchmark build, Timer3 is used. It needs J1850_TX 0 (j1850_tx.h, Timer3 is the transmitter clock), so
+// DIAG 0 (diag.h, the requests need the transmitter), and USART_LOG_BINARY 1 (usart_tx.h, the results are a
+// record), all of them are the defaults. 0: normal build, the probes compile to nothing
+#ifndef BENCH	// host/bench.sh builds with -DBENCH=1
+#define BENCH	0
+#endif
+
+// probes, the ISRs first (their cycles are taken out of the probes they interrupt)
+#define BENCH_ISR_HIGH	0	// InterruptHandlerHigh, whole handler
+#define BENCH_ISR_LOW	1	// InterruptHandlerLow, without the high priority ISRs in the middle
+#define BENCH_ISRS	2
+#define BENCH_RX_EDGE	2	// j1850_rx_isr(), one bus edge or EOD
+#define BENCH_SEND	3	// sendDatabits(), copy and commit of a new image
+#define BENCH_REFRESH	4	// tacho_refresh(), one display refresh (digits, RPM bar and MM5450_update)
+#define BENCH_DECODE	5	// frame_dispatch(), decode and filters of one frame
+#define BENCH_PROBES	6
+
+#define BENCH_MS	100	// task period
+#define BENCH_IDLE_MS	500	// bus idle time that ends a run (end of the stimulus)
+
+// USART_LOG_BENCH record (usart_tx.h), 16 bit values low byte first:
+//   byte 0: record type (USART_LOG_BENCH)
+//   byte 1: number of probes (BENCH_PROBES)
+//   byte 2-3: cycles of an empty probe, already taken out of all the results
+//   byte 4-: 8 bytes per probe, in BENCH_xxx order: number of runs (stops at 0xFFFF), minimum,
+//            average and maximum instruction cycles
+#define BENCH_RECORD_HEADER	4
+#define BENCH_RECORD_LEN	(BENCH_RECORD_HEADER + 8 * BENCH_PROBES)
+
+// start of a probe: Timer3 and the ISR cycles counted so far
+typedef struct {
+	uint16_t start;
+	uint16_t high;
+	uint16_t low;
+} bench_mark;
+
+#if BENCH
+#define BENCH_MARK(m)	bench_mark m;
+#define BENCH_BEGIN(m)	bench_begin(&(m));
+#define BENCH_END(probe, m)	bench_end(probe, &(m));
+#else
+#define BENCH_MARK(m)
+#define BENCH_BEGIN(m)
+#define BENCH_END(probe, m)
+#endif
+
+//Function Prototypes
+extern void bench_init(void);
+extern void bench_begin(bench_mark *m);
+extern void bench_end(uint8_t probe, bench_mark *m);
+extern void bench_task(void);
+extern void bench_done(void);
+
+#endif // __BENCH_H__
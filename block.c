@@ -0,0 +1,286 @@
+/*************************************************************************
+**  HARLEY DAVIDSON Sportster 883/1200 - J1850 VPW Interface
+**  Released under GNU GENERAL PUBLIC LICENSE
+**  Main MCU: MICROCHIP PIC18F2553
+**  Homepage: www.momex.cat
+**  Contact: morales.xavier@momex.cat
+**
+**
+**  Revision History
+**  11/06/2016   XM  v1.00   Initial Release on Github
+**
+**
+**   NOTE: Everything runs on the main loop (block_frame from the frame
+**         handlers, block_task), the ISRs are not involved. A buffer of the
+**         pool is free, being filled by a transfer, waiting on the send
+**         queue or being sent by the USART TX interrupt (usart_tx_send),
+**         the records go out in the order they are finished.
+**         Tot s'executa al bucle principal.
+**************************************************************************/
+
+#include "usart_tx.h"
+#include "sched.h"
+#include "block.h"
+#include "macros.h"
+
+uint16_t block_done;
+uint16_t block_errors;
+uint16_t block_dropped;
+uint16_t block_bytes;
+
+#if BLOCK
+
+#define BLOCK_NONE	0xFF	// no buffer
+
+typedef struct {
+	uint8_t source;		// key of the transfer
+	uint8_t mode;
+	uint8_t active;		// transfer in progress
+	uint8_t seq;		// sequence number of the next frame
+	uint16_t left;		// data bytes still to come
+	uint16_t offset;	// position of the next data byte on the transfer
+	uint16_t last;		// sched_now() of the last frame (timeout)
+	uint8_t buf;		// buffer being filled
+} block_transfer;
+
+static block_transfer block_transfers[BLOCK_TRANSFERS];
+static uint8_t block_pool[BLOCK_BUFS][BLOCK_RECORD_LEN];	// records, data bytes after the header
+static uint8_t block_len[BLOCK_BUFS];		// data bytes of each buffer
+static uint8_t block_used[BLOCK_BUFS];		// buffer not free (filling, queued or being sent)
+static uint8_t block_queue[BLOCK_BUFS];	// finished buffers, in order
+static uint8_t block_queue_rd;
+static uint8_t block_queued;
+static uint8_t block_sending;			// buffer given to usart_tx_send(), BLOCK_NONE if none
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: No transfer in progress, all the buffers free and the counters cleared
+**           Cap transferencia en curs, tots els buffers lliures
+** Parameters: none
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+void block_init(void)
+{
+	uint8_t i;
+
+	for(i = 0; i < BLOCK_TRANSFERS; i++) block_transfers[i].active = 0;
+	for(i = 0; i < BLOCK_BUFS; i++) block_used[i] = 0;
+	block_queue_rd = 0;
+	block_queued = 0;
+	block_sending = BLOCK_NONE;
+	block_done = 0;
+	block_errors = 0;
+	block_dropped = 0;
+	block_bytes = 0;
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Internal function, take a free buffer of the pool for a transfer and write its record
+**           header, the data starts at the current position of the transfer
+**           Funcio interna, agafa un buffer lliure per una transferencia
+** Parameters: transfer
+** Returns: 1 if the transfer has a buffer, 0 if all of them are in use
+**---------------------------------------------------------------------------
+*/
+static uint8_t block_take(block_transfer *tr)
+{
+	uint8_t i;
+	uint8_t *rec;
+
+	for(i = 0; i < BLOCK_BUFS && block_used[i]; i++);
+	if(i == BLOCK_BUFS) return 0;
+	block_used[i] = 1;
+	block_len[i] = 0;
+	rec = block_pool[i];
+	rec[0] = USART_LOG_BLOCK;
+	rec[1] = tr->source;
+	rec[2] = tr->mode;
+	rec[4] = (uint8_t)tr->offset;
+	rec[5] = tr->offset >> 8;
+	tr->buf = i;
+	return 1;
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Internal function, put a finished buffer on the send queue with the status of its record
+**           Funcio interna, posa un buffer acabat a la cua d'enviament
+** Parameters: buffer, status of the record (BLOCK_xxx)
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+static void block_send(uint8_t buf, uint8_t status)
+{
+	block_pool[buf][3] = status;
+	block_queue[(block_queue_rd + block_queued) % BLOCK_BUFS] = buf;
+	++block_queued;		// never more than BLOCK_BUFS, each buffer is queued once
+	block_bytes += block_len[buf];
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Internal function, end a transfer, its last record is sent with the reason
+**           Funcio interna, acaba una transferencia
+** Parameters: transfer, status of its last record (BLOCK_DONE or an error)
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+static void block_end(block_transfer *tr, uint8_t status)
+{
+	block_send(tr->buf, status);
+	tr->active = 0;
+	if(status == BLOCK_DONE) ++block_done;
+	else ++block_errors;
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Frame of a block transfer, called by the frame handler of its header (see block.h for
+**           the format). A first frame (seq 0) starts a transfer of its source and mode, the next
+**           ones add their data if their sequence number is the expected one. A frame repeated by
+**           its node (the first one included) is ignored, a missing one ends the transfer with BLOCK_LOST
+**           Trama d'una transferencia de blocs. Afegeix les dades si la sequencia es la correcta
+** Parameters: Pointer to frame buffer, frame length (CRC included)
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+void block_frame(uint8_t *msg, uint8_t nbytes)
+{
+	block_transfer *tr, *idle;
+	uint8_t *data, *dst;
+	uint8_t i, n, seq, full;
+	uint16_t len;
+
+	if(nbytes < BLOCK_DATA + 1) return;
+	data = msg + BLOCK_DATA;
+	n = nbytes - BLOCK_DATA - 1;
+	seq = msg[BLOCK_SEQ];
+
+	idle = 0;
+	for(i = 0, tr = block_transfers; i < BLOCK_TRANSFERS; i++, tr++)
+	{
+		if(tr->active && tr->source == msg[2] && tr->mode == msg[3]) break;
+		if(!tr->active && !idle) idle = tr;
+	}
+	if(i == BLOCK_TRANSFERS) tr = 0;
+
+	if(seq == 0)		// first frame
+	{
+		if(n < 2) return;
+		len = ((uint16_t)data[0] << 8) | data[1];
+		if(tr && tr->seq == 1)		// repeated by its node if the transfer has not gone further
+		{
+			i = n - 2;
+			if(i > len) i = (uint8_t)len;
+			if(tr->offset == i && tr->left == len - i) return;
+		}
+		if(tr) block_end(tr, BLOCK_LOST);	// the previous one has not been finished
+		else tr = idle;
+		if(!tr)
+		{
+			++block_dropped;
+			return;
+		}
+		tr->source = msg[2];
+		tr->mode = msg[3];
+		tr->offset = 0;
+		if(!block_take(tr))
+		{
+			++block_dropped;
+			return;
+		}
+		tr->active = 1;
+		tr->left = len;
+		tr->seq = 0;
+		data += 2;
+		n -= 2;
+	}
+	else
+	{
+		if(!tr) return;		// its start has not been seen, or it has been given up
+		if(seq == (uint8_t)(tr->seq - 1) || (seq == 0xFF && tr->seq == 1)) return;	// repeated
+		if(seq != tr->seq)
+		{
+			block_end(tr, BLOCK_LOST);
+			return;
+		}
+	}
+	if(++tr->seq == 0) tr->seq = 1;
+	tr->last = sched_now();
+
+	if(n > tr->left) n = tr->left;		// padding of the last frame
+	tr->left -= n;
+	while(n)
+	{
+		if(block_len[tr->buf] == BLOCK_CHUNK)
+		{
+			full = tr->buf;
+			if(!block_take(tr))
+			{
+				block_len[full] = 0;	// its data is dropped, the record tells the PC where it was lost
+				block_end(tr, BLOCK_OVERFLOW);
+				return;
+			}
+			block_send(full, BLOCK_MORE);
+		}
+		dst = block_pool[tr->buf] + BLOCK_RECORD_HEADER + block_len[tr->buf];
+		i = BLOCK_CHUNK - block_len[tr->buf];
+		if(i > n) i = n;
+		block_len[tr->buf] += i;
+		tr->offset += i;
+		n -= i;
+		while(i--) *dst++ = *data++;
+	}
+	if(!tr->left) block_end(tr, BLOCK_DONE);
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Task of the main loop, every BLOCK_MS. Ends the transfers without frames for
+**           BLOCK_TIMEOUT_MS and gives the oldest finished buffer to the USART once the previous one
+**           has been sent
+**           Tasca del bucle principal. Temps d'espera de les transferencies i enviament al PC
+** Parameters: none
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+void block_task(void)
+{
+	block_transfer *tr;
+	uint16_t now;
+	uint8_t i, buf;
+
+	now = sched_now();
+	for(i = 0, tr = block_transfers; i < BLOCK_TRANSFERS; i++, tr++)
+	{
+		if(tr->active && (uint16_t)(now - tr->last) >= BLOCK_TIMEOUT_MS) block_end(tr, BLOCK_TIMEOUT);
+	}
+
+	if(block_sending != BLOCK_NONE)
+	{
+		if(usart_tx_busy()) return;	// still being sent (or a record of another module after it)
+		block_used[block_sending] = 0;
+		block_sending = BLOCK_NONE;
+	}
+	if(!block_queued) return;
+	buf = block_queue[block_queue_rd];
+	if(!usart_tx_send(block_pool[buf], BLOCK_RECORD_HEADER + block_len[buf])) return;	// record of another module
+	block_sending = buf;
+	block_queue_rd = (block_queue_rd + 1) % BLOCK_BUFS;
+	--block_queued;
+}
+#else
+void block_init(void)
+{
+}
+
+void block_frame(uint8_t *msg, uint8_t nbytes)
+{
+}
+
+void block_task(void)
+{
+}
+#endif // BLOCK
@@ -0,0 +1,81 @@
+/*************************************************************************
+**  HARLEY DAVIDSON Sportster 883/1200 - J1850 VPW Interface
+**  Released under GNU GENERAL PUBLIC LICENSE
+**  Main MCU: MICROCHIP PIC18F2553
+**  Homepage: www.momex.cat
+**  Contact: morales.xavier@momex.cat
+**
+**
+**  Revision History
+**  11/06/2016   XM  v1.00   Initial Release on Github
+**
+**
+**   NOTE: Reassembly of the block transfers of the ECM (memory reads,
+**         calibration tables, DTC lists), longer than the 12 bytes of a
+**         frame. The frames of a transfer are matched by their source and
+**         mode, up to BLOCK_TRANSFERS transfers at the same time, and their
+**         sequence number is followed: a lost frame or BLOCK_TIMEOUT_MS
+**         without frames ends the transfer. The data is never held whole,
+**         it goes into the buffers of a fixed pool, and each full buffer is
+**         sent to the PC as a USART_LOG_BLOCK record while the next one is
+**         being filled.
+**         Reconstruccio de les transferencies de blocs de l'ECM.
+**************************************************************************/
+
+#ifndef __BLOCK_H__	//if block.h has not been defined--> define it || if yes --> do nothing
+#define __BLOCK_H__
+
+#include "macros.h"
+
+// 1: block transfers sent to the PC (this module). 0: their frames are only on the frame log
+#ifndef BLOCK	// or -DBLOCK=0 on the compiler command line
+#define BLOCK	1
+#endif
+
+// Answers of the ECM to our tester (DIAG_TESTER, diag.h), one row of frame_table (tacho.c) per mode
+#define BLOCK_PRIO		0x6C	// priority/type of the answers (physical addressing)
+#define BLOCK_MODE_MEMORY	0x63	// answer to a read memory by address (0x23 + 0x40)
+#define BLOCK_MODE_DATA		0x7C	// answer to a read data block (0x3C + 0x40)
+
+// Frame of a block transfer: <prio> <target> <source> <mode> <seq> <data...> <crc>
+//   seq 0: first frame, data bytes 0-1 are the length of the transfer (high byte first), the rest is data
+//   seq 1, 2 ... 255, 1, 2 ...: next frames, 0 is never repeated. The data of the last frame after the
+//   length is padding
+#define BLOCK_SEQ	4	// position of the sequence number
+#define BLOCK_DATA	5	// position of the first data byte
+
+#define BLOCK_MS		5	// task period
+#define BLOCK_TIMEOUT_MS	200	// longest time between two frames of a transfer
+#define BLOCK_TRANSFERS		2	// transfers at the same time (different source or mode)
+#define BLOCK_BUFS		4	// buffers of the pool, at least one per transfer
+#define BLOCK_CHUNK		32	// data bytes per buffer (USART_LOG_BLOCK record)
+
+// USART_LOG_BLOCK record (usart_tx.h), one per buffer:
+//   byte 0: record type (USART_LOG_BLOCK)
+//   byte 1: source of the transfer
+//   byte 2: mode of the transfer
+//   byte 3: status, BLOCK_xxx below
+//   byte 4-5: position of the first data byte on the transfer, low byte first
+//   byte 6-: data bytes (0-BLOCK_CHUNK)
+#define BLOCK_RECORD_HEADER	6
+#define BLOCK_RECORD_LEN	(BLOCK_RECORD_HEADER + BLOCK_CHUNK)
+
+// status of a record, the transfer goes on only with BLOCK_MORE
+#define BLOCK_MORE	0	// more records will come
+#define BLOCK_DONE	1	// last record, the transfer is complete
+#define BLOCK_LOST	2	// a frame has been lost (sequence) or a new transfer has started, the rest will not come
+#define BLOCK_TIMEOUT	3	// no frame for BLOCK_TIMEOUT_MS
+#define BLOCK_OVERFLOW	4	// no free buffer, the PC does not take the records fast enough. No data on this record
+
+// counters, cleared by block_init()
+extern uint16_t block_done;		// transfers complete
+extern uint16_t block_errors;		// transfers given up (BLOCK_LOST, BLOCK_TIMEOUT or BLOCK_OVERFLOW)
+extern uint16_t block_dropped;		// transfers not started, all of them in progress or no free buffer
+extern uint16_t block_bytes;		// data bytes sent to the PC
+
+//Function Prototypes
+extern void block_init(void);
+extern void block_frame(uint8_t *msg, uint8_t nbytes);
+extern void block_task(void);
+
+#endif // __BLOCK_H__
@@ -0,0 +1,125 @@
+/*************************************************************************
+**  HARLEY DAVIDSON Sportster 883/1200 - J1850 VPW Interface
+**  Released under GNU GENERAL PUBLIC LICENSE
+**  Main MCU: MICROCHIP PIC18F2553
+**  Homepage: www.momex.cat
+**  Contact: morales.xavier@momex.cat
+**
+**
+**  Revision History
+**  11/06/2016   XM  v1.00   Initial Release on Github
+**
+**
+**   NOTE: Integrator debounce: each sample adds 1 (depressed) or takes 1
+**         (released) from a counter limited to 0..BUTTON_DEBOUNCE_MS. The
+**         state only changes when the counter reaches a limit, so bounces
+**         and short spikes never make an event.
+**************************************************************************/
+
+#include "hal.h"
+#include "button.h"
+#include "macros.h"
+
+#define QUEUE_MASK	(BUTTON_QUEUE_SIZE - 1)
+
+static uint8_t integrator;		// 0 (released) .. BUTTON_DEBOUNCE_MS (depressed)
+static uint8_t pressed;			// debounced state
+static uint16_t press_ms;		// time depressed, up to BUTTON_LONG_MS
+static uint8_t queue[BUTTON_QUEUE_SIZE];
+static volatile uint8_t queue_head;	// next event to be written by the ISR
+static volatile uint8_t queue_tail;	// next event to be read by the main loop
+volatile uint8_t button_lost;
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Switch released and queue empty. Has to be called before the tick is started
+**           Polsador deixat anar i cua buida
+** Parameters: none
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+void button_init(void)
+{
+	integrator = 0;
+	pressed = 0;
+	press_ms = 0;
+	queue_head = 0;
+	queue_tail = 0;
+	button_lost = 0;
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: ISR side. Queue an event, dropped if the queue is full
+**           Costat de la ISR. Posa un event a la cua
+** Parameters: event (BUTTON_xxx)
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+static void button_put(uint8_t event)
+{
+	uint8_t next;
+
+	next = (queue_head + 1) & QUEUE_MASK;
+	if(next == queue_tail)
+	{
+		++button_lost;
+		return;
+	}
+	queue[queue_head] = event;
+	queue_head = next;	// publish, has to be the last write
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Tick part of the low priority ISR (every 1ms). Sample RA0 and debounce it
+**           Part de la ISR del tic, mostreja RA0 i treu els rebots
+** Parameters: none
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+void button_tick(void)
+{
+	if(BUTTON == 0)		// depressed (GND)
+	{
+		if(integrator < BUTTON_DEBOUNCE_MS) ++integrator;
+	}
+	else
+	{
+		if(integrator) --integrator;
+	}
+
+	if(pressed)
+	{
+		if(press_ms < BUTTON_LONG_MS) ++press_ms;
+		if(integrator == 0)
+		{
+			pressed = 0;
+			button_put(press_ms >= BUTTON_LONG_MS ? BUTTON_LONG : BUTTON_SHORT);
+		}
+	}
+	else if(integrator == BUTTON_DEBOUNCE_MS)
+	{
+		pressed = 1;
+		press_ms = 0;
+		button_put(BUTTON_PRESS);
+	}
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Main loop side. Oldest event not read yet
+**           Costat del bucle principal. Event mes antic
+** Parameters: none
+** Returns: BUTTON_PRESS, BUTTON_SHORT, BUTTON_LONG or BUTTON_NONE if there is no event
+**---------------------------------------------------------------------------
+*/
+uint8_t button_get(void)
+{
+	uint8_t event;
+
+	if(queue_tail == queue_head) return BUTTON_NONE;
+	event = queue[queue_tail];
+	queue_tail = (queue_tail + 1) & QUEUE_MASK;
+	return event;
+}
@@ -0,0 +1,42 @@
+/*************************************************************************
+**  HARLEY DAVIDSON Sportster 883/1200 - J1850 VPW Interface
+**  Released under GNU GENERAL PUBLIC LICENSE
+**  Main MCU: MICROCHIP PIC18F2553
+**  Homepage: www.momex.cat
+**  Contact: morales.xavier@momex.cat
+**
+**
+**  Revision History
+**  11/06/2016   XM  v1.00   Initial Release on Github
+**
+**
+**   NOTE: Rear switch (RA0). Sampled every 1ms from the tick interrupt and
+**         debounced with an integrator, the changes are queued as events
+**         for the main loop (the ISR is the only writer, the main loop the
+**         only reader of the queue).
+**         Polsador, mostrejat cada 1ms a la interrupcio del tic.
+**************************************************************************/
+
+#ifndef __BUTTON_H__	//if button.h has not been defined--> define it || if yes --> do nothing
+#define __BUTTON_H__
+
+#include "macros.h"
+
+#define BUTTON_DEBOUNCE_MS	20	// integrator limit, the switch has to be stable this long to change state
+#define BUTTON_LONG_MS		1000	// press time (after the debounce) of a long press
+#define BUTTON_QUEUE_SIZE	4	// events, has to be a power of 2
+
+// events returned by button_get()
+#define BUTTON_NONE		0	// queue empty
+#define BUTTON_PRESS		1	// switch depressed
+#define BUTTON_SHORT		2	// switch released after less than BUTTON_LONG_MS
+#define BUTTON_LONG		3	// switch released after BUTTON_LONG_MS or more
+
+extern volatile uint8_t button_lost;	// events lost because the queue was full
+
+//Function Prototypes
+extern void button_init(void);
+extern void button_tick(void);
+extern uint8_t button_get(void);
+
+#endif // __BUTTON_H__
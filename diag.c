@@ -0,0 +1,258 @@
+/*************************************************************************
+**  HARLEY DAVIDSON Sportster 883/1200 - J1850 VPW Interface
+**  Released under GNU GENERAL PUBLIC LICENSE
+**  Main MCU: MICROCHIP PIC18F2553
+**  Homepage: www.momex.cat
+**  Contact: morales.xavier@momex.cat
+**
+**
+**  Revision History
+**  11/06/2016   XM  v1.00   Initial Release on Github
+**
+**
+**   NOTE: Everything runs on the main loop (diag_task and the frame
+**         handler of the answers), the ISRs are not involved. The bus load
+**         is estimated from the length of every received frame, our own
+**         requests included (the receiver sees them too).
+**         Tot s'executa al bucle principal.
+**************************************************************************/
+
+#include "j1850.h"
+#include "j1850_tx.h"
+#include "sched.h"
+#include "diag.h"
+#include "macros.h"
+
+uint16_t diag_requests;
+uint16_t diag_answers;
+uint16_t diag_timeouts;
+uint16_t diag_tx_errors;
+uint8_t diag_load;
+uint8_t diag_slow;
+
+#if DIAG
+
+#if !J1850_TX
+#error "the diagnostic requests need the transmitter, set J1850_TX to 1 in j1850_tx.h or DIAG to 0 in diag.h"
+#endif
+
+static diag_param *diag_params;		// table of the caller
+static uint8_t diag_nparams;
+static uint32_t diag_busy_us;		// bus time of the frames of the current window
+static uint16_t diag_window;		// sched_now() at the start of the window
+static uint8_t diag_window_timeouts;	// timeouts of the current window
+static uint8_t diag_window_answers;	// answers of the current window
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Start the requests of a table of parameters, the first ones at once. diag_task() has to
+**           be run every DIAG_MS
+**           Engega les peticions d'una taula de parametres
+** Parameters: table of parameters (DIAG_PARAM), number of rows
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+void diag_start(diag_param *params, uint8_t nparams)
+{
+	uint16_t now;
+	uint8_t i;
+
+	now = sched_now();
+	diag_params = params;
+	diag_nparams = nparams;
+	for(i = 0; i < nparams; i++)
+	{
+		params[i].next = now;
+		params[i].answered = 0;
+		params[i].state = DIAG_IDLE;
+	}
+	diag_requests = 0;
+	diag_answers = 0;
+	diag_timeouts = 0;
+	diag_tx_errors = 0;
+	diag_load = 0;
+	diag_slow = 0;
+	diag_busy_us = 0;
+	diag_window = now;
+	diag_window_timeouts = 0;
+	diag_window_answers = 0;
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Internal function, queue the request of one parameter on the transmitter
+**           Funcio interna, posa la peticio d'un parametre a la cua de l'emissor
+** Parameters: parameter
+** Returns: 1 if it has been queued, 0 if the transmitter queue is full
+**---------------------------------------------------------------------------
+*/
+static uint8_t diag_request(diag_param *param)
+{
+	uint8_t msg[6];
+
+	msg[0] = DIAG_REQ_PRIO;
+	msg[1] = DIAG_REQ_TARGET;
+	msg[2] = DIAG_TESTER;
+	msg[3] = DIAG_MODE;
+	msg[4] = param->pid;
+	msg[5] = j1850_crc(msg, 5);
+	param->ticket = j1850_tx_queue(msg, 6);
+	if(!param->ticket) return 0;
+	param->state = DIAG_QUEUED;
+	return 1;
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Task of the main loop, every DIAG_MS. Follows the requests on the transmitter and their
+**           timeouts, adapts the periods to the bus load at the end of each window and queues the
+**           requests whose time has come (first rows first) while less than DIAG_INFLIGHT are
+**           waiting
+**           Tasca del bucle principal. Segueix les peticions, adapta els periodes i n'envia de noves
+** Parameters: none
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+void diag_task(void)
+{
+	diag_param *param;
+	uint16_t now;
+	uint8_t i, inflight, status;
+
+	now = sched_now();
+	inflight = 0;
+	for(i = 0, param = diag_params; i < diag_nparams; i++, param++)
+	{
+		if(param->state == DIAG_QUEUED)
+		{
+			status = j1850_tx_status(param->ticket);
+			if(status == J1850_RETURN_CODE_OK)
+			{
+				param->state = DIAG_WAIT;
+				param->sent = now;
+				++diag_requests;
+			}
+			else if(status != J1850_TX_PENDING)
+			{
+				param->state = DIAG_IDLE;	// again on its next period
+				++diag_tx_errors;
+			}
+		}
+		else if(param->state == DIAG_WAIT && (uint16_t)(now - param->sent) >= DIAG_TIMEOUT_MS)
+		{
+			param->state = DIAG_IDLE;
+			++diag_timeouts;
+			if(diag_window_timeouts < 0xFF) ++diag_window_timeouts;
+		}
+		if(param->state != DIAG_IDLE) ++inflight;
+	}
+
+	if((uint16_t)(now - diag_window) >= DIAG_LOAD_MS)
+	{
+		diag_busy_us /= (uint16_t)(now - diag_window) * 10;	// us per ms x 100, %
+		diag_load = diag_busy_us > 100 ? 100 : (uint8_t)diag_busy_us;
+		// the bus or the ECM can not take more. A PID that is never answered (not supported) alone does not slow down the rest
+		if(diag_load > DIAG_LOAD_HIGH || diag_window_timeouts > diag_window_answers)
+		{
+			if(diag_slow < DIAG_SLOW_MAX) ++diag_slow;
+		}
+		else if(diag_load < DIAG_LOAD_LOW && diag_slow)
+		{
+			--diag_slow;
+		}
+		diag_busy_us = 0;
+		diag_window = now;
+		diag_window_timeouts = 0;
+		diag_window_answers = 0;
+	}
+
+	for(i = 0, param = diag_params; i < diag_nparams && inflight < DIAG_INFLIGHT; i++, param++)
+	{
+		if(param->state != DIAG_IDLE || (int16_t)(now - param->next) < 0) continue;
+		if(!diag_request(param)) break;
+		param->next = now + (param->period << diag_slow);
+		++inflight;
+	}
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Count the bus time of a received frame, for the bus load
+**           Compta el temps de bus d'una trama rebuda
+** Parameters: frame length
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+void diag_frame(uint8_t nbytes)
+{
+	diag_busy_us += DIAG_FRAME_US(nbytes);
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Answer of the ECM (header DIAG_RSP_PRIO, DIAG_RSP_TARGET, DIAG_ECU, DIAG_MODE_ANSWER).
+**           The parameter is found by its PID and its handler called with the data, if the answer
+**           has all of them. Answers to the requests of another tester are also taken
+**           Resposta de l'ECM. Es busca el parametre pel PID i es crida la seva funcio
+** Parameters: Pointer to frame buffer, frame length
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+void diag_response(uint8_t *msg, uint8_t nbytes)
+{
+	diag_param *param;
+	uint8_t i;
+
+	for(i = 0, param = diag_params; i < diag_nparams; i++, param++)
+	{
+		if(param->pid != msg[4]) continue;
+		if(nbytes < 5 + param->len) return;
+		if(param->state != DIAG_IDLE)
+		{
+			if(param->state == DIAG_QUEUED) ++diag_requests;	// sent, the ECM was faster than diag_task
+			param->state = DIAG_IDLE;
+			++diag_answers;
+			if(diag_window_answers < 0xFF) ++diag_window_answers;
+		}
+		param->last = sched_now();
+		param->answered = 1;
+		param->handler(msg + 5);
+		return;
+	}
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: The last answer of a parameter is recent: not older than DIAG_STALE periods (with the
+**           current slow down)
+**           L'ultima resposta d'un parametre es recent
+** Parameters: parameter
+** Returns: 1 if its value can be used
+**---------------------------------------------------------------------------
+*/
+uint8_t diag_fresh(diag_param *param)
+{
+	return param->answered && (uint16_t)(sched_now() - param->last) < DIAG_STALE * (param->period << diag_slow);
+}
+#else
+void diag_start(diag_param *params, uint8_t nparams)
+{
+}
+
+void diag_task(void)
+{
+}
+
+void diag_frame(uint8_t nbytes)
+{
+}
+
+void diag_response(uint8_t *msg, uint8_t nbytes)
+{
+}
+
+uint8_t diag_fresh(diag_param *param)
+{
+	return 0;
+}
+#endif // DIAG
@@ -0,0 +1,94 @@
+/*************************************************************************
+**  HARLEY DAVIDSON Sportster 883/1200 - J1850 VPW Interface
+**  Released under GNU GENERAL PUBLIC LICENSE
+**  Main MCU: MICROCHIP PIC18F2553
+**  Homepage: www.momex.cat
+**  Contact: morales.xavier@momex.cat
+**
+**
+**  Revision History
+**  11/06/2016   XM  v1.00   Initial Release on Github
+**
+**
+**   NOTE: Diagnostic requests to the ECM for the values that are not
+**         broadcast. The caller gives a table of parameters (PIDs), each
+**         one with its own period. The requests are queued on the
+**         transmitter (j1850_tx.c) without waiting, up to DIAG_INFLIGHT of
+**         them wait for their answer at the same time. The answers come
+**         with the other frames (frame_table of tacho.c) and are matched by
+**         their PID. When the bus load is high or the ECM leaves more
+**         requests without answer than it answers, all the periods are
+**         doubled, up to x2^DIAG_SLOW_MAX.
+**         Peticions de diagnosi a l'ECM amb un periode per parametre.
+**************************************************************************/
+
+#ifndef __DIAG_H__	//if diag.h has not been defined--> define it || if yes --> do nothing
+#define __DIAG_H__
+
+#include "macros.h"
+
+// 1: diagnostic requests (this module, needs J1850_TX). 0: the tacho only listens, the answers never come
+// and mode 3 uses the fuel estimate without load and air temperature. 0 while J1850_TX is 0
+#ifndef DIAG	// -DDIAG=1 together with -DJ1850_TX=1
+#define DIAG	0
+#endif
+
+// SAE J1979 over J1850 VPW: request 68 6A F1 01 <pid> <crc>, answer 48 6B <ecu> 41 <pid> <data> <crc>
+#define DIAG_REQ_PRIO		0x68	// priority/type of the requests
+#define DIAG_REQ_TARGET		0x6A	// functional address of the OBD requests
+#define DIAG_TESTER		0xF1	// our address, source of the requests
+#define DIAG_RSP_PRIO		0x48	// priority/type of the answers
+#define DIAG_RSP_TARGET		0x6B	// functional address of the OBD answers
+#define DIAG_ECU		0x10	// engine ECM, source of the answers
+#define DIAG_MODE		0x01	// current data
+#define DIAG_MODE_ANSWER	0x41	// DIAG_MODE + 0x40
+
+#define DIAG_MS		10	// task period
+#define DIAG_INFLIGHT	2	// requests waiting for their answer at the same time
+#define DIAG_TIMEOUT_MS	100	// answer time of the ECM (J1979 P2 on VPW)
+#define DIAG_STALE	3	// an answer older than DIAG_STALE current periods is not used
+#define DIAG_LOAD_MS	500	// window of the bus load measure
+#define DIAG_LOAD_HIGH	50	// bus load (%) above which the periods are doubled
+#define DIAG_LOAD_LOW	25	// bus load (%) below which they are halved back
+#define DIAG_SLOW_MAX	3	// periods up to x8
+
+// bus time of a frame in us: SOF + EOF and 8 symbols of 96us average per byte
+#define DIAG_FRAME_US(nbytes)	(480 + 768 * (uint16_t)(nbytes))
+
+// request states
+#define DIAG_IDLE	0	// waiting for its period
+#define DIAG_QUEUED	1	// on the transmitter queue
+#define DIAG_WAIT	2	// sent, waiting for the answer
+
+typedef struct {
+	uint8_t pid;		// J1979 parameter
+	uint8_t len;		// data bytes of the answer
+	uint16_t period;	// ms between requests at low bus load
+	void (*handler)(uint8_t *data);	// decode of the answer data
+	uint16_t next;		// sched_now() of the next request
+	uint16_t sent;		// sched_now() when the request was sent (timeout)
+	uint16_t last;		// sched_now() of the last answer
+	uint8_t answered;	// an answer has been received
+	uint8_t state;		// DIAG_IDLE, DIAG_QUEUED or DIAG_WAIT
+	uint8_t ticket;		// of j1850_tx_queue(), while DIAG_QUEUED
+} diag_param;
+
+// diag_param table entry, the rest of the fields are set by diag_start()
+#define DIAG_PARAM(pid, len, period_ms, func)	{pid, len, period_ms, func, 0, 0, 0, 0, 0, 0}
+
+// counters, cleared by diag_start()
+extern uint16_t diag_requests;		// requests sent
+extern uint16_t diag_answers;		// answers matched with a request
+extern uint16_t diag_timeouts;		// requests without answer after DIAG_TIMEOUT_MS
+extern uint16_t diag_tx_errors;		// requests not sent (arbitration lost J1850_TX_RETRIES + 1 times)
+extern uint8_t diag_load;		// bus load of the last window, %
+extern uint8_t diag_slow;		// periods x2^diag_slow
+
+//Function Prototypes
+extern void diag_start(diag_param *params, uint8_t nparams);
+extern void diag_task(void);
+extern void diag_frame(uint8_t nbytes);
+extern void diag_response(uint8_t *msg, uint8_t nbytes);
+extern uint8_t diag_fresh(diag_param *param);
+
+#endif // __DIAG_H__
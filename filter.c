@@ -0,0 +1,154 @@
+/*************************************************************************
+**  HARLEY DAVIDSON Sportster 883/1200 - J1850 VPW Interface
+**  Released under GNU GENERAL PUBLIC LICENSE
+**  Main MCU: MICROCHIP PIC18F2553
+**  Homepage: www.momex.cat
+**  Contact: morales.xavier@momex.cat
+**
+**
+**  Revision History
+**  11/06/2016   XM  v1.00   Initial Release on Github
+**
+**
+**   NOTE: The EMA accumulator is 16 bits, so the input has to be below
+**         65536 >> shift (rpm up to 16383 with shift 2). The intermediate
+**         sum can wrap, the result is right because it is unsigned.
+**         Cost and stability on logs are measured by host/filter_bench.c.
+**************************************************************************/
+
+#include "filter.h"
+#include "macros.h"
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Exponential moving average, y = y + (x - y) / 2^shift. shift 1 gives the new sample a
+**           weight of 1/2, shift 2 of 1/4... The output is rounded, f->acc has the value with shift
+**           more bits (0 after the init)
+**           Mitjana mobil exponencial amb un desplacament en lloc d'una divisio
+** Parameters: state, sample, shift (the same on every call)
+** Returns: filtered value
+**---------------------------------------------------------------------------
+*/
+void filter_ema_init(filter_ema *f)
+{
+	f->acc = 0;
+	f->primed = 0;
+}
+
+uint16_t filter_ema_run(filter_ema *f, uint16_t x, uint8_t shift)
+{
+	if(!f->primed)
+	{
+		f->acc = x << shift;
+		f->primed = 1;
+	}
+	else
+	{
+		f->acc += x - (f->acc >> shift);
+	}
+	return (f->acc + ((1 << shift) >> 1)) >> shift;
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Median of the sample and the two previous ones. Until there are 3 samples the first one
+**           counts as the previous ones
+**           Mediana de les 3 darreres mostres
+** Parameters: state, sample
+** Returns: median
+**---------------------------------------------------------------------------
+*/
+void filter_median_init(filter_median *f)
+{
+	f->primed = 0;
+}
+
+uint16_t filter_median_run(filter_median *f, uint16_t x)
+{
+	uint16_t a, b, m;
+
+	if(!f->primed)
+	{
+		f->older = x;
+		f->old = x;
+		f->primed = 1;
+	}
+	a = f->older;
+	b = f->old;
+	f->older = b;
+	f->old = x;
+
+	if(a > b)	// a <= b from here
+	{
+		m = a;
+		a = b;
+		b = m;
+	}
+	if(x <= a) return a;
+	if(x >= b) return b;
+	return x;
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Hysteresis, the output follows the sample only when they are more than band apart, so a
+**           value on the limit of two displayed values does not flicker
+**           Histeresi, la sortida nomes canvia si l'entrada se n'allunya mes que band
+** Parameters: state, sample, band
+** Returns: output
+**---------------------------------------------------------------------------
+*/
+void filter_hyst_init(filter_hyst *f)
+{
+	f->primed = 0;
+}
+
+uint16_t filter_hyst_run(filter_hyst *f, uint16_t x, uint16_t band)
+{
+	uint16_t diff;
+
+	if(f->primed)
+	{
+		diff = (x > f->out) ? x - f->out : f->out - x;
+		if(diff <= band) return f->out;
+	}
+	f->out = x;
+	f->primed = 1;
+	return x;
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Confirm, the output changes to a new value when it has been received n times in a row.
+**           For values that can not be averaged (gear, engine ON)
+**           Confirmacio, la sortida canvia quan el nou valor arriba n cops seguits
+** Parameters: state, output until the first change (init) / sample, samples needed (run)
+** Returns: output
+**---------------------------------------------------------------------------
+*/
+void filter_confirm_init(filter_confirm *f, uint16_t out)
+{
+	f->out = out;
+	f->next = out;
+	f->count = 0;
+}
+
+uint16_t filter_confirm_run(filter_confirm *f, uint16_t x, uint8_t n)
+{
+	if(x == f->out)
+	{
+		f->count = 0;
+		return f->out;
+	}
+	if(x != f->next)
+	{
+		f->next = x;
+		f->count = 0;
+	}
+	if(++f->count >= n)
+	{
+		f->out = x;
+		f->count = 0;
+	}
+	return f->out;
+}
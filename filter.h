@@ -0,0 +1,61 @@
+/*************************************************************************
+**  HARLEY DAVIDSON Sportster 883/1200 - J1850 VPW Interface
+**  Released under GNU GENERAL PUBLIC LICENSE
+**  Main MCU: MICROCHIP PIC18F2553
+**  Homepage: www.momex.cat
+**  Contact: morales.xavier@momex.cat
+**
+**
+**  Revision History
+**  11/06/2016   XM  v1.00   Initial Release on Github
+**
+**
+**   NOTE: Integer filters for the decoded values, one small state per
+**         signal and no division:
+**         - EMA: y += (x - y) / 2^shift, kept with shift extra bits
+**         - median of the last 3 samples, a single wrong sample is removed
+**         - hysteresis: the output only moves when the input is more than
+**           a band away from it
+**         - confirm: the output takes a new value after N samples in a row
+**         A state filled with the init function has no samples yet, the
+**         first sample is taken as it is.
+**         Filtres enters pels valors descodificats.
+**************************************************************************/
+
+#ifndef __FILTER_H__	//if filter.h has not been defined--> define it || if yes --> do nothing
+#define __FILTER_H__
+
+#include "macros.h"
+
+typedef struct {
+	uint16_t acc;		// output << shift, with its fraction bits
+	uint8_t primed;		// acc has a value
+} filter_ema;
+
+typedef struct {
+	uint16_t older, old;	// last two samples
+	uint8_t primed;		// older and old have a value
+} filter_median;
+
+typedef struct {
+	uint16_t out;		// value given
+	uint8_t primed;		// out has a value
+} filter_hyst;
+
+typedef struct {
+	uint16_t out;		// value given
+	uint16_t next;		// candidate new value
+	uint8_t count;		// samples in a row equal to next
+} filter_confirm;
+
+//Function Prototypes
+extern void filter_ema_init(filter_ema *f);
+extern uint16_t filter_ema_run(filter_ema *f, uint16_t x, uint8_t shift);
+extern void filter_median_init(filter_median *f);
+extern uint16_t filter_median_run(filter_median *f, uint16_t x);
+extern void filter_hyst_init(filter_hyst *f);
+extern uint16_t filter_hyst_run(filter_hyst *f, uint16_t x, uint16_t band);
+extern void filter_confirm_init(filter_confirm *f, uint16_t out);
+extern uint16_t filter_confirm_run(filter_confirm *f, uint16_t x, uint8_t n);
+
+#endif // __FILTER_H__
@@ -0,0 +1,147 @@
+/*************************************************************************
+**  HARLEY DAVIDSON Sportster 883/1200 - J1850 VPW Interface
+**  Released under GNU GENERAL PUBLIC LICENSE
+**  Main MCU: MICROCHIP PIC18F2553
+**  Homepage: www.momex.cat
+**  Contact: morales.xavier@momex.cat
+**
+**
+**  Revision History
+**  11/06/2016   XM  v1.00   Initial Release on Github
+**
+**
+**   NOTE: One 16x16 multiplication and one 32 bit division per value, the
+**         divisor is a power of 2 times the speed or the rpm. rpm is used
+**         with 2 fraction bits (x4, up to 16383 rpm) and speed with 6 (x64,
+**         up to 511 km/h, 1/64 km/h is 0.3% at FUEL_MIN_SPEED), so the
+**         products fit in 32 bits.
+**         Calcul del consum amb enters de 32 bits.
+**************************************************************************/
+
+#include "fuel.h"
+#include "macros.h"
+
+#define FUEL_FRAC	8	// fraction bits of the samples on the EMAs, the truncation of the EMA stays below 1/256
+
+static uint32_t fuel_rpm;	// EMAs, value << (FUEL_AVG_SHIFT + FUEL_FRAC)
+static uint32_t fuel_speed;
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Empty averages, fuel_average() gives FUEL_NONE until the bike moves
+**           Buida les mitjanes
+** Parameters: none
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+void fuel_init(void)
+{
+	fuel_rpm = 0;
+	fuel_speed = 0;
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Add the current rpm and speed to their averages, at a fixed period (TACHO_REFRESH_MS)
+**           Afegeix les rpm i la velocitat a les mitjanes
+** Parameters: rpm, speed (km/h)
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+void fuel_update(uint16_t rpm, uint16_t speed)
+{
+	fuel_rpm += ((uint32_t)rpm << FUEL_FRAC) - (fuel_rpm >> FUEL_AVG_SHIFT);
+	fuel_speed += ((uint32_t)speed << FUEL_FRAC) - (fuel_speed >> FUEL_AVG_SHIFT);
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: rpm corrected with the air that really enters the engine, for fuel_update(): x engine
+**           load / FUEL_VE_PCT and x air density (FUEL_AIR_TEMP + 273) / (air temperature + 273),
+**           each one only if it is known
+**           Rpm corregides amb la carrega del motor i la temperatura de l'aire
+** Parameters: rpm, engine load (0-100%) or FUEL_UNKNOWN, intake air temperature + 40 (C, as J1979) or FUEL_UNKNOWN
+** Returns: corrected rpm, up to FUEL_RPM_MAX
+**---------------------------------------------------------------------------
+*/
+uint16_t fuel_air(uint16_t rpm, uint8_t load_pct, uint8_t iat40)
+{
+	uint32_t val;
+	uint16_t div;
+
+	// one rounded division: rpm x 100 x 288 fits in 32 bits, FUEL_VE_PCT x 488 in 16
+	val = rpm;
+	div = 1;
+	if(load_pct != FUEL_UNKNOWN)
+	{
+		val *= load_pct;
+		div = FUEL_VE_PCT;
+	}
+	if(iat40 != FUEL_UNKNOWN)
+	{
+		val *= 273 + FUEL_AIR_TEMP;
+		div *= 233 + iat40;
+	}
+	val = (val + div / 2) / div;
+	if(val > FUEL_RPM_MAX) return FUEL_RPM_MAX;
+	return (uint16_t)val;
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: L/100km for a rpm and a speed, rounded
+**           Litres cada 100 km per unes rpm i una velocitat
+** Parameters: rpm x 4, speed x 64 (km/h)
+** Returns: L/100km x 10, up to FUEL_MAX. FUEL_NONE below FUEL_MIN_SPEED
+**---------------------------------------------------------------------------
+*/
+uint16_t fuel_l100(uint16_t rpm4, uint16_t speed64)
+{
+	uint32_t val;
+
+	if(speed64 < FUEL_MIN_SPEED * 64) return FUEL_NONE;
+	val = ((uint32_t)rpm4 * FUEL_K_Q12 + ((uint32_t)speed64 << 7)) / ((uint32_t)speed64 << 8);
+	if(val > FUEL_MAX) return FUEL_MAX;
+	return (uint16_t)val;
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Miles per gallon for a rpm and a speed, rounded
+**           Milles per gallo per unes rpm i una velocitat
+** Parameters: rpm x 4, speed x 64 (km/h)
+** Returns: MPG x 10, up to FUEL_MAX (also with the engine OFF). FUEL_NONE below FUEL_MIN_SPEED
+**---------------------------------------------------------------------------
+*/
+uint16_t fuel_mpg(uint16_t rpm4, uint16_t speed64)
+{
+	uint32_t val;
+
+	if(speed64 < FUEL_MIN_SPEED * 64) return FUEL_NONE;
+	if(rpm4 == 0) return FUEL_MAX;	// coasting with the engine OFF
+	val = ((uint32_t)speed64 * FUEL_MPG_Q2 + ((uint32_t)rpm4 << 5)) / ((uint32_t)rpm4 << 6);
+	if(val > FUEL_MAX) return FUEL_MAX;
+	return (uint16_t)val;
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Consumption of the last seconds, from the averages of fuel_update()
+**           Consum dels darrers segons
+** Parameters: none
+** Returns: consumption x 10 on FUEL_UNITS, up to FUEL_MAX. FUEL_NONE below FUEL_MIN_SPEED
+**---------------------------------------------------------------------------
+*/
+uint16_t fuel_average(void)
+{
+	uint16_t rpm4, speed64;
+
+	// rounded to the fraction bits of fuel_l100() and fuel_mpg()
+	rpm4 = (uint16_t)((fuel_rpm + (1UL << (FUEL_AVG_SHIFT + FUEL_FRAC - 3))) >> (FUEL_AVG_SHIFT + FUEL_FRAC - 2));
+	speed64 = (uint16_t)((fuel_speed + (1UL << (FUEL_AVG_SHIFT + FUEL_FRAC - 7))) >> (FUEL_AVG_SHIFT + FUEL_FRAC - 6));
+#if FUEL_UNITS == FUEL_MPG
+	return fuel_mpg(rpm4, speed64);
+#else
+	return fuel_l100(rpm4, speed64);
+#endif
+}
@@ -0,0 +1,70 @@
+/*************************************************************************
+**  HARLEY DAVIDSON Sportster 883/1200 - J1850 VPW Interface
+**  Released under GNU GENERAL PUBLIC LICENSE
+**  Main MCU: MICROCHIP PIC18F2553
+**  Homepage: www.momex.cat
+**  Contact: morales.xavier@momex.cat
+**
+**
+**  Revision History
+**  11/06/2016   XM  v1.00   Initial Release on Github
+**
+**
+**   NOTE: Fuel consumption estimated from rpm and speed, without float
+**         (the software float of C18 is too slow for the refresh). The
+**         fuel flow is the air of half the displacement per revolution
+**         (4 stroke) divided by the air/fuel ratio, so
+**            L/100km = K * rpm / speed
+**         with K computed by the preprocessor from the FUEL_* constants.
+**         Without throttle position on the bus the air is taken at full
+**         volumetric efficiency and 15 C. When the ECM answers the
+**         diagnostic requests (diag.c), fuel_air() corrects the rpm with the
+**         engine load and the intake air temperature, it is still an
+**         estimation. The value shown is the ratio of the averages of
+**         rpm and speed (EMA), that is the fuel of the last seconds over
+**         their distance. Checked against double by host/fuel_bench.c
+**         Consum estimat a partir de les rpm i la velocitat, sense float.
+**************************************************************************/
+
+#ifndef __FUEL_H__	//if fuel.h has not been defined--> define it || if yes --> do nothing
+#define __FUEL_H__
+
+#include "macros.h"
+
+// engine and fuel, see the note
+#define FUEL_DISPLACEMENT_CC	883	// 883 or 1200
+#define FUEL_VE_PCT		85	// volumetric efficiency, %
+#define FUEL_AIR_MG_L		1220	// air density, mg/L
+#define FUEL_AFR_X100		1468	// air/fuel ratio x 100
+#define FUEL_DENSITY_G_L	750	// petrol density, g/L
+
+// units shown on mode 3, both with one decimal (value x 10)
+#define FUEL_L100KM	0	// L/100km
+#define FUEL_MPG	1	// miles per gallon
+#define FUEL_UNITS	FUEL_L100KM
+#define FUEL_MPG_X1000	235215UL	// MPG x L/100km x 1000, US gallon (282481UL for the imperial gallon)
+
+#define FUEL_AVG_SHIFT	5	// EMA of rpm and speed, 1/32 per fuel_update() (3.2 s at TACHO_REFRESH_MS)
+#define FUEL_MIN_SPEED	5	// km/h, slower there is no consumption per distance
+#define FUEL_MAX	999	// 99.9, higher values are limited
+#define FUEL_NONE	0xFFFF	// no value (stopped), shown as "---"
+#define FUEL_UNKNOWN	0xFF	// load or air temperature not known, parameter of fuel_air()
+#define FUEL_AIR_TEMP	15	// C, air temperature of FUEL_AIR_MG_L
+#define FUEL_RPM_MAX	16383	// highest rpm of fuel_update() (x4 on 16 bits)
+
+// K x 10 (0.1 L/100km units) in Q12, 32 bit steps that do not overflow up to 1200 cc:
+// 10 * 4096 * cc/2000 * VE/100 * air/1000 / AFR * 60 * 100 / density = cc*VE*air / AFR_X100 * 3072 / (25 * density)
+#define FUEL_K_Q12	((((uint32_t)FUEL_DISPLACEMENT_CC * FUEL_VE_PCT * FUEL_AIR_MG_L / FUEL_AFR_X100) * 3072 + \
+			  25UL * FUEL_DENSITY_G_L / 2) / (25UL * FUEL_DENSITY_G_L))
+// MPG x 10 = FUEL_MPG_X1000 / 10 / (L/100km x 10) = speed * FUEL_MPG_Q2 / rpm / 4
+#define FUEL_MPG_Q2	(((FUEL_MPG_X1000 * 4096UL / FUEL_K_Q12) * 2 + 2) / 5)
+
+//Function Prototypes
+extern void fuel_init(void);
+extern void fuel_update(uint16_t rpm, uint16_t speed);
+extern uint16_t fuel_air(uint16_t rpm, uint8_t load_pct, uint8_t iat40);
+extern uint16_t fuel_l100(uint16_t rpm4, uint16_t speed64);
+extern uint16_t fuel_mpg(uint16_t rpm4, uint16_t speed64);
+extern uint16_t fuel_average(void);
+
+#endif // __FUEL_H__
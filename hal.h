@@ -0,0 +1,33 @@
+/*************************************************************************
+**  HARLEY DAVIDSON Sportster 883/1200 - J1850 VPW Interface
+**  Released under GNU GENERAL PUBLIC LICENSE
+**  Main MCU: MICROCHIP PIC18F2553
+**  Homepage: www.momex.cat
+**  Contact: morales.xavier@momex.cat
+**
+**
+**  Revision History
+**  11/06/2016   XM  v1.00   Initial Release on Github
+**
+**
+**   NOTE: Hardware abstraction layer. The modules include this file instead
+**         of <p18f2553.h> and only touch the hardware through its macros
+**         (bus pin, MM5450 pins, timers, board pins).
+**         - MPLAB C18: hal_pic18.h, the macros are the PIC registers
+**         - PC build: host/hal_host.h, simulated hardware (virtual clock,
+**           J1850 bus line and MM5450 shift register)
+**         Capa d'abstraccio del hardware: PIC18 o simulacio al PC.
+**************************************************************************/
+
+#ifndef __HAL_H__	//if hal.h has not been defined--> define it || if yes --> do nothing
+#define __HAL_H__
+
+#include "macros.h"
+
+#if defined(__18CXX)	// MPLAB C18
+#include "hal_pic18.h"
+#else			// PC simulation
+#include "host/hal_host.h"
+#endif
+
+#endif // __HAL_H__
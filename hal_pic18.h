@@ -0,0 +1,158 @@
+/*************************************************************************
+**  HARLEY DAVIDSON Sportster 883/1200 - J1850 VPW Interface
+**  Released under GNU GENERAL PUBLIC LICENSE
+**  Main MCU: MICROCHIP PIC18F2553
+**  Homepage: www.momex.cat
+**  Contact: morales.xavier@momex.cat
+**
+**
+**  Revision History
+**  11/06/2016   XM  v1.00   Initial Release on Github
+**
+**
+**   NOTE: PIC18 backend of hal.h. Every pin and timer used by the modules
+**         is defined here, if the schematic changes only this file has to
+**         be changed. Do not include it directly, include hal.h.
+**         Pins i timers del PIC18F2553.
+**************************************************************************/
+
+#ifndef __HAL_PIC18_H__	//if hal_pic18.h has not been defined--> define it || if yes --> do nothing
+#define __HAL_PIC18_H__
+
+#include <p18f2553.h>
+#include <timers.h>		//TO:j1850 functions	T1:timestamps + 1ms tick (CCP2) 	T2:PWM for brightness control on Micrel IC + MM5450 shift clock    T3:J1850 transmitter (j1850_tx.c) or cycle counter of the benchmark build (bench.c)
+#include <pwm.h> 		//Used to vary the brightness of the MICREL MM5450
+
+/***************************************************************************
+**   J1850 bus (j1850.c)
+***************************************************************************/
+
+//**************************LATx**************************************
+//PIC: Put a bit of an Output at High.
+// The tacho board has no J1850 driver: RC2 is the CCP1 output of the brightness PWM (PWM_BRIGHTNESS), so
+// nothing reaches the bus. Only a board with its own transmit pin can set J1850_TX (j1850_tx.h) to 1
+#define vpw_active()	LATCbits.LATC2=1
+//*****************************************************************
+
+//**************************LATx**************************************
+//PIC: Put a bit of an Output at Low
+#define vpw_passive()	LATCbits.LATC2=0
+//*****************************************************************
+
+//************************TRISx****************************************
+//PIC: Select TRISx for Output
+#define bit_dir_outp()	TRISCbits.TRISC2=0
+//****************************************************************
+
+//************************TRISx****************************************
+//PIC: Select TRISx for Input
+#define bit_dir_inp()	TRISBbits.TRISB0=1
+//****************************************************************
+
+//************************PORTx****************************************
+//PIC: Read the state of an Input (High or Low).
+#define is_vpw_active()	!PORTBbits.RB0		
+// It has ! symbol because hardware uses transistor NPN which is inversing the J1850 signal (delete ! if you change the hardware)
+// Té el simbol ! (invertir valor) degut a que el hardware utilitza un tarnsistor NPN que inverteix el senyal (treure el ! si es canvia el hardware)
+//************************************************************
+
+//************************INTEDG0****************************************
+//PIC: INT0 edge on RB0 that means the bus is going active (0=falling, 1=rising).
+#define VPW_ACTIVE_EDGE	0
+// It is falling because of the NPN transistor, same as is_vpw_active() (set to 1 if you change the hardware)
+//************************************************************
+
+/***************************************************************************
+**   MM5450 (MM5450.c)
+***************************************************************************/
+
+//************************TRISx_Clock****************************************
+//PIC: Select TRISx for Clock
+#define MMClock_dir_outp()	TRISAbits.TRISA3=0
+//****************************************************************
+
+//**************************LATx_Clock**************************************
+//PIC: Put a bit of an Output at High.
+#define MMClock_active()	LATAbits.LATA3=1
+ //*****************************************************************
+
+//**************************LATx_Clock**************************************
+//PIC: Put a bit of an Output at Low
+#define MMClock_passive()	LATAbits.LATA3=0
+//*****************************************************************
+
+//************************TRISx_Data****************************************
+//PIC: Select TRISx for Data
+#define MMData_dir_outp()	TRISAbits.TRISA2=0
+//****************************************************************
+
+//**************************LATx_Data**************************************
+//PIC: Put a bit of an Output at High.
+#define MMData_active()	LATAbits.LATA2=1
+ //*****************************************************************
+
+//**************************LATx_Data**************************************
+//PIC: Put a bit of an Output at Low
+#define MMData_passive()	LATAbits.LATA2=0
+//*****************************************************************
+
+/***************************************************************************
+**   Timers, the T0CON/T1CON/T3CON values are on macros.h
+***************************************************************************/
+
+/* Define Timer0*/
+#define timer0_start(x)	T0CON=x;TMR0L=0;  // Timer0 enabled with a preescaler x
+#define timer0_16start(x)	T0CON=x;WriteTimer0(0);  // Timer0 16bit enabled with a preescaler x
+#define timer0_get()	TMR0L
+#define timer0_set(x)	TMR0L=x;	// Timer0 (8bit) counting from x
+#define timer0_stop()	T0CON=STOP;
+
+/* Define Timer3*/
+#define timer3_start(x)	T3CON=x;WriteTimer3(0);  // Timer3 16bit enabled with a preescaler x
+#define timer3_get()	ReadTimer3()
+#define timer3_set(x)	WriteTimer3(x);	// Timer3 (16bit) counting from x
+#define timer3_stop()	T3CON=T3STOP;
+
+/* Define Timer1*/
+#define timer1_start(x)	T1CON=x;WriteTimer1(0);  // Timer3 16bit enabled with a preescaler x
+#define timer1_get()	ReadTimer1()
+#define timer1_stop()	T1CON=T1STOP;
+
+/* Define CCP2, compare with Timer1 (1ms tick of sched.c)*/
+#define ccp2_compare_start()	CCP2CON=0b00001010;	// compare mode, only CCP2IF is set (Timer1 is not reset, CCP2 pin not used)
+#define ccp2_compare_set(x)	CCPR2H=(uint8_t)((x)>>8);CCPR2L=(uint8_t)(x);	// CCPR2 = x
+
+/***************************************************************************
+**   USART (usart_tx.c, usart_rx.c), opened by OpenUSART() in main.c
+***************************************************************************/
+#define usart_tx_write(x)	TXREG=x;	// next byte to send, only when TXIF is set
+#define usart_rx_read()	RCREG		// received byte, clears RCIF
+#define usart_rx_overrun()	RCSTAbits.OERR	// a byte has been lost, the reception is stopped
+#define usart_rx_restart()	RCSTAbits.CREN=0;RCSTAbits.CREN=1;	// clears OERR
+
+/***************************************************************************
+**   Board (main.c, tacho.c)
+***************************************************************************/
+#define BUTTON    	PORTAbits.RA0  		// Back switch. (Read values use LATAbits.LATA0) value=0 (GND=depressed) and value=1 (5V=released)
+#define TRIS_BUTTON   	TRISAbits.TRISA0    	// TRIS (0 OUTPUT , 1 INPUT)
+
+#define LED_MODE2   	LATAbits.LATA1  	// TEMP LED. MODE2. RECEIV LED (RED).  (0=OFF, 1=ON)
+#define TRIS_MODE2   	TRISAbits.TRISA1    	// TRIS (0 OUTPUT , 1 INPUT)
+
+#define DIG3    	LATAbits.LATA4  	// Used to show Digit3 or RPM bar. Value=0 (GND=digit working) i value=1 (5V=DIG3 not working)
+#define TRIS_DIG3  	TRISAbits.TRISA4    	// TRIS (0 OUTPUT , 1 INPUT)
+
+#define RPM_BAR    	LATAbits.LATA5  	// Mostrar RPM o No. Value=0 (GND=RPMbar working) i value=1 (5V=RPMbar not working)
+#define TRIS_RPM_BAR   	TRISAbits.TRISA5    	// TRIS (0 OUTPUT , 1 INPUT)
+
+#define LED_MODE0    	LATCbits.LATC0  	// RPM LED. INDICATOR OF MODE0 ACTIVE(1) OR NOT(0)
+#define TRIS_MODE0   	TRISCbits.TRISC0    	// TRIS (0 OUTPUT , 1 INPUT)
+
+#define LED_MODE1    	LATCbits.LATC1  	// INDICATOR OF MODE1 ACTIVE(1) OR NOT(0) (0=OFF, 1=ON)
+#define TRIS_MODE1   	TRISCbits.TRISC1    	// TRIS (0 OUTPUT , 1 INPUT)
+
+#define PWM_BRIGHTNESS	TRISCbits.TRISC2	// TRIS (0 OUTPUT , 1 INPUT)
+
+#define GEAR_7SEG	LATB			// Port B, 7 segments of the gear display (values from display7seg)
+
+#endif // __HAL_PIC18_H__
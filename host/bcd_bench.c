@@ -0,0 +1,215 @@
+/*************************************************************************
+**  HARLEY DAVIDSON Sportster 883/1200 - J1850 VPW Interface
+**  Released under GNU GENERAL PUBLIC LICENSE
+**  Main MCU: MICROCHIP PIC18F2553
+**  Homepage: www.momex.cat
+**  Contact: morales.xavier@momex.cat
+**
+**
+**  Revision History
+**  11/06/2016   XM  v1.00   Initial Release on Github
+**
+**
+**  Abstract: PC check of the division free digits (bcd.c) against the
+**            original division code of tacho_refresh(), for every value
+**            0..65535 on the split, rpm and speed/temperature functions,
+**            and benchmark of both versions. gcc turns x/10 into a multiply
+**            on the PC, so the division code is also timed with the 16
+**            step shift/subtract loop that the PIC18 library runs instead.
+**            Compara els digits sense divisions amb el codi original.
+**
+**  Build:    gcc -O2 -I.. -o bcd_bench bcd_bench.c ../bcd.c
+**  Usage:    bcd_bench [rounds]
+**************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../bcd.h"
+
+static const unsigned int pow10[BCD_DIGITS] = {1, 10, 100, 1000, 10000};
+static int pic_div;	// 1: divisions with udiv16()
+
+// 16 bit unsigned division by shift and subtract, as the PIC18 has no divide instruction
+static unsigned int __attribute__((noinline)) udiv16(unsigned int a, unsigned int b)
+{
+	unsigned int q = 0, r = 0;
+	int i;
+
+	for(i = 15; i >= 0; i--)
+	{
+		r = (r << 1) | ((a >> i) & 1);
+		if(r >= b)
+		{
+			r -= b;
+			q |= 1u << i;
+		}
+	}
+	return q;
+}
+
+#define DIV(a, b)	(pic_div ? udiv16(a, b) : (a) / (b))
+#define MOD(a, b)	((a) - DIV(a, b) * (b))
+
+// original rpm digits of tacho_refresh() (mode 0), used as reference
+static void digits_rpm_div(unsigned int rpm, unsigned char *digits)
+{
+	digits[3]=DIV(rpm,1000);
+	if (digits[3]==0){
+		digits[3]=10;		//digit OFF
+	}
+	if (rpm>650 && rpm<850){	//rpms are not constant at idle, this will force rpm to be at 800 all the time wihile idling
+		rpm=800;
+	}
+	digits[2]=MOD(DIV(rpm,100),10);
+	if (digits[2]==0 && digits[3]==10){
+		digits[2]=10;  		//digit OFF
+	}
+	digits[1]=MOD(DIV(rpm,10),10);
+
+	if (digits[1]<5){
+		digits[1]=0;
+	}else{
+		digits[1]=5;
+	}
+	if (digits[1]==0 && digits[2]==10 && digits[3]==10){
+		digits[1]=10;
+	}
+
+	digits[0]=0;
+}
+
+// original speed and temperature digits of tacho_refresh() (modes 1 and 2), used as reference
+static void digits_value_div(unsigned int val, unsigned char *digits)
+{
+	digits[2]=MOD(DIV(val,100),10);
+	if (digits[2]==0){
+		digits[2]=10;
+	}
+
+	digits[1]=MOD(DIV(val,10),10);
+	if (digits[1]==0 && digits[2]==10){
+		digits[1]=10;
+	}
+
+	digits[0]=MOD(val,10);
+}
+
+static double seconds(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+// time of rounds x 65536 values with the division code, ns per value
+static double time_div(long rounds)
+{
+	unsigned char digits[4];
+	volatile unsigned char sink = 0;
+	unsigned int v;
+	double t0;
+	long r;
+
+	t0 = seconds();
+	for(r = 0; r < rounds; r++)
+	{
+		for(v = 0; v <= 0xFFFF; v++)
+		{
+			digits_rpm_div(v, digits);
+			sink ^= digits[1];
+			digits_value_div(v, digits);
+			sink ^= digits[1];
+		}
+	}
+	return (seconds() - t0) * 1e9 / (rounds * 65536.0);
+}
+
+// time of rounds x 65536 values with bcd.c, ns per value
+static double time_bcd(long rounds)
+{
+	uint8_t digits[4];
+	volatile uint8_t sink = 0;
+	unsigned int v;
+	double t0;
+	long r;
+
+	t0 = seconds();
+	for(r = 0; r < rounds; r++)
+	{
+		for(v = 0; v <= 0xFFFF; v++)
+		{
+			bcd_rpm(v, digits);
+			sink ^= digits[1];
+			bcd_value(v, digits);
+			sink ^= digits[1];
+		}
+	}
+	return (seconds() - t0) * 1e9 / (rounds * 65536.0);
+}
+
+static void show(const char *what, unsigned int v, uint8_t *ref, uint8_t *got)
+{
+	printf("%s %u: division %d %d %d %d, bcd %d %d %d %d\n", what, v,
+		ref[3], ref[2], ref[1], ref[0], got[3], got[2], got[1], got[0]);
+}
+
+int main(int argc, char **argv)
+{
+	long rounds = argc > 1 ? atol(argv[1]) : 100;
+	long mismatches = 0;
+	unsigned int v;
+	uint8_t ref[4], got[4], bcd[BCD_DIGITS];
+	double t_div, t_pic, t_bcd;
+	int j;
+
+	for(v = 0; v <= 0xFFFF; v++)
+	{
+		bcd_split(v, bcd);
+		for(j = 0; j < BCD_DIGITS; j++)
+		{
+			if(bcd[j] != v / pow10[j] % 10)
+			{
+				if(mismatches < 10) printf("split %u: digit %d is %d\n", v, j, bcd[j]);
+				++mismatches;
+				break;
+			}
+		}
+
+		for(pic_div = 0; pic_div < 2; pic_div++)
+		{
+			digits_rpm_div(v, ref);
+			bcd_rpm(v, got);
+			if(memcmp(ref, got, 4))
+			{
+				if(mismatches < 10) show("rpm", v, ref, got);
+				++mismatches;
+			}
+
+			ref[3] = got[3] = 0xAA;		// digit 3 (RPM bar) has to be kept
+			digits_value_div(v, ref);
+			bcd_value(v, got);
+			if(memcmp(ref, got, 4))
+			{
+				if(mismatches < 10) show("value", v, ref, got);
+				++mismatches;
+			}
+		}
+	}
+
+	pic_div = 0;
+	t_div = time_div(rounds);
+	t_bcd = time_bcd(rounds);
+	pic_div = 1;
+	t_pic = time_div(rounds);
+
+	printf("0..65535: %ld mismatches\n", mismatches);
+	printf("division (x86 div):      %6.2f ns/value (rpm + speed)\n", t_div);
+	printf("division (shift loop):   %6.2f ns/value\n", t_pic);
+	printf("bcd:                     %6.2f ns/value (x%.1f vs x86 div, x%.1f vs shift loop)\n",
+		t_bcd, t_div / t_bcd, t_pic / t_bcd);
+	return mismatches != 0;
+}
@@ -0,0 +1,93 @@
+#!/bin/sh
+#*************************************************************************
+#  HARLEY DAVIDSON Sportster 883/1200 - J1850 VPW Interface
+#  Released under GNU GENERAL PUBLIC LICENSE
+#  Main MCU: MICROCHIP PIC18F2553
+#  Homepage: www.momex.cat
+#  Contact: morales.xavier@momex.cat
+#
+#
+#  Revision History
+#  11/06/2016   XM  v1.00   Initial Release on Github
+#
+#
+#  Abstract: Benchmark run of the firmware. Builds the benchmark build
+#            (-DBENCH=1, see bench.h) for the PIC18F2553 with MPLAB C18,
+#            replays bench_frames.txt on it in gpsim (vpw_stim.c) and
+#            writes the results file (bench_report.c). The results are
+#            compared with bench_baseline.txt, the exit code is 2 if any
+#            average or maximum has grown more than the tolerance. Without
+#            a baseline the results are written as bench_baseline.txt, to
+#            be committed.
+#            Mesura de cicles del firmware amb gpsim.
+#
+#  Needs:    mcc18 and mplink (MPLAB C18, C18DIR is its install directory,
+#            by default the parent of the directory of mcc18), gpsim, gcc.
+#            MCC18, MPLINK and GPSIM can give other names for the tools.
+#  Usage:    host/bench.sh [-t percent] [-o dir]
+#              -t  tolerance of the comparison in % (default 2)
+#              -o  directory of the build, of the gpsim log and of the
+#                  results file bench.txt (default host/bench_out)
+#*************************************************************************
+
+set -e
+
+HOST=$(cd "$(dirname "$0")" && pwd)
+SRC=$(dirname "$HOST")
+OUT=$HOST/bench_out
+TOL=2
+
+while getopts t:o: opt
+do
+	case $opt in
+	t) TOL=$OPTARG ;;
+	o) OUT=$OPTARG ;;
+	*) echo "usage: bench.sh [-t percent] [-o dir]" >&2; exit 1 ;;
+	esac
+done
+
+MCC18=${MCC18:-mcc18}
+MPLINK=${MPLINK:-mplink}
+GPSIM=${GPSIM:-gpsim}
+for tool in "$MCC18" "$MPLINK" "$GPSIM" gcc
+do
+	command -v "$tool" >/dev/null || { echo "bench.sh: $tool not found" >&2; exit 1; }
+done
+C18DIR=${C18DIR:-$(dirname "$(dirname "$(command -v "$MCC18")")")}
+LKR=
+for dir in "$C18DIR/bin/LKR" "$C18DIR/lkr"
+do
+	[ -f "$dir/18f2553_g.lkr" ] && LKR=$dir
+done
+[ -n "$LKR" ] || { echo "bench.sh: 18f2553_g.lkr not found under $C18DIR" >&2; exit 1; }
+
+# switches of the benchmark build (bench.h): Timer3 is the cycle counter and the results are a record
+DEFS="-DBENCH=1 -DJ1850_TX=0 -DDIAG=0 -DUSART_LOG_BINARY=1"
+
+mkdir -p "$OUT"
+rm -f "$OUT"/*.o "$OUT/tacho.cof" "$OUT/bench.log"
+for src in "$SRC"/*.c
+do
+	"$MCC18" -p=18F2553 -I="$SRC" -I="$C18DIR/h" $DEFS "$src" -fo="$OUT/$(basename "$src" .c).o"
+done
+"$MPLINK" /p18F2553 /l"$C18DIR/lib" "$LKR/18f2553_g.lkr" "$OUT"/*.o /u_CRUNTIME /W /M"$OUT/tacho.map" /o"$OUT/tacho.cof"
+
+gcc -O2 -o "$OUT/vpw_stim" "$HOST/vpw_stim.c" "$HOST/usart_log.c"
+gcc -O2 -o "$OUT/bench_report" "$HOST/bench_report.c" "$HOST/usart_log.c"
+
+cd "$OUT"
+./vpw_stim tacho.cof "$HOST/bench_frames.txt" > bench.stc
+"$GPSIM" -i -c bench.stc
+./bench_report bench.log > bench.txt
+cat bench.txt
+
+if [ ! -f "$HOST/bench_baseline.txt" ]
+then
+	cp bench.txt "$HOST/bench_baseline.txt"
+	echo "bench.sh: no baseline, the results have been written as host/bench_baseline.txt" >&2
+	exit 0
+fi
+status=0
+./bench_report -c "$HOST/bench_baseline.txt" -t "$TOL" bench.log > /dev/null || status=$?
+[ $status -eq 0 ] && echo "bench.sh: no regression against host/bench_baseline.txt (tolerance $TOL%)" >&2
+exit $status
@@ -0,0 +1,162 @@
+/*************************************************************************
+**  HARLEY DAVIDSON Sportster 883/1200 - J1850 VPW Interface
+**  Released under GNU GENERAL PUBLIC LICENSE
+**  Main MCU: MICROCHIP PIC18F2553
+**  Homepage: www.momex.cat
+**  Contact: morales.xavier@momex.cat
+**
+**
+**  Revision History
+**  11/06/2016   XM  v1.00   Initial Release on Github
+**
+**
+**  Abstract: Results file of a benchmark run. Reads the USART bytes of the
+**            benchmark build, from the gpsim log of the TXREG writes (lines
+**            with "Wrote: 0xNN to TXREG", see vpw_stim.c) or from a binary
+**            capture of the serial port (-b), and writes the last
+**            USART_LOG_BENCH record as "name value" lines, one per result.
+**            With -c the results are compared with a previous file and the
+**            exit code is 2 if any average or maximum has grown more than
+**            the tolerance, so a script can stop on a regression.
+**            Fitxer de resultats d'una mesura de cicles.
+**
+**  Build:    gcc -O2 -I.. -o bench_report bench_report.c usart_log.c
+**  Usage:    bench_report [-b] [-c baseline.txt] [-t percent] [log] > bench.txt
+**              -b     binary capture of the serial port (default: gpsim log)
+**              -c     results of a previous run to compare with
+**              -t     tolerance of the comparison in % (default 2)
+**************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../bench.h"
+#include "usart_log.h"
+
+// names of the probes on the results file, in BENCH_xxx order
+static const char *probe_name[BENCH_PROBES] = {"isr_high", "isr_low", "rx_edge", "send_databits", "refresh", "decode"};
+static const char *field_name[4] = {"runs", "min", "avg", "max"};
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Byte written on TXREG by a line of the gpsim log
+** Parameters: line
+** Returns: byte, -1 if the line is not a write of TXREG
+**---------------------------------------------------------------------------
+*/
+static int gpsim_txreg(const char *line)
+{
+	const char *p;
+	unsigned v;
+
+	if(!strstr(line, "TXREG") || !(p = strstr(line, "Wrote:"))) return -1;
+	if(sscanf(p + 6, " %x", &v) != 1) return -1;
+	return v & 0xFF;
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Value of a result on a previous results file
+** Parameters: file, name of the result
+** Returns: value, -1 if not found
+**---------------------------------------------------------------------------
+*/
+static long baseline_value(FILE *f, const char *name)
+{
+	char line[128], key[64];
+	long v;
+
+	rewind(f);
+	while(fgets(line, sizeof(line), f))
+	{
+		if(sscanf(line, "%63s %ld", key, &v) == 2 && strcmp(key, name) == 0) return v;
+	}
+	return -1;
+}
+
+int main(int argc, char **argv)
+{
+	usart_log_decoder d;
+	usart_log_record rec, bench;
+	FILE *in = stdin, *base = 0;
+	char line[256], name[64];
+	double tolerance = 2.0;
+	long v, old;
+	int binary = 0, found = 0, regressions = 0, ch, i, j;
+	const uint8_t *p;
+
+	for(i = 1; i < argc && argv[i][0] == '-' && argv[i][1]; i++)
+	{
+		if(strcmp(argv[i], "-b") == 0) binary = 1;
+		else if(strcmp(argv[i], "-t") == 0 && i + 1 < argc) tolerance = atof(argv[++i]);
+		else if(strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+		{
+			if(!(base = fopen(argv[++i], "r")))
+			{
+				perror(argv[i]);
+				return 1;
+			}
+		}
+		else
+		{
+			fprintf(stderr, "usage: bench_report [-b] [-c baseline.txt] [-t percent] [log]\n");
+			return 1;
+		}
+	}
+	if(i < argc && !(in = fopen(argv[i], binary ? "rb" : "r")))
+	{
+		perror(argv[i]);
+		return 1;
+	}
+
+	usart_log_init(&d);
+	if(binary)
+	{
+		while((ch = getc(in)) != EOF)
+		{
+			if(usart_log_feed(&d, ch, &rec) && rec.type == USART_LOG_BENCH && rec.size == BENCH_RECORD_LEN)
+			{
+				bench = rec;
+				found = 1;
+			}
+		}
+	}
+	else
+	{
+		while(fgets(line, sizeof(line), in))
+		{
+			if((ch = gpsim_txreg(line)) < 0) continue;
+			if(usart_log_feed(&d, ch, &rec) && rec.type == USART_LOG_BENCH && rec.size == BENCH_RECORD_LEN)
+			{
+				bench = rec;
+				found = 1;
+			}
+		}
+	}
+	if(!found || bench.payload[1] != BENCH_PROBES)
+	{
+		fprintf(stderr, "no USART_LOG_BENCH record (%lu records, %lu bad)\n", d.records, d.bad);
+		return 1;
+	}
+
+	p = bench.payload;
+	printf("empty_probe %u\n", p[2] | (p[3] << 8));
+	for(i = 0; i < BENCH_PROBES; i++)
+	{
+		for(j = 0; j < 4; j++)
+		{
+			v = p[BENCH_RECORD_HEADER + 8 * i + 2 * j] | (p[BENCH_RECORD_HEADER + 8 * i + 2 * j + 1] << 8);
+			snprintf(name, sizeof(name), "%s.%s", probe_name[i], field_name[j]);
+			printf("%s %ld\n", name, v);
+			if(!base || j < 2) continue;	// only the average and the maximum are compared
+			old = baseline_value(base, name);
+			if(old > 0 && v > old * (1.0 + tolerance / 100.0))
+			{
+				fprintf(stderr, "regression: %s %ld cycles, was %ld\n", name, v, old);
+				++regressions;
+			}
+		}
+	}
+	return regressions ? 2 : 0;
+}
@@ -0,0 +1,270 @@
+/*************************************************************************
+**  HARLEY DAVIDSON Sportster 883/1200 - J1850 VPW Interface
+**  Released under GNU GENERAL PUBLIC LICENSE
+**  Main MCU: MICROCHIP PIC18F2553
+**  Homepage: www.momex.cat
+**  Contact: morales.xavier@momex.cat
+**
+**
+**  Revision History
+**  11/06/2016   XM  v1.00   Initial Release on Github
+**
+**
+**  Abstract: PC check of the filters of filter.c on a synthetic ride with
+**            a known truth: rpm, speed, temperature and gear frames at
+**            their bus rates with sensor noise, wrong frames (rpm spikes,
+**            gear glitches) and the display refreshed every 100 ms as
+**            tacho_refresh() does. For each value the unfiltered display
+**            (last decoded value) is compared with the filter chain of
+**            tacho.c: display changes per minute, mean and maximum error
+**            against the truth, and the wrong gear / engine state time.
+**            The filters are also timed on the PC (ns per call), the PIC
+**            cycles are measured by the BENCH build (probe "decode").
+**            The same chain on real logs: tacho_replay -q (display changes).
+**            Comprova els filtres amb un trajecte sintetic.
+**
+**  Build:    gcc -O2 -I.. -o filter_bench filter_bench.c ../filter.c ../bcd.c -lm
+**  Usage:    filter_bench [seconds] [seed]
+**************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+#include "../filter.h"
+#include "../bcd.h"
+#include "../tacho.h"
+
+#define TICK_MS		5	// simulation step
+#define RPM_MS		25	// frame periods
+#define SPEED_MS	50
+#define TEMP_MS		500
+#define GEAR_MS		100
+#define DISPLAY_MS	100	// tacho_refresh
+
+#define RPM_NOISE	30.0	// standard deviation of the sensor noise
+#define SPEED_NOISE	0.6
+#define TEMP_NOISE	0.7
+#define RPM_SPIKES	150	// one wrong rpm frame out of
+#define GEAR_GLITCHES	40	// one wrong gear frame out of
+
+static const double gear_ratio[6] = {0, 0.0105, 0.0150, 0.0195, 0.0235, 0.0270};	// km/h per rpm
+
+// result of one displayed value
+typedef struct {
+	const char *name;
+	unsigned long changes;
+	double err_sum;
+	double err_max;
+	unsigned long n;
+	uint16_t last;
+} result;
+
+static double gauss(void)
+{
+	double u = (rand() + 1.0) / (RAND_MAX + 2.0);
+	double v = (rand() + 1.0) / (RAND_MAX + 2.0);
+
+	return sqrt(-2.0 * log(u)) * cos(2.0 * M_PI * v);
+}
+
+// rpm as bcd_rpm() shows it
+static uint16_t shown_rpm(uint16_t rpm)
+{
+	uint8_t d[4];
+	uint16_t v = 0;
+	int i;
+
+	bcd_rpm(rpm, d);
+	for(i = 3; i >= 0; i--)
+	{
+		v = v * 10 + (d[i] == BCD_OFF ? 0 : d[i]);
+	}
+	return v;
+}
+
+static void account(result *r, uint16_t shown, double truth)
+{
+	double e = fabs(shown - truth);
+
+	if(r->n && shown != r->last) ++r->changes;
+	r->last = shown;
+	r->err_sum += e;
+	if(e > r->err_max) r->err_max = e;
+	++r->n;
+}
+
+static void report(result *raw, result *flt, double minutes)
+{
+	printf("%-6s changes/min %7.1f -> %7.1f   mean error %6.2f -> %6.2f   max error %7.1f -> %7.1f\n",
+		raw->name, raw->changes / minutes, flt->changes / minutes,
+		raw->err_sum / raw->n, flt->err_sum / flt->n, raw->err_max, flt->err_max);
+}
+
+// gear for a speed, 1..5
+static int gear_of(double speed)
+{
+	if(speed < 20) return 1;
+	if(speed < 35) return 2;
+	if(speed < 50) return 3;
+	if(speed < 70) return 4;
+	return 5;
+}
+
+// truth of the ride at time t (ms): idle, launch up to 100 km/h through the gears, cruise, stop
+static void ride(long t, double *rpm, double *speed, int *gear, double *temp)
+{
+	double s = (t % 120000) / 1000.0;	// 2 minute cycle
+
+	*temp = 20.0 + 75.0 * (1.0 - exp(-t / 300000.0));
+	if(s < 15)
+	{
+		*speed = 0;
+		*gear = 0;
+		*rpm = 950;
+		return;
+	}
+	if(s < 60) *speed = 100.0 * (s - 15) / 45.0;
+	else if(s < 100) *speed = 100.0 + 5.0 * sin((s - 60) * 2.0 * M_PI / 40.0);
+	else *speed = 100.0 * (120 - s) / 20.0;
+	*gear = gear_of(*speed);
+	*rpm = fmax(950.0, *speed / gear_ratio[*gear]);
+}
+
+static void accuracy(long seconds)
+{
+	filter_median rpm_median;
+	filter_ema rpm_ema, speed_ema, temp_ema;
+	filter_hyst rpm_hyst, speed_hyst, temp_hyst;
+	filter_confirm gear_confirm, engon_confirm;
+	result rpm_r[2] = {{"rpm"}, {"rpm"}}, speed_r[2] = {{"speed"}, {"speed"}}, temp_r[2] = {{"temp"}, {"temp"}};
+	unsigned long gear_wrong[2] = {0, 0}, gear_changes[2] = {0, 0}, engon_wrong[2] = {0, 0}, shows = 0;
+	uint16_t rpm_raw = 0, speed_raw = 0, temp_raw = 0, gear_raw = 0, gear_flt = 0, engon_raw = 0, engon_flt = 0;
+	uint16_t last_gear[2] = {0, 0}, v;
+	double rpm, temp, speed;
+	int gear;
+	long t;
+
+	filter_median_init(&rpm_median);
+	filter_ema_init(&rpm_ema);
+	filter_ema_init(&speed_ema);
+	filter_ema_init(&temp_ema);
+	filter_hyst_init(&rpm_hyst);
+	filter_hyst_init(&speed_hyst);
+	filter_hyst_init(&temp_hyst);
+	filter_confirm_init(&gear_confirm, 0);
+	filter_confirm_init(&engon_confirm, 0);
+
+	for(t = 0; t < seconds * 1000; t += TICK_MS)
+	{
+		ride(t, &rpm, &speed, &gear, &temp);
+
+		if(t % RPM_MS == 0)	// same decode as frame_rpm
+		{
+			v = (uint16_t)(rpm + RPM_NOISE * gauss());
+			if(rand() % RPM_SPIKES == 0) v = (rand() & 1) ? 0 : 16000;
+			rpm_raw = v;
+			filter_ema_run(&rpm_ema, filter_median_run(&rpm_median, v), TACHO_RPM_EMA);
+			engon_raw = v > TACHO_ENGON_RPM;
+			if(v != TACHO_ENGON_RPM) engon_flt = filter_confirm_run(&engon_confirm, engon_raw, TACHO_ENGON_CONFIRM);
+		}
+		if(t % SPEED_MS == 0)	// frame_speed, the frame has 1/128 km/h
+		{
+			v = (uint16_t)(fmax(0.0, speed + SPEED_NOISE * gauss()) * 128.0) >> 7;
+			speed_raw = v;
+			filter_ema_run(&speed_ema, v, TACHO_SPEED_EMA);
+		}
+		if(t % TEMP_MS == 0)	// frame_temp
+		{
+			v = (uint16_t)(temp + TEMP_NOISE * gauss() + 0.5);
+			temp_raw = v;
+			filter_ema_run(&temp_ema, v, TACHO_TEMP_EMA);
+		}
+		if(t % GEAR_MS == 0)	// frame_gear
+		{
+			v = gear;
+			if(rand() % GEAR_GLITCHES == 0) v = rand() % 6;
+			gear_raw = v;
+			gear_flt = filter_confirm_run(&gear_confirm, v, TACHO_GEAR_CONFIRM);
+		}
+		if(t % DISPLAY_MS == 0 && t >= 1000)	// tacho_refresh, after the first second
+		{
+			account(&rpm_r[0], shown_rpm(rpm_raw), rpm);
+			account(&rpm_r[1], shown_rpm((filter_hyst_run(&rpm_hyst, rpm_ema.acc, TACHO_RPM_BAND) + ((1 << TACHO_RPM_EMA) >> 1)) >> TACHO_RPM_EMA), rpm);
+			account(&speed_r[0], speed_raw, speed);
+			account(&speed_r[1], (filter_hyst_run(&speed_hyst, speed_ema.acc, TACHO_SPEED_BAND) + ((1 << TACHO_SPEED_EMA) >> 1)) >> TACHO_SPEED_EMA, speed);
+			account(&temp_r[0], temp_raw, temp);
+			account(&temp_r[1], (filter_hyst_run(&temp_hyst, temp_ema.acc, TACHO_TEMP_BAND) + ((1 << TACHO_TEMP_EMA) >> 1)) >> TACHO_TEMP_EMA, temp);
+			gear_wrong[0] += gear_raw != gear;
+			gear_wrong[1] += gear_flt != gear;
+			gear_changes[0] += shows && gear_raw != last_gear[0];
+			gear_changes[1] += shows && gear_flt != last_gear[1];
+			last_gear[0] = gear_raw;
+			last_gear[1] = gear_flt;
+			engon_wrong[0] += engon_raw != 1;	// the engine runs all the ride
+			engon_wrong[1] += engon_flt != 1;
+			++shows;
+		}
+	}
+
+	printf("ride of %ld s, display refreshes %lu (unfiltered -> filtered)\n", seconds, shows);
+	report(&rpm_r[0], &rpm_r[1], seconds / 60.0);
+	report(&speed_r[0], &speed_r[1], seconds / 60.0);
+	report(&temp_r[0], &temp_r[1], seconds / 60.0);
+	printf("%-6s changes/min %7.1f -> %7.1f   wrong %5.2f%% -> %5.2f%%\n", "gear",
+		gear_changes[0] * 60.0 / seconds, gear_changes[1] * 60.0 / seconds,
+		100.0 * gear_wrong[0] / shows, 100.0 * gear_wrong[1] / shows);
+	printf("%-6s wrong %5.2f%% -> %5.2f%%\n", "engon", 100.0 * engon_wrong[0] / shows, 100.0 * engon_wrong[1] / shows);
+}
+
+static double ns_now(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+static void timing(void)
+{
+	static uint16_t in[4096];
+	filter_median m;
+	filter_ema e;
+	filter_hyst h;
+	filter_confirm c;
+	volatile uint16_t sink = 0;
+	const long n = 20000000;
+	double t0;
+	long i;
+
+	for(i = 0; i < 4096; i++) in[i] = 3000 + rand() % 200;
+	filter_median_init(&m);
+	filter_ema_init(&e);
+	filter_hyst_init(&h);
+	filter_confirm_init(&c, 0);
+
+	t0 = ns_now();
+	for(i = 0; i < n; i++) sink = filter_median_run(&m, in[i & 4095]);
+	printf("filter_median_run  %5.2f ns/call\n", (ns_now() - t0) / n);
+	t0 = ns_now();
+	for(i = 0; i < n; i++) sink = filter_ema_run(&e, in[i & 4095], TACHO_RPM_EMA);
+	printf("filter_ema_run     %5.2f ns/call\n", (ns_now() - t0) / n);
+	t0 = ns_now();
+	for(i = 0; i < n; i++) sink = filter_hyst_run(&h, in[i & 4095], TACHO_RPM_BAND);
+	printf("filter_hyst_run    %5.2f ns/call\n", (ns_now() - t0) / n);
+	t0 = ns_now();
+	for(i = 0; i < n; i++) sink = filter_confirm_run(&c, in[i & 4095] & 3, TACHO_GEAR_CONFIRM);
+	printf("filter_confirm_run %5.2f ns/call\n", (ns_now() - t0) / n);
+	(void)sink;
+}
+
+int main(int argc, char **argv)
+{
+	long seconds = argc > 1 ? atol(argv[1]) : 3600;
+
+	srand(argc > 2 ? atoi(argv[2]) : 1);
+	accuracy(seconds);
+	timing();
+	return 0;
+}
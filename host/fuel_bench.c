@@ -0,0 +1,178 @@
+/*************************************************************************
+**  HARLEY DAVIDSON Sportster 883/1200 - J1850 VPW Interface
+**  Released under GNU GENERAL PUBLIC LICENSE
+**  Main MCU: MICROCHIP PIC18F2553
+**  Homepage: www.momex.cat
+**  Contact: morales.xavier@momex.cat
+**
+**
+**  Revision History
+**  11/06/2016   XM  v1.00   Initial Release on Github
+**
+**
+**  Abstract: PC check of the fixed point fuel consumption (fuel.c) against
+**            the float formula of the old tacho.c computed in double, on a
+**            grid of rpm (0..8000, in 1/2 rpm) and speeds (0..200 km/h, in
+**            1/16 km/h) for L/100km and MPG, of fuel_average() on a ramp
+**            and of the rpm corrected by fuel_air() (engine load and air
+**            temperature of the ECM, diag.c) in rpm. The results have to be within 1 unit of the last digit
+**            (0.1) plus 0.2% (the speed is rounded to 1/64 km/h), the exit
+**            code is 1 otherwise. The PIC cycles of the mode 3 refresh are
+**            measured by the BENCH build (probe "refresh", vpw_stim -m 3),
+**            here both versions are only timed on the PC.
+**            Compara el consum amb enters amb el calcul en double.
+**
+**  Build:    gcc -O2 -I.. -o fuel_bench fuel_bench.c ../fuel.c
+**  Usage:    fuel_bench [rounds]
+**************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../fuel.h"
+
+// the float formula of the old tacho.c, with the FUEL_* constants
+static double ref_l100(double rpm, double speed)
+{
+	return (FUEL_DISPLACEMENT_CC / 2000.0) * rpm * (FUEL_VE_PCT / 100.0) * (FUEL_AIR_MG_L / 1000.0) *
+		(100.0 / FUEL_AFR_X100) * (1.0 / FUEL_DENSITY_G_L) * (1.0 / speed) * 100 * 60;
+}
+
+// same limits as fuel.c, value x 10
+static double ref_limit(double val)
+{
+	val *= 10;
+	return val > FUEL_MAX ? FUEL_MAX : val;
+}
+
+typedef struct {
+	const char *name;
+	unsigned long n, off;	// values, values out of the tolerance
+	double err_max;
+} check;
+
+static void compare(check *c, uint16_t got, double ref)
+{
+	double e;
+
+	if(got == FUEL_NONE)
+	{
+		++c->off;	// the callers only ask for values
+		return;
+	}
+	e = got - ref;
+	if(e < 0) e = -e;
+	if(e > c->err_max) c->err_max = e;
+	if(e > 1.0 + ref * 0.002) ++c->off;
+	++c->n;
+}
+
+static double ns_now(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+int main(int argc, char **argv)
+{
+	long rounds = argc > 1 ? atol(argv[1]) : 20;
+	check l100 = {"L/100km"}, mpg = {"MPG"}, avg = {"average"}, air = {"air rpm"};
+	volatile uint16_t sink;
+	volatile double dsink;
+	unsigned long none = 0, calls;
+	uint16_t rpm4, speed16, rpm;
+	int load, iat40;
+	double ref, t0, t_fixed, t_double;
+	long r, i;
+
+	printf("FUEL_K_Q12 %lu (exact %.2f), FUEL_MPG_Q2 %lu\n", (unsigned long)FUEL_K_Q12,
+		ref_l100(1, 1) * 10 * 4096, (unsigned long)FUEL_MPG_Q2);
+
+	for(rpm4 = 0; rpm4 <= 8000 * 4; rpm4 += 2)
+	{
+		for(speed16 = 0; speed16 <= 200 * 16; speed16++)
+		{
+			if(speed16 * 4 < FUEL_MIN_SPEED * 64)
+			{
+				none += fuel_l100(rpm4, speed16 * 4) != FUEL_NONE;
+				none += fuel_mpg(rpm4, speed16 * 4) != FUEL_NONE;
+				continue;
+			}
+			ref = ref_l100(rpm4 / 4.0, speed16 / 16.0);
+			compare(&l100, fuel_l100(rpm4, speed16 * 4), ref_limit(ref));
+			compare(&mpg, fuel_mpg(rpm4, speed16 * 4), rpm4 ? ref_limit(FUEL_MPG_X1000 / 1000.0 / ref) : FUEL_MAX);
+		}
+	}
+
+	// rolling average: rpm and speed ramps, the reference is the ratio of the same EMAs in double
+	{
+		double er = 0, es = 0, rpm, speed;
+
+		fuel_init();
+		for(i = 0; i < 20000; i++)
+		{
+			rpm = 1000 + (i % 4000);
+			speed = (i / 40) % 180;
+			fuel_update((uint16_t)rpm, (uint16_t)speed);
+			er += (rpm - er) / (1 << FUEL_AVG_SHIFT);
+			es += (speed - es) / (1 << FUEL_AVG_SHIFT);
+			if(es < FUEL_MIN_SPEED + 0.1) continue;	// leave the limit out
+			ref = ref_l100(er, es);
+#if FUEL_UNITS == FUEL_MPG
+			ref = FUEL_MPG_X1000 / 1000.0 / ref;
+#endif
+			compare(&avg, fuel_average(), ref_limit(ref));
+		}
+	}
+
+	// rpm x load / FUEL_VE_PCT x (273 + FUEL_AIR_TEMP) / (273 + air temperature), FUEL_UNKNOWN leaves it out
+	for(rpm = 0; rpm <= 8000; rpm += 10)
+	{
+		for(load = 0; load <= 100 || load == FUEL_UNKNOWN; load = load == 100 ? FUEL_UNKNOWN : load + 1)
+		{
+			for(iat40 = 0; iat40 <= FUEL_UNKNOWN; iat40 += 3)
+			{
+				ref = rpm;
+				if(load != FUEL_UNKNOWN) ref = ref * load / FUEL_VE_PCT;
+				if(iat40 != FUEL_UNKNOWN) ref = ref * (273 + FUEL_AIR_TEMP) / (233 + iat40);
+				compare(&air, fuel_air(rpm, (uint8_t)load, (uint8_t)iat40), ref > FUEL_RPM_MAX ? FUEL_RPM_MAX : ref);
+			}
+			if(load == FUEL_UNKNOWN) break;
+		}
+	}
+
+	printf("%-8s %8lu values, max error %.3f, out of tolerance %lu\n", l100.name, l100.n, l100.err_max / 10, l100.off);
+	printf("%-8s %8lu values, max error %.3f, out of tolerance %lu\n", mpg.name, mpg.n, mpg.err_max / 10, mpg.off);
+	printf("%-8s %8lu values, max error %.3f, out of tolerance %lu\n", avg.name, avg.n, avg.err_max / 10, avg.off);
+	printf("%-8s %8lu values, max error %.3f rpm, out of tolerance %lu\n", air.name, air.n, air.err_max, air.off);
+	printf("below %d km/h not FUEL_NONE: %lu\n", FUEL_MIN_SPEED, none);
+
+	calls = 0;
+	t0 = ns_now();
+	for(r = 0; r < rounds; r++)
+	{
+		for(rpm4 = 4000; rpm4 < 24000; rpm4 += 7)
+		{
+			sink = fuel_l100(rpm4, 6400 + (rpm4 & 4095));
+			++calls;
+		}
+	}
+	t_fixed = (ns_now() - t0) / calls;
+	t0 = ns_now();
+	for(r = 0; r < rounds; r++)
+	{
+		for(rpm4 = 4000; rpm4 < 24000; rpm4 += 7)
+		{
+			dsink = ref_l100(rpm4 / 4.0, (6400 + (rpm4 & 4095)) / 64.0);
+		}
+	}
+	t_double = (ns_now() - t0) / calls;
+	(void)sink;
+	(void)dsink;
+	printf("PC time: fuel_l100 %.2f ns, double formula %.2f ns\n", t_fixed, t_double);
+
+	return (l100.off || mpg.off || avg.off || air.off || none) ? 1 : 0;
+}
@@ -0,0 +1,549 @@
+/*************************************************************************
+**  HARLEY DAVIDSON Sportster 883/1200 - J1850 VPW Interface
+**  Released under GNU GENERAL PUBLIC LICENSE
+**  Main MCU: MICROCHIP PIC18F2553
+**  Homepage: www.momex.cat
+**  Contact: morales.xavier@momex.cat
+**
+**
+**  Revision History
+**  11/06/2016   XM  v1.00   Initial Release on Github
+**
+**
+**   NOTE: Simulated hardware of the PC build (see hal_host.h). Everything
+**         happens on the virtual clock: the bus edges sent by the other
+**         nodes are queued with their cycle and applied by
+**         hal_host_advance(), which also sets the interrupt flags and calls
+**         hal_host_irq() like the PIC would do.
+**************************************************************************/
+
+#include "../hal.h"
+
+#define BUS_EVENTS	512	// queued edges of the other nodes, has to be a power of 2
+
+// nominal VPW symbols sent by the other nodes, in us
+#define BUS_SHORT_US	64
+#define BUS_LONG_US	128
+#define BUS_SOF_US	200
+#define BUS_IFS_US	300
+
+typedef struct {
+	uint8_t con;		// TxCON
+	int64_t origin;		// clock cycle when the counter was 0 (running timer)
+	uint16_t held;		// counter value while stopped
+} host_timer;
+
+typedef struct {
+	uint64_t cycle;
+	uint8_t active;
+} bus_event;
+
+uint64_t hal_host_clock;
+void (*hal_host_irq)(void);
+void (*hal_host_irq_low)(void);
+volatile hal_host_intcon INTCONbits;
+volatile hal_host_intcon2 INTCON2bits;
+volatile hal_host_pir1 PIR1bits;
+volatile hal_host_pie1 PIE1bits;
+volatile hal_host_ipr1 IPR1bits;
+volatile hal_host_pir2 PIR2bits;
+volatile hal_host_pie2 PIE2bits;
+volatile hal_host_ipr2 IPR2bits;
+hal_host_board hal_host_pins;
+uint32_t hal_host_bus_edges;
+uint8_t hal_host_bus_speed;
+uint8_t hal_host_mm5450[5];
+uint32_t hal_host_mm5450_transfers;
+void (*hal_host_usart_out)(uint8_t ch);
+
+static host_timer timers[4];	// Timer0, 1 and 3 (2 is the PWM, not simulated)
+static uint32_t timer2_period;	// cycles between TMR2IF, 0=stopped
+static uint64_t timer2_next;	// cycle of the next TMR2IF
+static uint8_t ccp2_on;		// CCP2 on compare mode
+static uint16_t ccp2_value;	// CCPR2
+static uint8_t in_irq, in_irq_low;
+static int64_t usart_tx_done;	// cycle when the byte being sent is finished, INT64_MAX if none
+static uint8_t usart_tx_byte;	// byte being sent
+static uint8_t usart_rx_byte;	// RCREG
+
+static bus_event bus_queue[BUS_EVENTS];
+static uint16_t bus_head, bus_tail;
+static uint8_t bus_tx, bus_ext;	// level driven by us and by the other nodes
+static uint64_t bus_free;	// first cycle the other nodes may start a new frame
+
+static uint8_t mm_clock, mm_data, mm_bits;
+static uint8_t mm_shift[5];
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Timer configuration from TxCON: running, prescaler and width
+** Parameters: timer number, TxCON value
+** Returns: see each function
+**---------------------------------------------------------------------------
+*/
+static uint8_t timer_on(uint8_t n, uint8_t con)
+{
+	return n == 0 ? (con & 0x80) != 0 : (con & 0x01) != 0;	// TMR0ON / TMRxON
+}
+
+static uint32_t timer_prescale(uint8_t n, uint8_t con)
+{
+	if(n == 0) return (con & 0x08) ? 1 : 2u << (con & 0x07);	// PSA, T0PS2:T0PS0
+	return 1u << ((con >> 4) & 0x03);				// TxCKPS1:TxCKPS0
+}
+
+static uint8_t timer_bits(uint8_t n, uint8_t con)
+{
+	return (n == 0 && (con & 0x40)) ? 8 : 16;	// T08BIT
+}
+
+static uint32_t timer_count(uint8_t n)
+{
+	host_timer *t = &timers[n];
+
+	if(!timer_on(n, t->con)) return t->held;
+	return (uint32_t)(((int64_t)hal_host_clock - t->origin) / timer_prescale(n, t->con));
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Cycle of the next CCP2 match (Timer1 counting up to CCPR2), after the current count
+** Parameters: none
+** Returns: cycle, INT64_MAX if CCP2 or Timer1 are off
+**---------------------------------------------------------------------------
+*/
+static int64_t ccp2_next(void)
+{
+	host_timer *t1 = &timers[1];
+	uint32_t ps;
+	int64_t count;
+	uint16_t delta;
+
+	if(!ccp2_on || !timer_on(1, t1->con)) return INT64_MAX;
+	ps = timer_prescale(1, t1->con);
+	count = ((int64_t)hal_host_clock - t1->origin) / ps;
+	delta = ccp2_value - (uint16_t)count;
+	return t1->origin + (count + (delta ? delta : 0x10000)) * ps;
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Call the ISRs while an enabled interrupt is pending. The high priority ISR can
+**           interrupt the low priority one but it is not nested itself, the timer reads inside
+**           an ISR only move the clock
+** Parameters: none
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+static void service_irq(void)
+{
+	if(in_irq) return;
+	while(hal_host_irq && INTCONbits.GIEH &&
+	      ((INTCONbits.INT0IE && INTCONbits.INT0IF) || (INTCONbits.TMR0IE && INTCONbits.TMR0IF) ||
+	       (PIE2bits.TMR3IE && PIR2bits.TMR3IF) || (PIE1bits.TMR1IE && PIR1bits.TMR1IF)))
+	{
+		in_irq = 1;
+		hal_host_irq();
+		in_irq = 0;
+	}
+	if(in_irq_low) return;
+	while(hal_host_irq_low && INTCONbits.GIEH && INTCONbits.GIEL &&
+	      ((PIE1bits.TMR2IE && PIR1bits.TMR2IF) || (PIE1bits.TXIE && PIR1bits.TXIF) ||
+	       (PIE1bits.RCIE && PIR1bits.RCIF) || (PIE2bits.CCP2IE && PIR2bits.CCP2IF)))
+	{
+		in_irq_low = 1;
+		hal_host_irq_low();
+		in_irq_low = 0;
+	}
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Move the clock up to a cycle, setting TMR0IF on each Timer0 overflow, TMR1IF and TMR3IF
+**           on each Timer1 and Timer3 overflow, TMR2IF on each Timer2 period, CCP2IF on each CCP2 match and TXIF
+**           at the end of each USART byte on the way. While TMR2IE is off the Timer2 periods are skipped at once, the flag only
+**           has to be set
+** Parameters: cycle
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+static void run_to(uint64_t cycle)
+{
+	host_timer *t0 = &timers[0], *t1 = &timers[1], *t3 = &timers[3];
+	uint32_t ps, period;
+	int64_t next, next0, next1, next2, next3;
+
+	for(;;)
+	{
+		next = INT64_MAX;
+		next0 = INT64_MAX;
+		if(timer_on(0, t0->con))
+		{
+			ps = timer_prescale(0, t0->con);
+			period = 1u << timer_bits(0, t0->con);
+			next0 = t0->origin + (int64_t)((timer_count(0) / period) + 1) * period * ps;
+			next = next0;
+		}
+		next1 = INT64_MAX;
+		if(timer_on(1, t1->con))
+		{
+			ps = timer_prescale(1, t1->con);
+			next1 = t1->origin + (int64_t)((timer_count(1) >> 16) + 1) * 0x10000 * ps;
+			if(next1 < next) next = next1;
+		}
+		next3 = INT64_MAX;
+		if(timer_on(3, t3->con))
+		{
+			ps = timer_prescale(3, t3->con);
+			next3 = t3->origin + (int64_t)((timer_count(3) >> 16) + 1) * 0x10000 * ps;
+			if(next3 < next) next = next3;
+		}
+		if(timer2_period)
+		{
+			if(!PIE1bits.TMR2IE && timer2_next <= cycle)
+			{
+				PIR1bits.TMR2IF = 1;
+				timer2_next += (cycle - timer2_next) / timer2_period * timer2_period + timer2_period;
+			}
+			if((int64_t)timer2_next < next) next = timer2_next;
+		}
+		next2 = ccp2_next();
+		if(next2 < next) next = next2;
+		if(usart_tx_done < next) next = usart_tx_done;
+		if(next > (int64_t)cycle) break;
+
+		if(next > (int64_t)hal_host_clock) hal_host_clock = next;
+		if(next == next0) INTCONbits.TMR0IF = 1;
+		if(next == next1) PIR1bits.TMR1IF = 1;
+		if(next == next3) PIR2bits.TMR3IF = 1;
+		if(next == next2) PIR2bits.CCP2IF = 1;
+		if(next == usart_tx_done)
+		{
+			usart_tx_done = INT64_MAX;
+			PIR1bits.TXIF = 1;
+			if(hal_host_usart_out) hal_host_usart_out(usart_tx_byte);
+		}
+		if(timer2_period && (int64_t)timer2_next == next)
+		{
+			PIR1bits.TMR2IF = 1;
+			timer2_next += timer2_period;
+		}
+		service_irq();
+	}
+	if(cycle > hal_host_clock) hal_host_clock = cycle;
+	service_irq();
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: New bus level. INT0IF is set if the edge is the one selected by INTEDG0
+** Parameters: level before the change
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+static void bus_update(uint8_t was_active)
+{
+	uint8_t active = bus_tx | bus_ext;
+
+	if(active == was_active) return;
+	++hal_host_bus_edges;
+	if(active ? INTCON2bits.INTEDG0 == VPW_ACTIVE_EDGE : INTCON2bits.INTEDG0 != VPW_ACTIVE_EDGE)
+	{
+		INTCONbits.INT0IF = 1;
+	}
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Power on reset of the simulated hardware, the clock goes back to 0
+** Parameters: none
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+void hal_host_reset(void)
+{
+	uint8_t i;
+
+	hal_host_clock = 0;
+	in_irq = 0;
+	in_irq_low = 0;
+	*(uint8_t *)&INTCONbits = 0;
+	*(uint8_t *)&INTCON2bits = 0;
+	*(uint8_t *)&PIR1bits = 0;
+	*(uint8_t *)&PIE1bits = 0;
+	*(uint8_t *)&IPR1bits = 0xFF;
+	*(uint8_t *)&PIR2bits = 0;
+	*(uint8_t *)&PIE2bits = 0;
+	*(uint8_t *)&IPR2bits = 0xFF;
+	INTCON2bits.RBPU = 1;		// reset values
+	INTCON2bits.INTEDG0 = 1;
+	INTCON2bits.TMR0IP = 1;
+	PIR1bits.TXIF = 1;		// TXREG empty
+	usart_tx_done = INT64_MAX;
+	usart_rx_byte = 0;
+	for(i = 0; i < 4; i++)
+	{
+		timers[i].con = 0;
+		timers[i].origin = 0;
+		timers[i].held = 0;
+	}
+	timer2_period = 0;
+	ccp2_on = 0;
+	ccp2_value = 0;
+	bus_head = bus_tail = 0;
+	bus_tx = bus_ext = 0;
+	bus_free = 0;
+	hal_host_bus_edges = 0;
+	hal_host_bus_speed = 0;
+	mm_clock = mm_data = mm_bits = 0;
+	for(i = 0; i < 5; i++) hal_host_mm5450[i] = mm_shift[i] = 0;
+	hal_host_mm5450_transfers = 0;
+	hal_host_pins.button = 1;	// released (pull-up)
+	hal_host_pins.led_mode0 = hal_host_pins.led_mode1 = hal_host_pins.led_mode2 = 0;
+	hal_host_pins.dig3 = hal_host_pins.rpm_bar = 0;
+	hal_host_pins.gear_7seg = 0;
+	hal_host_pins.brightness = 0;
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Let some instruction cycles pass. The queued bus edges and the timer overflows
+**           on the way are applied in order, and the ISR is called for each of them
+** Parameters: number of cycles
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+void hal_host_advance(uint32_t cycles)
+{
+	uint64_t target = hal_host_clock + cycles;
+	bus_event *ev;
+	uint8_t was_active;
+
+	while(bus_tail != bus_head && bus_queue[bus_tail].cycle <= target)
+	{
+		ev = &bus_queue[bus_tail];
+		run_to(ev->cycle);
+		if(ev != &bus_queue[bus_tail]) continue;	// already applied by a timer read of an ISR on the way
+		was_active = bus_tx | bus_ext;
+		bus_ext = ev->active;
+		bus_tail = (bus_tail + 1) & (BUS_EVENTS - 1);
+		bus_update(was_active);
+		service_irq();
+	}
+	run_to(target);
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Timer control, write of TxCON / start with the counter at 0 / read / write of the counter
+** Parameters: timer number (0, 1 or 3), TxCON value or counter value
+** Returns: counter (hal_host_timer_get)
+**---------------------------------------------------------------------------
+*/
+void hal_host_timer_con(uint8_t n, uint8_t con)
+{
+	host_timer *t = &timers[n];
+	uint32_t count = timer_count(n);
+
+	t->con = con;
+	t->held = (uint16_t)count;
+	t->origin = (int64_t)hal_host_clock - (int64_t)t->held * timer_prescale(n, con);
+}
+
+void hal_host_timer_start(uint8_t n, uint8_t con)
+{
+	hal_host_timer_con(n, con);
+	hal_host_timer_set(n, 0);
+}
+
+uint16_t hal_host_timer_get(uint8_t n)
+{
+	uint32_t count;
+
+	hal_host_advance(HAL_HOST_POLL_CYCLES);
+	count = timer_count(n);
+	return timer_bits(n, timers[n].con) == 8 ? (uint8_t)count : (uint16_t)count;
+}
+
+void hal_host_timer_set(uint8_t n, uint16_t value)
+{
+	host_timer *t = &timers[n];
+
+	if(timer_bits(n, t->con) == 8) value &= 0xFF;
+	t->held = value;
+	t->origin = (int64_t)hal_host_clock - (int64_t)value * timer_prescale(n, t->con);
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Start Timer2, TMR2IF is set every period (OpenTimer2 + OpenPWM1 of main.c)
+** Parameters: cycles between two TMR2IF (HAL_HOST_TIMER2_PERIOD)
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+void hal_host_timer2_start(uint32_t period)
+{
+	timer2_period = period;
+	timer2_next = hal_host_clock + period;
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: CCP2 on compare mode with Timer1 (CCP2CON=0b00001010): CCP2IF is set each time Timer1
+**           reaches CCPR2 / write of CCPR2
+** Parameters: CCPR2 value (hal_host_ccp2_set)
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+void hal_host_ccp2_start(void)
+{
+	ccp2_on = 1;
+}
+
+void hal_host_ccp2_set(uint16_t value)
+{
+	ccp2_value = value;
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Our side of the bus, transmitter output and receiver input (after the NPN, so
+**           active means the bus is active)
+** Parameters: level to drive
+** Returns: bus level (hal_host_bus_active)
+**---------------------------------------------------------------------------
+*/
+void hal_host_bus_drive(uint8_t active)
+{
+	uint8_t was_active = bus_tx | bus_ext;
+
+	bus_tx = active != 0;
+	bus_update(was_active);
+	hal_host_advance(1);
+}
+
+uint8_t hal_host_bus_active(void)
+{
+	hal_host_advance(HAL_HOST_POLL_CYCLES);
+	return bus_tx | bus_ext;
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Other node sending a frame with the nominal VPW timing of hal_host_bus_speed (4x: the
+**           times divided by 4). It starts at the given cycle, or after the inter frame separation
+**           of the previous one. The bytes are sent as they are, the CRC has to be on msg_buf
+** Parameters: first cycle, pointer to the frame, number of bytes (max 12)
+** Returns: cycle of the last edge (end of the frame), 0 if the edge queue is full
+**---------------------------------------------------------------------------
+*/
+uint64_t hal_host_bus_frame(uint64_t start, const uint8_t *msg_buf, uint8_t nbytes)
+{
+	uint16_t free_events = (bus_tail - bus_head - 1) & (BUS_EVENTS - 1);
+	uint64_t t;
+	uint8_t level, bit, i, j, sh;
+
+	if(free_events < 2 + 8 * nbytes) return 0;
+	sh = hal_host_bus_speed ? 2 : 0;
+	if(start < bus_free) start = bus_free;
+	if(start < hal_host_clock) start = hal_host_clock;
+
+	t = start;
+	level = 1;		// SOF
+	bus_queue[bus_head].cycle = t;
+	bus_queue[bus_head].active = level;
+	bus_head = (bus_head + 1) & (BUS_EVENTS - 1);
+	t += (BUS_SOF_US * HAL_HOST_CYCLES_US) >> sh;
+	for(i = 0; i < nbytes; i++)
+	{
+		for(j = 0; j < 8; j++)
+		{
+			level ^= 1;
+			bus_queue[bus_head].cycle = t;
+			bus_queue[bus_head].active = level;
+			bus_head = (bus_head + 1) & (BUS_EVENTS - 1);
+			bit = (msg_buf[i] >> (7 - j)) & 1;
+			// passive symbol: 1=long, active symbol: 1=short
+			t += (((bit ^ level) ? BUS_LONG_US : BUS_SHORT_US) * HAL_HOST_CYCLES_US) >> sh;
+		}
+	}
+	if(level)		// EOD, bus back to passive
+	{
+		bus_queue[bus_head].cycle = t;
+		bus_queue[bus_head].active = 0;
+		bus_head = (bus_head + 1) & (BUS_EVENTS - 1);
+	}
+	bus_free = t + ((BUS_IFS_US * HAL_HOST_CYCLES_US) >> sh);
+	return t;
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: MM5450 pins. On each rising edge of the clock the data pin is shifted in. The first 1
+**           is the start bit, the 35 following bits are latched on the outputs after the 36th clock
+** Parameters: pin level
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+void hal_host_mm5450_clock(uint8_t level)
+{
+	uint8_t i;
+
+	if(level && !mm_clock)
+	{
+		if(mm_bits == 0)
+		{
+			if(mm_data)	// start bit
+			{
+				for(i = 0; i < 5; i++) mm_shift[i] = 0;
+				mm_bits = 1;
+			}
+		}
+		else
+		{
+			if(mm_data) mm_shift[(mm_bits - 1) >> 3] |= 0x80 >> ((mm_bits - 1) & 7);
+			if(++mm_bits == 36)
+			{
+				for(i = 0; i < 5; i++) hal_host_mm5450[i] = mm_shift[i];
+				++hal_host_mm5450_transfers;
+				mm_bits = 0;
+			}
+		}
+	}
+	mm_clock = level != 0;
+	hal_host_advance(1);
+}
+
+void hal_host_mm5450_data(uint8_t level)
+{
+	mm_data = level != 0;
+	hal_host_advance(1);
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: USART. Write of TXREG: the byte is sent in HAL_HOST_USART_CYCLES, TXIF is 0 until then
+**           (one byte at a time, the transmit shift register is not simulated) / read of RCREG,
+**           clears RCIF / byte sent by the PC, sets RCIF (the previous byte is lost if not read)
+** Parameters: byte (hal_host_usart_write, hal_host_usart_in)
+** Returns: RCREG (hal_host_usart_read)
+**---------------------------------------------------------------------------
+*/
+void hal_host_usart_write(uint8_t ch)
+{
+	usart_tx_byte = ch;
+	usart_tx_done = (int64_t)hal_host_clock + HAL_HOST_USART_CYCLES;
+	PIR1bits.TXIF = 0;
+}
+
+uint8_t hal_host_usart_read(void)
+{
+	PIR1bits.RCIF = 0;
+	return usart_rx_byte;
+}
+
+void hal_host_usart_in(uint8_t ch)
+{
+	usart_rx_byte = ch;
+	PIR1bits.RCIF = 1;
+}
@@ -0,0 +1,186 @@
+/*************************************************************************
+**  HARLEY DAVIDSON Sportster 883/1200 - J1850 VPW Interface
+**  Released under GNU GENERAL PUBLIC LICENSE
+**  Main MCU: MICROCHIP PIC18F2553
+**  Homepage: www.momex.cat
+**  Contact: morales.xavier@momex.cat
+**
+**
+**  Revision History
+**  11/06/2016   XM  v1.00   Initial Release on Github
+**
+**
+**   NOTE: PC backend of hal.h. Same macros as hal_pic18.h, backed by a
+**         simulation of the hardware (hal_host.c):
+**         - virtual clock in instruction cycles (Fosc/4 = 5MHz, 0.2us),
+**           Timer0/1/3 count from it. Reading a timer or the bus spends
+**           HAL_HOST_POLL_CYCLES, so the busy waits of the firmware end
+**         - virtual J1850 bus line, driven by our transmitter (vpw_active)
+**           and by the other nodes (hal_host_bus_frame), edges set INT0IF
+**         - virtual MM5450 shift register, latched after 36 clocks
+**         - Timer2 period interrupt (TMR2IF), the PWM itself is not simulated
+**         - CCP2 compare with Timer1 (CCP2IF), Timer1 overflow (TMR1IF)
+**         - USART at 115200 baud: TXIF is cleared while a byte is being
+**           sent, RCIF is set by hal_host_usart_in()
+**         - the few interrupt SFRs used by the modules, as variables
+**         Simulacio del hardware per compilar els moduls al PC.
+**************************************************************************/
+
+#ifndef __HAL_HOST_H__	//if hal_host.h has not been defined--> define it || if yes --> do nothing
+#define __HAL_HOST_H__
+
+#include "../macros.h"
+
+#define HAL_HOST_CYCLES_US	(INT_CLK / 1000000L)	// instruction cycles per us
+#define HAL_HOST_POLL_CYCLES	4	// cycles spent by a timer or pin read (the loop around it)
+
+extern uint64_t hal_host_clock;		// instruction cycles since hal_host_reset()
+extern void (*hal_host_irq)(void);	// high priority ISR, called when an enabled interrupt flag is set
+extern void (*hal_host_irq_low)(void);	// low priority ISR
+
+/***************************************************************************
+**   Interrupt SFRs (only the bits used by the modules)
+***************************************************************************/
+typedef struct {
+	unsigned RBIF:1, INT0IF:1, TMR0IF:1, RBIE:1, INT0IE:1, TMR0IE:1, GIEL:1, GIEH:1;
+} hal_host_intcon;
+
+typedef struct {
+	unsigned RBIP:1, unused1:1, TMR0IP:1, unused3:1, INTEDG2:1, INTEDG1:1, INTEDG0:1, RBPU:1;
+} hal_host_intcon2;
+
+typedef struct {
+	unsigned TMR1IF:1, TMR2IF:1, CCP1IF:1, SSPIF:1, TXIF:1, RCIF:1, ADIF:1, SPPIF:1;
+} hal_host_pir1;	// also PIE1 (xxIE) and IPR1 (xxIP), same bits
+
+typedef struct {
+	unsigned TMR1IE:1, TMR2IE:1, CCP1IE:1, SSPIE:1, TXIE:1, RCIE:1, ADIE:1, SPPIE:1;
+} hal_host_pie1;
+
+typedef struct {
+	unsigned TMR1IP:1, TMR2IP:1, CCP1IP:1, SSPIP:1, TXIP:1, RCIP:1, ADIP:1, SPPIP:1;
+} hal_host_ipr1;
+
+typedef struct {
+	unsigned CCP2IF:1, TMR3IF:1, HLVDIF:1, BCLIF:1, EEIF:1, USBIF:1, CMIF:1, OSCFIF:1;
+} hal_host_pir2;
+
+typedef struct {
+	unsigned CCP2IE:1, TMR3IE:1, HLVDIE:1, BCLIE:1, EEIE:1, USBIE:1, CMIE:1, OSCFIE:1;
+} hal_host_pie2;
+
+typedef struct {
+	unsigned CCP2IP:1, TMR3IP:1, HLVDIP:1, BCLIP:1, EEIP:1, USBIP:1, CMIP:1, OSCFIP:1;
+} hal_host_ipr2;
+
+extern volatile hal_host_intcon INTCONbits;
+extern volatile hal_host_intcon2 INTCON2bits;
+extern volatile hal_host_pir1 PIR1bits;
+extern volatile hal_host_pie1 PIE1bits;
+extern volatile hal_host_ipr1 IPR1bits;
+extern volatile hal_host_pir2 PIR2bits;
+extern volatile hal_host_pie2 PIE2bits;
+extern volatile hal_host_ipr2 IPR2bits;
+
+/***************************************************************************
+**   J1850 bus
+***************************************************************************/
+#define vpw_active()	hal_host_bus_drive(1)
+#define vpw_passive()	hal_host_bus_drive(0)
+#define bit_dir_outp()
+#define bit_dir_inp()
+#define is_vpw_active()	hal_host_bus_active()
+#define VPW_ACTIVE_EDGE	0	// same wiring as the board (INT0 falling edge = bus going active)
+
+extern uint32_t hal_host_bus_edges;	// edges seen on the bus line
+extern uint8_t hal_host_bus_speed;	// speed of the frames of the other nodes, J1850_SPEED_1X (0) or J1850_SPEED_4X (1)
+
+/***************************************************************************
+**   MM5450
+***************************************************************************/
+#define MMClock_dir_outp()
+#define MMClock_active()	hal_host_mm5450_clock(1)
+#define MMClock_passive()	hal_host_mm5450_clock(0)
+#define MMData_dir_outp()
+#define MMData_active()	hal_host_mm5450_data(1)
+#define MMData_passive()	hal_host_mm5450_data(0)
+
+extern uint8_t hal_host_mm5450[5];	// outputs latched by the last transfer, same layout as ledArray
+extern uint32_t hal_host_mm5450_transfers;	// transfers latched (start bit + 35 bits)
+
+/***************************************************************************
+**   Timers
+***************************************************************************/
+#define timer0_start(x)	hal_host_timer_start(0, x)
+#define timer0_16start(x)	hal_host_timer_start(0, x)
+#define timer0_get()	((uint8_t)hal_host_timer_get(0))	// TMR0L, also in 16 bit mode
+#define timer0_set(x)	hal_host_timer_set(0, x)
+#define timer0_stop()	hal_host_timer_con(0, STOP)
+
+#define timer1_start(x)	hal_host_timer_start(1, x)
+#define timer1_get()	hal_host_timer_get(1)
+#define timer1_stop()	hal_host_timer_con(1, T1STOP)
+
+#define timer3_start(x)	hal_host_timer_start(3, x)
+#define timer3_get()	hal_host_timer_get(3)
+#define timer3_set(x)	hal_host_timer_set(3, x)
+#define timer3_stop()	hal_host_timer_con(3, T3STOP)
+
+#define ccp2_compare_start()	hal_host_ccp2_start()
+#define ccp2_compare_set(x)	hal_host_ccp2_set(x)
+
+#define HAL_HOST_TIMER2_PERIOD	(31 * 16)	// cycles, OpenPWM1(30) with T2_PS_1_16 (main.c)
+
+/***************************************************************************
+**   USART
+***************************************************************************/
+#define usart_tx_write(x)	hal_host_usart_write(x);
+#define usart_rx_read()	hal_host_usart_read()
+#define usart_rx_overrun()	0
+#define usart_rx_restart()
+
+#define HAL_HOST_USART_CYCLES	434	// one byte (10 bits) at 115200 baud, OpenUSART(..., 10) of main.c
+
+extern void (*hal_host_usart_out)(uint8_t ch);	// called with each byte sent by the PIC, can be 0
+
+/***************************************************************************
+**   Board
+***************************************************************************/
+typedef struct {
+	uint8_t button;		// RA0, 0=depressed
+	uint8_t led_mode0, led_mode1, led_mode2, dig3, rpm_bar;
+	uint8_t gear_7seg;	// port B
+	unsigned brightness;	// PWM duty
+} hal_host_board;
+
+extern hal_host_board hal_host_pins;
+
+#define BUTTON		hal_host_pins.button
+#define LED_MODE0	hal_host_pins.led_mode0
+#define LED_MODE1	hal_host_pins.led_mode1
+#define LED_MODE2	hal_host_pins.led_mode2
+#define DIG3		hal_host_pins.dig3
+#define RPM_BAR		hal_host_pins.rpm_bar
+#define GEAR_7SEG	hal_host_pins.gear_7seg
+#define SetDCPWM1(x)	(hal_host_pins.brightness = (x))
+
+//Function Prototypes
+extern void hal_host_reset(void);
+extern void hal_host_advance(uint32_t cycles);
+extern void hal_host_timer_con(uint8_t n, uint8_t con);
+extern void hal_host_timer_start(uint8_t n, uint8_t con);
+extern uint16_t hal_host_timer_get(uint8_t n);
+extern void hal_host_timer_set(uint8_t n, uint16_t value);
+extern void hal_host_timer2_start(uint32_t period);
+extern void hal_host_ccp2_start(void);
+extern void hal_host_ccp2_set(uint16_t value);
+extern void hal_host_bus_drive(uint8_t active);
+extern uint8_t hal_host_bus_active(void);
+extern uint64_t hal_host_bus_frame(uint64_t start, const uint8_t *msg_buf, uint8_t nbytes);
+extern void hal_host_mm5450_clock(uint8_t level);
+extern void hal_host_mm5450_data(uint8_t level);
+extern void hal_host_usart_write(uint8_t ch);
+extern uint8_t hal_host_usart_read(void);
+extern void hal_host_usart_in(uint8_t ch);
+
+#endif // __HAL_HOST_H__
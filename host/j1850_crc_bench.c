@@ -0,0 +1,112 @@
+/*************************************************************************
+**  HARLEY DAVIDSON Sportster 883/1200 - J1850 VPW Interface
+**  Released under GNU GENERAL PUBLIC LICENSE
+**  Main MCU: MICROCHIP PIC18F2553
+**  Homepage: www.momex.cat
+**  Contact: morales.xavier@momex.cat
+**
+**
+**  Revision History
+**  11/06/2016   XM  v1.00   Initial Release on Github
+**
+**
+**  Abstract: PC benchmark of the table J1850 CRC (j1850_crc.c) against the
+**            original bit by bit version, over random frames of 1-12 bytes.
+**            Both results are compared for every frame.
+**            Compara el CRC per taula amb la versio original bit a bit.
+**
+**  Build:    gcc -O2 -I.. -o j1850_crc_bench j1850_crc_bench.c ../j1850_crc.c
+**  Usage:    j1850_crc_bench [frames]
+**************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../j1850.h"
+
+// original bit by bit j1850_crc() (Mictronics j1850.c v1.07), used as reference
+static uint8_t j1850_crc_bitwise(uint8_t *msg_buf, int8_t nbytes)
+{
+	uint8_t crc_reg=0xff,poly,byte_count,bit_count;
+	uint8_t *byte_point;
+	uint8_t bit_point;
+
+	for (byte_count=0, byte_point=msg_buf; byte_count<nbytes; ++byte_count, ++byte_point)
+	{
+		for (bit_count=0, bit_point=0x80 ; bit_count<8; ++bit_count, bit_point>>=1)
+		{
+			if (bit_point & *byte_point)	// case for new bit = 1
+			{
+				if (crc_reg & 0x80)
+					poly=1;	// define the polynomial
+				else
+					poly=0x1c;
+				crc_reg= ( (crc_reg << 1) | 1) ^ poly;
+			}
+			else		// case for new bit = 0
+			{
+				poly=0;
+				if (crc_reg & 0x80)
+					poly=0x1d;
+				crc_reg= (crc_reg << 1) ^ poly;
+			}
+		}
+	}
+	return ~crc_reg;	// Return CRC
+}
+
+static double seconds(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+	long nframes = argc > 1 ? atol(argv[1]) : 1000000;
+	long i, nbytes = 0, mismatches = 0;
+	uint8_t (*frames)[13];
+	uint8_t *len;
+	volatile uint8_t sink = 0;
+	uint8_t crc;
+	double t0, t_bit, t_tab;
+	int j;
+
+	frames = malloc(nframes * sizeof(*frames));
+	len = malloc(nframes);
+	if(!frames || !len) return 1;
+
+	srand(1850);
+	for(i = 0; i < nframes; i++)
+	{
+		len[i] = 1 + rand() % 11;	// up to 11 data bytes + CRC
+		for(j = 0; j < len[i]; j++) frames[i][j] = rand();
+		nbytes += len[i];
+	}
+
+	for(i = 0; i < nframes; i++)
+	{
+		if(j1850_crc(frames[i], len[i]) != j1850_crc_bitwise(frames[i], len[i])) ++mismatches;
+
+		// a frame with its CRC appended has to give the residue (what the receiver checks)
+		frames[i][len[i]] = j1850_crc(frames[i], len[i]);
+		crc = ~j1850_crc(frames[i], len[i] + 1);
+		if(crc != J1850_CRC_RESIDUE) ++mismatches;
+	}
+
+	t0 = seconds();
+	for(i = 0; i < nframes; i++) sink ^= j1850_crc_bitwise(frames[i], len[i]);
+	t_bit = seconds() - t0;
+
+	t0 = seconds();
+	for(i = 0; i < nframes; i++) sink ^= j1850_crc(frames[i], len[i]);
+	t_tab = seconds() - t0;
+
+	printf("%ld frames, %ld bytes, %ld mismatches\n", nframes, nbytes, mismatches);
+	printf("bitwise: %6.2f ns/byte\n", t_bit * 1e9 / nbytes);
+	printf("table:   %6.2f ns/byte (x%.1f)\n", t_tab * 1e9 / nbytes, t_bit / t_tab);
+	return mismatches != 0;
+}
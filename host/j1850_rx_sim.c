@@ -0,0 +1,241 @@
+/*************************************************************************
+**  HARLEY DAVIDSON Sportster 883/1200 - J1850 VPW Interface
+**  Released under GNU GENERAL PUBLIC LICENSE
+**  Main MCU: MICROCHIP PIC18F2553
+**  Homepage: www.momex.cat
+**  Contact: morales.xavier@momex.cat
+**
+**
+**  Revision History
+**  11/06/2016   XM  v1.00   Initial Release on Github
+**
+**
+**  Abstract: PC program to test and benchmark the edge driven receiver
+**            (j1850_rx.c) with a list of edge timestamps, one per line, in us.
+**            The first timestamp is the bus going active, then it alternates.
+**            The thresholds are fixed (J1850_CAL_LEARN) unless -c is given,
+**            then they are calibrated every J1850_CAL_MS of edge time.
+**            The edges printed with -f can be distorted like a bad front end
+**            does: -a/-p us added to every active/passive symbol and a random
+**            jitter of +-j us, the list of frames sent -n times. A frame that
+**            starts with "4x" is sent at 41.6 kbps, the receiver has to follow
+**            the speed of each frame by its SOF.
+**            With -i the ISR takes the given us per edge, like on the PIC: an
+**            edge is only measured when the ISR of the previous one has
+**            finished, and an edge that comes before the previous one has
+**            been taken is lost (overrun). -m finds the longest ISR time that
+**            still decodes every frame, to be compared with the cycles of the
+**            BENCH_RX_EDGE and BENCH_ISR_HIGH probes (bench.h): at 4x the
+**            shortest symbol is 16us, 80 instruction cycles.
+**            Programa de PC per provar el receptor amb una llista de flancs.
+**
+**  Build:    gcc -O2 -I.. -o j1850_rx_sim j1850_rx_sim.c ../j1850_rx.c ../j1850_cal.c ../j1850_crc.c
+**  Usage:    j1850_rx_sim [-c] [-i us] [-b loops] [edges.txt]     decode (or benchmark) edges
+**            j1850_rx_sim [-c] -m [edges.txt]                       longest ISR time per edge
+**            j1850_rx_sim [-a us] [-p us] [-j us] [-n times] -f "28 1B 10 02 0A F0 ..." "4x 6C F1 10 ..." ...
+**                                                                   print the edges of frames
+**  Test 4x:  (-DJ1850_HIGH_SPEED=1, host/rx_check.sh runs it and checks the result)
+**            j1850_rx_sim -j 2 -n 50 -f "28 1B 10 02 0A F0 68" "4x 6C F1 10 76 01 02 03 04 05 06 7D" > mixed.txt
+**            j1850_rx_sim mixed.txt && j1850_rx_sim -m mixed.txt
+**************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../j1850.h"
+#include "../j1850_rx.h"
+#include "../j1850_cal.h"
+
+#define CNT_PER_US	((double)(INT_CLK) / 8.0 / 1000000.0)	// us2cntT0CON8 scale
+
+static uint8_t msg_buf[12];
+static unsigned long frames, errors;
+static uint8_t cal_mode = J1850_CAL_LEARN;
+static double skew_active, skew_passive, jitter;	// distortion of the printed edges, us
+static double isr_us;		// time of the ISR per edge (-i), us
+static unsigned long overruns;	// edges lost because the ISR of the previous one was still running
+
+static void report(uint8_t rx, int print)
+{
+	uint8_t i;
+
+	if(rx == J1850_RX_PENDING) return;
+	if(rx & 0x80)
+	{
+		++errors;
+		if(print) printf("ERROR %u\n", rx & 0x7F);
+		return;
+	}
+	++frames;
+	if(!print) return;
+	for(i = 0; i < rx; i++) printf(i == rx - 1 ? "%02X\n" : "%02X ", msg_buf[i]);
+}
+
+/* feed all the edges to the receiver, like j1850_rx_isr() does on the PIC */
+static void run(const double *t, long n, int print)
+{
+	long i;
+	double cnt, taken, last = 0;	// time the ISR takes the edge (Timer0 read and reloaded)
+	uint8_t level = 0;	// bus is passive before the first edge
+	uint8_t width;
+	double cal_next = J1850_CAL_MS * 1000.0;
+
+	j1850_cal_init(cal_mode);
+	j1850_rx_init(msg_buf);
+	for(i = 0; i < n; i++)
+	{
+		if(t[i] >= cal_next)	// task of the main loop
+		{
+			j1850_cal_update();
+			cal_next += J1850_CAL_MS * 1000.0;
+		}
+		taken = t[i];
+		if(i && taken < last + isr_us) taken = last + isr_us;	// the ISR of the previous edge is still running
+		if(i + 1 < n && t[i + 1] <= taken) ++overruns;		// next edge before INTEDG0 is toggled
+		cnt = i ? (taken - last) * CNT_PER_US + 0.5 : 255;
+		last = taken;
+		if(cnt >= j1850_rx_eod) report(j1850_rx_timeout(level), print);
+		width = cnt > 255 ? 255 : (uint8_t)cnt;
+		level = !level;
+		report(j1850_rx_edge(level, width), print);
+	}
+	report(j1850_rx_timeout(level), print);
+}
+
+/* width of a symbol in us, nominal time in tx_* counts distorted with the -a, -p and -j options */
+static double symbol(uint8_t cnt, int active)
+{
+	return cnt / CNT_PER_US + (active ? skew_active : skew_passive)
+		+ jitter * (2.0 * rand() / RAND_MAX - 1.0);
+}
+
+/* print the edges of a frame sent with the nominal times of the transmitter, 1x or 4x ("4x" first) */
+static double synth(double t, const char *hex)
+{
+	const j1850_timing *tm = &j1850_timings[J1850_SPEED_1X];
+	unsigned int byte;
+	int nbits, n;
+	double us = 1.0 / CNT_PER_US;
+
+	if(strncmp(hex, "4x", 2) == 0)
+	{
+		tm = &j1850_timings[J1850_SPEED_4X];
+		hex += 2;
+	}
+	printf("%.1f\n", t);		// SOF
+	t += symbol(tm->tx_sof, 1);
+	while(sscanf(hex, "%x%n", &byte, &n) == 1)
+	{
+		hex += n;
+		for(nbits = 7; nbits >= 0; nbits--, byte <<= 1)
+		{
+			printf("%.1f\n", t);
+			if(nbits & 1)	// passive symbol
+				t += symbol((byte & 0x80) ? tm->tx_long : tm->tx_short, 0);
+			else
+				t += symbol((byte & 0x80) ? tm->tx_short : tm->tx_long, 1);
+		}
+	}
+	printf("%.1f\n", t);		// EOD/EOF
+	return t + (tm->tx_eof + tm->tx_ifs) * us;
+}
+
+/* longest ISR time per edge that decodes the same frames as an ISR without time, without overruns */
+static double isr_max(const double *t, long n)
+{
+	unsigned long good;
+	double lo = 0, hi = 64, mid;
+
+	isr_us = 0;
+	frames = errors = overruns = 0;
+	run(t, n, 0);
+	good = frames;
+	while(hi - lo > 0.1)
+	{
+		mid = (lo + hi) / 2;
+		isr_us = mid;
+		frames = errors = overruns = 0;
+		run(t, n, 0);
+		if(frames == good && !errors && !overruns) lo = mid;
+		else hi = mid;
+	}
+	isr_us = 0;
+	frames = good;
+	return lo;
+}
+
+int main(int argc, char **argv)
+{
+	long loops = 0, n = 0, size = 1024, l, times = 1;
+	double *t, tnext = 0, v, secs, max;
+	int search = 0;
+	struct timespec t0, t1;
+	char line[128];
+	FILE *f = stdin;
+	int i, j;
+
+	srand(1850);
+	for(i = 1; i < argc; i++)
+	{
+		if(!strcmp(argv[i], "-f") && i + 1 < argc)
+		{
+			for(l = 0; l < times; l++)
+			{
+				for(j = i + 1; j < argc; j++) tnext = synth(tnext, argv[j]);
+			}
+			return 0;
+		}
+		else if(!strcmp(argv[i], "-b") && i + 1 < argc) loops = atol(argv[++i]);
+		else if(!strcmp(argv[i], "-c")) cal_mode = J1850_CAL_ADAPT;
+		else if(!strcmp(argv[i], "-i") && i + 1 < argc) isr_us = atof(argv[++i]);
+		else if(!strcmp(argv[i], "-m")) search = 1;
+		else if(!strcmp(argv[i], "-a") && i + 1 < argc) skew_active = atof(argv[++i]);
+		else if(!strcmp(argv[i], "-p") && i + 1 < argc) skew_passive = atof(argv[++i]);
+		else if(!strcmp(argv[i], "-j") && i + 1 < argc) jitter = atof(argv[++i]);
+		else if(!strcmp(argv[i], "-n") && i + 1 < argc) times = atol(argv[++i]);
+		else if(!(f = fopen(argv[i], "r")))
+		{
+			perror(argv[i]);
+			return 1;
+		}
+	}
+
+	t = malloc(size * sizeof(*t));
+	while(t && fgets(line, sizeof(line), f))
+	{
+		if(sscanf(line, "%lf", &v) != 1) continue;	// empty line or comment
+		if(n == size) t = realloc(t, (size *= 2) * sizeof(*t));
+		if(t) t[n++] = v;
+	}
+	if(!t) return 1;
+
+	if(search)
+	{
+		max = isr_max(t, n);
+		printf("%lu frames decoded with an ISR of up to %.1f us (%.0f instruction cycles) per edge\n",
+			frames, max, max * (INT_CLK) / 1000000.0);
+		printf("shortest symbols: 1x %.1f us, 4x %.1f us\n", j1850_timings[J1850_SPEED_1X].tx_short / CNT_PER_US,
+			j1850_timings[J1850_SPEED_4X].tx_short / CNT_PER_US);
+		return frames ? 0 : 1;
+	}
+
+	if(!loops)
+	{
+		run(t, n, 1);
+		fprintf(stderr, "%ld edges, %lu frames, %lu errors, %lu overruns\n", n, frames, errors, overruns);
+		fprintf(stderr, "thresholds (%s): active short < %.1fus, passive long > %.1fus, SOF >= %.1fus\n",
+			cal_mode == J1850_CAL_ADAPT ? "calibrated" : "fixed", j1850_cal_lim.short_max / CNT_PER_US,
+			j1850_cal_lim.long_min / CNT_PER_US, j1850_cal_lim.sof_min / CNT_PER_US);
+		return 0;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for(l = 0; l < loops; l++) run(t, n, 0);
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+	printf("%ld edges x %ld loops: %.1f ns/edge, %.0f frames/s (%lu frames, %lu errors)\n",
+		n, loops, secs * 1e9 / ((double)n * loops), frames / secs, frames, errors);
+	return 0;
+}
@@ -0,0 +1,47 @@
+#!/bin/sh
+#*************************************************************************
+#  HARLEY DAVIDSON Sportster 883/1200 - J1850 VPW Interface
+#  Released under GNU GENERAL PUBLIC LICENSE
+#  Main MCU: MICROCHIP PIC18F2553
+#  Homepage: www.momex.cat
+#  Contact: morales.xavier@momex.cat
+#
+#
+#  Revision History
+#  11/06/2016   XM  v1.00   Initial Release on Github
+#
+#
+#  Abstract: Check of the receiver with mixed 1x and 4x frames, the test 4x
+#            of j1850_rx_sim.c. j1850_rx_sim is built with
+#            -DJ1850_HIGH_SPEED=1 whatever the default of j1850.h is, 50
+#            times a 1x and a 4x frame are sent with +-2us of jitter and
+#            the check fails (exit code 1) unless all the 100 frames are
+#            decoded without errors or overruns. The longest ISR time per
+#            edge that still decodes them is printed, the limit for the
+#            rx_edge and isr_high results of host/bench.sh.
+#            Prova del receptor amb trames 1x i 4x barrejades.
+#
+#  Needs:    gcc
+#  Usage:    host/rx_check.sh
+#*************************************************************************
+
+set -e
+
+HOST=$(cd "$(dirname "$0")" && pwd)
+SRC=$(dirname "$HOST")
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+gcc -O2 -DJ1850_HIGH_SPEED=1 -o "$TMP/j1850_rx_sim" "$HOST/j1850_rx_sim.c" "$SRC/j1850_rx.c" "$SRC/j1850_cal.c" "$SRC/j1850_crc.c"
+"$TMP/j1850_rx_sim" -j 2 -n 50 -f "28 1B 10 02 0A F0 68" "4x 6C F1 10 76 01 02 03 04 05 06 7D" > "$TMP/mixed.txt"
+"$TMP/j1850_rx_sim" "$TMP/mixed.txt" > /dev/null 2> "$TMP/result.txt"
+head -1 "$TMP/result.txt"
+"$TMP/j1850_rx_sim" -m "$TMP/mixed.txt" | head -1
+
+# "<n> edges, <frames> frames, <errors> errors, <overruns> overruns"
+if ! head -1 "$TMP/result.txt" | grep -q " 100 frames, 0 errors, 0 overruns$"
+then
+	echo "rx_check.sh: FAILED, the 1x and 4x frames are not all decoded" >&2
+	exit 1
+fi
+echo "rx_check.sh: passed" >&2
@@ -0,0 +1,174 @@
+/*************************************************************************
+**  HARLEY DAVIDSON Sportster 883/1200 - J1850 VPW Interface
+**  Released under GNU GENERAL PUBLIC LICENSE
+**  Main MCU: MICROCHIP PIC18F2553
+**  Homepage: www.momex.cat
+**  Contact: morales.xavier@momex.cat
+**
+**
+**  Revision History
+**  11/06/2016   XM  v1.00   Initial Release on Github
+**
+**
+**   NOTE: See tacho_host.h
+**************************************************************************/
+
+#include <stdio.h>
+
+#include "../hal.h"
+#include "../j1850.h"
+#include "../j1850_ring.h"
+#include "../j1850_cal.h"
+#include "../MM5450.h"
+#include "../usart_tx.h"
+#include "../usart_rx.h"
+#include "../stats.h"
+#include "../sched.h"
+#include "../button.h"
+#include "../tacho.h"
+#include "tacho_host.h"
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: InterruptHandlerLow of main.c without the time measure
+** Parameters: none
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+void tacho_host_isr_low(void)
+{
+	usart_tx_isr();
+	usart_rx_isr();
+	MM5450_isr();
+	if(sched_tick_isr()) button_tick();
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Reset the simulated hardware and leave it as main() does before its loop (brightness
+**           set, interrupts enabled, MM5450, USART and tick as low priority ISR, Timer1 and the tick
+**           running, tacho_init() done, so the self-test has just started). The receiver is not
+**           started, the caller starts it or writes the frames on the ring itself
+** Parameters: none
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+void tacho_host_start(void)
+{
+	hal_host_reset();
+	MM5450_init();
+	j1850_init();
+	j1850_ring_init();
+	usart_tx_init();
+	usart_rx_init();
+	stats_init();
+	j1850_cal_init(J1850_CAL_ADAPT);
+	hal_host_timer2_start(HAL_HOST_TIMER2_PERIOD);
+	SetDCPWM1(BRIGHTNESS_HIGH);
+	hal_host_irq_low = tacho_host_isr_low;
+	INTCONbits.GIEH = 1;
+	INTCONbits.GIEL = 1;
+	RPM_BAR = 1;
+	DIG3 = 0;
+	timer1_start(T1CK8);
+	button_init();
+	sched_init();
+	tacho_init();
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Run the main loop until the self-test is finished, with the switch pressed for the first
+**           100ms (the tacho remains OFF until the switch). For the programs that do not drive it
+** Parameters: none
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+void tacho_host_boot(void)
+{
+	uint64_t release = hal_host_clock + 100 * TACHO_HOST_CYCLES_MS;
+
+	hal_host_pins.button = 0;
+	while(tacho_status() & TACHO_STATUS_BOOT)
+	{
+		if(hal_host_clock >= release) hal_host_pins.button = 1;
+		tacho_loop();
+		hal_host_advance(TACHO_HOST_LOOP_CYCLES);
+	}
+	hal_host_pins.button = 1;
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Character shown by one digit of the MM5450, without its decimal point
+** Parameters: byte of the MM5450 outputs (hal_host_mm5450)
+** Returns: character, ' ' if off, '?' if it is not a digit or '-'
+**---------------------------------------------------------------------------
+*/
+char tacho_host_digit(uint8_t mm5450_byte)
+{
+	// digits of display4x7seg (tacho.c), as sent to the MM5450 (MM5450_GLYPH)
+	static const uint8_t glyph[10] = {0x3F, 0x06, 0x5B, 0x4F, 0x66, 0x6D, 0x7D, 0x07, 0x7F, 0x6F};
+	uint8_t i;
+
+	mm5450_byte &= 0x7F;	// decimal point
+	if(mm5450_byte == 0) return ' ';
+	if(mm5450_byte == 0x40) return '-';
+	for(i = 0; i < 10; i++) if(glyph[i] == mm5450_byte) return '0' + i;
+	return '?';
+}
+
+static char gear_char(uint8_t port)
+{
+	uint8_t i;
+
+	if(port == (uint8_t)display7seg[10]) return ' ';
+	if(port == (uint8_t)display7seg[17]) return '-';
+	for(i = 0; i < 10; i++) if(port == (uint8_t)display7seg[i]) return '0' + i;
+	return '?';
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Text with everything the display shows: 4 digits ('|' when digit 3 is replaced by the
+**           RPM bar, '.' after digit 1 when its decimal point is ON), gear, mode LEDs, RPM bar, raw MM5450 outputs and brightness
+** Parameters: buffer of TACHO_HOST_DISPLAY_LEN characters
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+void tacho_host_display(char *text)
+{
+	snprintf(text, TACHO_HOST_DISPLAY_LEN, "[%c%c%c%s%c] gear %c  leds %d%d%d  bar %d  mm5450 %02X%02X%02X%02X%02X  bright %u",
+		hal_host_pins.dig3 ? '|' : tacho_host_digit(hal_host_mm5450[3]),
+		tacho_host_digit(hal_host_mm5450[2]), tacho_host_digit(hal_host_mm5450[1]),
+		(hal_host_mm5450[1] & 0x80) ? "." : "", tacho_host_digit(hal_host_mm5450[0]),
+		gear_char(hal_host_pins.gear_7seg),
+		hal_host_pins.led_mode0, hal_host_pins.led_mode1, hal_host_pins.led_mode2,
+		!hal_host_pins.rpm_bar,
+		hal_host_mm5450[0], hal_host_mm5450[1], hal_host_mm5450[2], hal_host_mm5450[3], hal_host_mm5450[4],
+		hal_host_pins.brightness);
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Print the statistics of the tasks of tacho.c (runs, late runs, execution time). The
+**           times are Timer1 counts of the simulated PIC, they only include the cycles the host
+**           build spends (timer and pin reads, ISRs), not the code itself
+** Parameters: none
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+void tacho_host_tasks(void)
+{
+	static const char *name[TACHO_TASKS] = {"refresh", "blink", "button", "stale", "boot", "cal", "stats", "bench", "diag", "block"};
+	sched_task *task;
+	uint8_t i;
+
+	for(i = 0; i < TACHO_TASKS; i++)
+	{
+		task = &tacho_tasks[i];
+		printf("task %-8s every %4u ms: runs %lu, late %u, time avg %.1f us, max %.1f us\n", name[i],
+			task->period, (unsigned long)task->runs, task->late,
+			task->runs ? task->time_sum * 1.6 / task->runs : 0.0, task->time_max * 1.6);
+	}
+}
@@ -0,0 +1,35 @@
+/*************************************************************************
+**  HARLEY DAVIDSON Sportster 883/1200 - J1850 VPW Interface
+**  Released under GNU GENERAL PUBLIC LICENSE
+**  Main MCU: MICROCHIP PIC18F2553
+**  Homepage: www.momex.cat
+**  Contact: morales.xavier@momex.cat
+**
+**
+**  Revision History
+**  11/06/2016   XM  v1.00   Initial Release on Github
+**
+**
+**   NOTE: Common part of the PC programs that run tacho.c on the simulated
+**         hardware (tacho_sim, tacho_replay): start as main() does, and
+**         read back what the display shows.
+**************************************************************************/
+
+#ifndef __TACHO_HOST_H__
+#define __TACHO_HOST_H__
+
+#include "../hal.h"
+
+#define TACHO_HOST_LOOP_CYCLES	150	// estimated cycles of one pass of the PIC main loop besides the timer reads
+#define TACHO_HOST_CYCLES_MS	(HAL_HOST_CYCLES_US * 1000L)
+#define TACHO_HOST_DISPLAY_LEN	96	// size of the text written by tacho_host_display()
+
+//Function Prototypes
+extern void tacho_host_isr_low(void);
+extern void tacho_host_start(void);
+extern void tacho_host_boot(void);
+extern void tacho_host_display(char *text);
+extern char tacho_host_digit(uint8_t mm5450_byte);
+extern void tacho_host_tasks(void);
+
+#endif // __TACHO_HOST_H__
@@ -0,0 +1,190 @@
+/*************************************************************************
+**  HARLEY DAVIDSON Sportster 883/1200 - J1850 VPW Interface
+**  Released under GNU GENERAL PUBLIC LICENSE
+**  Main MCU: MICROCHIP PIC18F2553
+**  Homepage: www.momex.cat
+**  Contact: morales.xavier@momex.cat
+**
+**
+**  Revision History
+**  11/06/2016   XM  v1.00   Initial Release on Github
+**
+**
+**  Abstract: Replay of captured USART logs through the decode and display of
+**            tacho.c, much faster than real time. Each frame is written on
+**            the ring as InterruptHandlerHigh does (the bit level receiver is
+**            skipped) and the main loop of tacho.c runs once per frame.
+**            The logs are read as a stream, they can be hours long or a pipe.
+**            Time: the hex logs have no timestamps, each frame takes its
+**            nominal VPW length plus the IFS (plus -g us). The binary logs
+**            (-b) use the Timer1 timestamps of the records.
+**            Reprodueix registres de la USART a traves de tacho.c.
+**
+**  Build:    gcc -O2 -I.. -o tacho_replay tacho_replay.c tacho_host.c hal_host.c usart_log.c
+**                ../tacho.c ../j1850.c ../j1850_rx.c ../j1850_tx.c ../j1850_cal.c ../j1850_crc.c ../j1850_ring.c ../MM5450.c
+**                ../bcd.c ../sched.c ../button.c ../usart_tx.c ../usart_rx.c ../stats.c ../bench.c ../filter.c ../fuel.c ../diag.c ../block.c
+**  Usage:    tacho_replay [-b] [-q] [-g us] [log ...]
+**              -b     binary SLIP log (default: hex bytes + CR)
+**              -q     do not print the display changes, only the summary
+**              -g us  extra gap between frames of a hex log
+**************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../hal.h"
+#include "../j1850.h"
+#include "../j1850_ring.h"
+#include "../MM5450.h"
+#include "../tacho.h"
+#include "tacho_host.h"
+#include "usart_log.h"
+
+// nominal VPW symbols, in us
+#define VPW_SHORT_US	64
+#define VPW_LONG_US	128
+#define VPW_SOF_US	200
+#define VPW_IFS_US	300
+
+static int print = 1;
+static unsigned long frames, changes;
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Time a frame takes on the bus, from SOF to the end of the IFS
+** Parameters: frame bytes, number of bytes
+** Returns: us
+**---------------------------------------------------------------------------
+*/
+static uint32_t frame_us(const uint8_t *msg_buf, uint8_t nbytes)
+{
+	uint32_t us = VPW_SOF_US + VPW_IFS_US;
+	uint8_t level = 0, i, j, bit;
+
+	for(i = 0; i < nbytes; i++)
+	{
+		for(j = 0; j < 8; j++)
+		{
+			bit = (msg_buf[i] >> (7 - j)) & 1;
+			us += (bit ^ level) ? VPW_LONG_US : VPW_SHORT_US;	// passive: 1=long, active: 1=short
+			level ^= 1;
+		}
+	}
+	return us;
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: One frame through the ring and one pass of the main loop of tacho.c
+** Parameters: frame bytes, number of bytes, clock cycle at the end of the frame
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+static void replay_frame(const uint8_t *msg_buf, uint8_t nbytes, uint64_t end)
+{
+	static char last[TACHO_HOST_DISPLAY_LEN];
+	char text[TACHO_HOST_DISPLAY_LEN];
+
+	while(hal_host_clock < end)
+	{
+		hal_host_advance(end - hal_host_clock > 0x40000000 ? 0x40000000 : (uint32_t)(end - hal_host_clock));
+	}
+	memcpy(j1850_ring_wr()->data, msg_buf, nbytes);
+	j1850_ring_commit(nbytes, J1850_RETURN_CODE_OK, timer1_get());
+	tacho_loop();
+	++frames;
+
+	tacho_host_display(text);
+	if(strcmp(text, last) == 0) return;
+	strcpy(last, text);
+	++changes;
+	if(print) printf("%12.3f ms  %s\n", (double)hal_host_clock / TACHO_HOST_CYCLES_MS, text);
+}
+
+static double seconds(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+	static uint8_t block[65536];
+	usart_log_decoder d;
+	usart_log_record rec;
+	FILE *in;
+	size_t n, k;
+	int binary = 0, i;
+	uint32_t gap_us = 0;
+	uint64_t base = 0, end;
+	unsigned long bad_status = 0;
+	double wall, sim_s;
+
+	for(i = 1; i < argc && argv[i][0] == '-' && argv[i][1]; i++)
+	{
+		if(strcmp(argv[i], "-b") == 0) binary = 1;
+		else if(strcmp(argv[i], "-q") == 0) print = 0;
+		else if(strcmp(argv[i], "-g") == 0 && i + 1 < argc) gap_us = atol(argv[++i]);
+		else
+		{
+			fprintf(stderr, "usage: tacho_replay [-b] [-q] [-g us] [log ...]\n");
+			return 1;
+		}
+	}
+
+	tacho_host_start();
+	tacho_host_boot();	// self-test and switch, the log starts with the tacho ON
+	usart_log_init(&d);
+	wall = seconds();
+
+	do
+	{
+		if(i >= argc || strcmp(argv[i], "-") == 0) in = stdin;
+		else if(!(in = fopen(argv[i], "rb")))
+		{
+			perror(argv[i]);
+			return 1;
+		}
+		base = hal_host_clock;	// binary logs: timestamps are relative to the first record of each file
+		d.have_time = 0;
+		d.time = 0;
+
+		while((n = fread(block, 1, sizeof(block), in)) > 0)
+		{
+			for(k = 0; k < n; k++)
+			{
+				if(binary)
+				{
+					if(!usart_log_feed(&d, block[k], &rec) || rec.type != USART_LOG_FRAME) continue;
+					if(rec.status != J1850_RETURN_CODE_OK)
+					{
+						++bad_status;
+						continue;
+					}
+					end = base + rec.time * 8;	// T1CK8
+				}
+				else
+				{
+					if(!usart_log_hex_feed(&d, block[k], &rec)) continue;
+					end = hal_host_clock + (uint64_t)(frame_us(rec.data, rec.len) + gap_us) * HAL_HOST_CYCLES_US;
+				}
+				replay_frame(rec.data, rec.len, end);
+			}
+		}
+		if(in != stdin) fclose(in);
+	} while(++i < argc);
+
+	wall = seconds() - wall;
+	sim_s = (double)hal_host_clock / (TACHO_HOST_CYCLES_MS * 1000.0);
+	if(wall <= 0) wall = 1e-9;
+	printf("frames %lu, bad lines/records %lu, bad CRC records %lu, display changes %lu\n",
+		frames, d.bad, bad_status, changes);
+	printf("display refreshes sent %u, skipped %u (same image)\n", MM5450_transfers, MM5450_skipped);
+	tacho_host_tasks();
+	printf("bus time %.3f s replayed in %.3f s (x%.0f), %.0f frames/s\n", sim_s, wall, sim_s / wall, frames / wall);
+	return 0;
+}
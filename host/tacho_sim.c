@@ -0,0 +1,458 @@
+/*************************************************************************
+**  HARLEY DAVIDSON Sportster 883/1200 - J1850 VPW Interface
+**  Released under GNU GENERAL PUBLIC LICENSE
+**  Main MCU: MICROCHIP PIC18F2553
+**  Homepage: www.momex.cat
+**  Contact: morales.xavier@momex.cat
+**
+**
+**  Revision History
+**  11/06/2016   XM  v1.00   Initial Release on Github
+**
+**
+**  Abstract: PC simulation of the tacho. The firmware modules (receiver,
+**            ring, MM5450 driver and the main loop of tacho.c) are compiled
+**            unchanged against the simulated hardware of hal_host.c, and
+**            driven by a script of timed inputs. Each time the display
+**            changes a line is printed. The summary has the time from power
+**            on to the first rpm decoded and to the first rpm shown (the
+**            self-test has to end and the switch has to be pressed first).
+**            The records sent by the PIC on the USART that are not frames
+**            (statistics, calibration, block transfers) are printed too, the
+**            data of the block transfers is checked against what the ECM sent.
+**            Simulacio del tacometre al PC amb un guio d'entrades.
+**
+**  Build:    gcc -O2 -I.. -o tacho_sim tacho_sim.c usart_log.c tacho_host.c hal_host.c ../tacho.c ../j1850.c
+**                ../j1850_rx.c ../j1850_tx.c ../j1850_cal.c ../j1850_crc.c ../j1850_ring.c ../MM5450.c ../bcd.c ../sched.c
+**                ../button.c ../usart_tx.c ../usart_rx.c ../stats.c ../bench.c ../filter.c ../fuel.c ../diag.c ../block.c
+**  Usage:    tacho_sim [-q] [script.txt]     (-q: only the summary)
+**
+**  Script:   one input per line, time in ms since power on (main() starts
+**            the receiver at once, the self-test of the display takes 1.7s)
+**              100 frame 28 1B 10 02 0A F0   other node sends a frame, CRC added
+**              150 raw 28 1B 10 02 0A F0 00  frame sent as it is (bad CRC...)
+**              180 send 68 6A F1 01 00       frame queued on our transmitter
+**                                            (j1850_tx_queue), CRC added. Its
+**                                            result is printed when it is known.
+**                                            Needs J1850_TX 1 (j1850_tx.h)
+**              190 ecm 04 80                 the ECM answers the requests of PID
+**                                            04 (68 6A F1 01 04) with the data 80,
+**                                            right after their EOF. Without data
+**                                            it stops answering that PID. The
+**                                            requests need DIAG 1 (diag.h)
+**              190 block 7C 200 lose 5       the ECM sends a block transfer of mode
+**                                            7C with 200 data bytes, as fast as the
+**                                            bus allows. Optionally the frame with
+**                                            that sequence number is not sent
+**              190 speed 4x                  the next frames of the other nodes are
+**                                            sent at 41.6 kbps (4x) or 10.4 kbps (1x).
+**                                            4x frames need J1850_HIGH_SPEED 1 (j1850.h)
+**              200 button down               rear switch (down/up), a press and
+**                                            release during the self-test switches
+**                                            the tacho ON
+**              300 usart S                   bytes sent by the PC (STATS_CMD_xxx)
+**              900 end                       end of the simulation
+**            '#' starts a comment. Times have to be in order.
+**************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../hal.h"
+#include "../j1850.h"
+#include "../j1850_rx.h"
+#include "../j1850_tx.h"
+#include "../j1850_ring.h"
+#include "../diag.h"
+#include "../block.h"
+#include "../sched.h"
+#include "../MM5450.h"
+#include "../tacho.h"
+#include "tacho_host.h"
+#include "usart_log.h"
+
+static unsigned long frames_sent, frames_ok, frames_bad;
+static unsigned long tx_queued;
+static uint8_t tx_tickets[J1850_TX_SLOTS];	// frames of our transmitter not finished yet, 0=free
+static uint64_t t_boot, t_rpm, t_rpm_shown;	// cycles from power on to the end of the self-test, first rpm decoded and shown
+static uint32_t rpm_transfers;		// MM5450 transfers when the rpm was ready to be shown
+static usart_log_decoder usart_log;	// records sent by the PIC
+
+static uint8_t ecm_len[256];		// data bytes of the answer of each PID, 0=no answer
+static uint8_t ecm_data[256][4];
+static unsigned long ecm_answers;
+
+#define ECM_BLOCK_BYTE(pos)	((uint8_t)((pos) ^ ((pos) >> 8)))	// data of the simulated block transfers
+static uint8_t ecm_block_mode;		// block transfer being sent, 0 if none
+static uint8_t ecm_block_seq;		// sequence number of the next frame
+static uint8_t ecm_block_lose;		// frame not sent, 0 if none
+static uint16_t ecm_block_len;		// data bytes of the transfer
+static uint16_t ecm_block_pos;		// next data byte
+static unsigned long block_records, block_wrong;	// USART_LOG_BLOCK records, their data bytes not as sent
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Simulated ECM, a received diagnostic request of a PID with an answer is answered. The
+**           answer starts at once, before the IFS of our next request ends: the other nodes of the
+**           simulation do not arbitrate, the ECM would win anyway (DIAG_RSP_PRIO < DIAG_REQ_PRIO)
+** Parameters: frame buffer, frame length
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+static void ecm_request(const uint8_t *msg, uint8_t nbytes)
+{
+	uint8_t answer[12], n;
+
+	if(nbytes != 6 || msg[0] != DIAG_REQ_PRIO || msg[1] != DIAG_REQ_TARGET || msg[3] != DIAG_MODE) return;
+	if(!(n = ecm_len[msg[4]])) return;
+	answer[0] = DIAG_RSP_PRIO;
+	answer[1] = DIAG_RSP_TARGET;
+	answer[2] = DIAG_ECU;
+	answer[3] = DIAG_MODE_ANSWER;
+	answer[4] = msg[4];
+	memcpy(answer + 5, ecm_data[msg[4]], n);
+	answer[5 + n] = j1850_crc(answer, 5 + n);
+	if(hal_host_bus_frame(hal_host_clock, answer, 6 + n)) ++ecm_answers;
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Simulated ECM, next frame of its block transfer (block.h) if there is room for it on the
+**           edge queue of the bus, they go one after the other separated by the IFS
+** Parameters: none
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+static void ecm_block(void)
+{
+	uint8_t frame[12], n;
+	uint16_t pos = ecm_block_pos;
+
+	if(!ecm_block_mode) return;
+	frame[0] = BLOCK_PRIO;
+	frame[1] = DIAG_TESTER;
+	frame[2] = DIAG_ECU;
+	frame[3] = ecm_block_mode;
+	frame[BLOCK_SEQ] = ecm_block_seq;
+	n = BLOCK_DATA;
+	if(ecm_block_seq == 0)
+	{
+		frame[n++] = ecm_block_len >> 8;
+		frame[n++] = (uint8_t)ecm_block_len;
+	}
+	while(n < 11 && pos < ecm_block_len)
+	{
+		frame[n++] = ECM_BLOCK_BYTE(pos);
+		pos++;
+	}
+	frame[n] = j1850_crc(frame, n);
+	if((ecm_block_lose && ecm_block_seq == ecm_block_lose) || hal_host_bus_frame(hal_host_clock, frame, n + 1))
+	{
+		ecm_block_pos = pos;
+		if(++ecm_block_seq == 0) ecm_block_seq = 1;
+		if(pos == ecm_block_len) ecm_block_mode = 0;
+	}
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: InterruptHandlerHigh of main.c without the USART log
+** Parameters: none
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+static void sim_isr(void)
+{
+	uint8_t recv_nbytes;
+	uint16_t timestamp;
+
+	if(j1850_tx_isr()) return;
+	if(INTCONbits.INT0IF || (INTCONbits.TMR0IE && INTCONbits.TMR0IF)) recv_nbytes = j1850_rx_isr();
+	else recv_nbytes = J1850_RX_PENDING;	// only Timer1 overflow
+	SCHED_WRAP_ISR()
+	if(recv_nbytes == J1850_RX_PENDING) return;
+	timestamp = (uint16_t)sched_timestamp();
+	if(recv_nbytes & 0x80)
+	{
+		if(recv_nbytes == (J1850_RETURN_CODE_DATA_ERROR | 0x80)) ++frames_bad;
+		return;
+	}
+	++frames_ok;
+	ecm_request(j1850_ring_wr()->data, recv_nbytes);
+	j1850_ring_commit(recv_nbytes, J1850_RETURN_CODE_OK, timestamp);
+	j1850_rx_buffer(j1850_ring_wr()->data);
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Byte sent by the PIC on the USART, the records that are not frames are printed
+** Parameters: byte
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+static void sim_usart_out(uint8_t ch)
+{
+	usart_log_record rec;
+
+	uint16_t pos;
+	int i;
+
+	if(!usart_log_feed(&usart_log, ch, &rec) || rec.type == USART_LOG_FRAME) return;
+	if(rec.type == USART_LOG_BLOCK && rec.size >= BLOCK_RECORD_HEADER)
+	{
+		++block_records;
+		pos = rec.payload[4] | (rec.payload[5] << 8);
+		for(i = BLOCK_RECORD_HEADER; i < rec.size; i++, pos++)
+		{
+			if(rec.payload[i] != ECM_BLOCK_BYTE(pos)) ++block_wrong;
+		}
+	}
+	printf("%10.3f ms\n", (double)hal_host_clock / TACHO_HOST_CYCLES_MS);
+	usart_log_print(&rec);
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Print the display if it has changed since the last call, and take the times of the
+**           summary
+** Parameters: print enabled
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+static void show(int print)
+{
+	static char last[TACHO_HOST_DISPLAY_LEN];
+	char text[TACHO_HOST_DISPLAY_LEN];
+
+	if(!t_boot && !(tacho_status() & TACHO_STATUS_BOOT)) t_boot = hal_host_clock;
+	if(!t_rpm && (tacho_status() & TACHO_STATUS_RPM)) t_rpm = hal_host_clock;
+	if(!t_rpm_shown && t_boot && t_rpm)
+	{
+		if(!rpm_transfers) rpm_transfers = hal_host_mm5450_transfers;
+		else if(hal_host_mm5450_transfers != rpm_transfers) t_rpm_shown = hal_host_clock;
+	}
+
+	tacho_host_display(text);
+	if(strcmp(text, last) == 0) return;
+	strcpy(last, text);
+	if(print) printf("%10.3f ms  %s\n", (double)hal_host_clock / TACHO_HOST_CYCLES_MS, text);
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Print the result of the frames of our transmitter that have been finished
+** Parameters: print enabled
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+static void tx_results(int print)
+{
+	uint8_t i, status;
+
+	for(i = 0; i < J1850_TX_SLOTS; i++)
+	{
+		if(!tx_tickets[i]) continue;
+		status = j1850_tx_status(tx_tickets[i]);
+		if(status == J1850_TX_PENDING) continue;
+		if(print && status == J1850_RETURN_CODE_OK)
+		{
+			printf("%10.3f ms  send %u: sent at %s, latency %.1f us\n", (double)hal_host_clock / TACHO_HOST_CYCLES_MS,
+				tx_tickets[i], j1850_speed == J1850_SPEED_4X ? "4x" : "1x",
+				j1850_tx_latency(tx_tickets[i]) * USART_LOG_US_PER_COUNT);
+		}
+		else if(print)
+		{
+			printf("%10.3f ms  send %u: given up, arbitration lost %u times\n", (double)hal_host_clock / TACHO_HOST_CYCLES_MS,
+				tx_tickets[i], J1850_TX_RETRIES + 1);
+		}
+		tx_tickets[i] = 0;
+	}
+}
+
+static int parse_hex(char *s, uint8_t *buf, int max)
+{
+	int n = 0;
+	char *end;
+
+	while(n < max)
+	{
+		unsigned long v = strtoul(s, &end, 16);
+		if(end == s) break;
+		buf[n++] = (uint8_t)v;
+		s = end;
+	}
+	return n;
+}
+
+static double seconds(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+	FILE *in = stdin;
+	char line[256], cmd[16], *p;
+	double ms, wall;
+	uint64_t until, t0;
+	uint8_t msg[13];
+	int n, i, pos, print = 1, lineno = 0;
+
+	if(argc > 1 && strcmp(argv[1], "-q") == 0)
+	{
+		print = 0;
+		argc--;
+		argv++;
+	}
+	if(argc > 1 && !(in = fopen(argv[1], "r")))
+	{
+		perror(argv[1]);
+		return 1;
+	}
+
+	tacho_host_start();	// as main() after the boot test of the LEDs
+	hal_host_irq = sim_isr;
+	usart_log_init(&usart_log);
+	hal_host_usart_out = sim_usart_out;
+	j1850_rx_start(j1850_ring_wr()->data);
+	j1850_tx_init();
+	t0 = hal_host_clock;
+	wall = seconds();
+
+	while(fgets(line, sizeof(line), in))
+	{
+		++lineno;
+		if((p = strchr(line, '#'))) *p = 0;
+		if(sscanf(line, "%lf %15s %n", &ms, cmd, &pos) < 2) continue;
+
+		until = t0 + (uint64_t)(ms * TACHO_HOST_CYCLES_MS);
+		while(hal_host_clock < until)	// main loop until the time of the input
+		{
+			tacho_loop();
+			hal_host_advance(TACHO_HOST_LOOP_CYCLES);
+			show(print);
+			tx_results(print);
+			ecm_block();
+		}
+
+		if(strcmp(cmd, "frame") == 0 || strcmp(cmd, "raw") == 0)
+		{
+			n = parse_hex(line + pos, msg, 12);
+			if(cmd[0] == 'f' && n < 12)
+			{
+				msg[n] = j1850_crc(msg, n);
+				n++;
+			}
+			if(n == 0 || hal_host_bus_frame(hal_host_clock, msg, n) == 0)
+			{
+				fprintf(stderr, "line %d: frame not sent\n", lineno);
+				continue;
+			}
+			++frames_sent;
+		}
+		else if(strcmp(cmd, "send") == 0)
+		{
+			n = parse_hex(line + pos, msg, 11);
+			if(n == 0)
+			{
+				fprintf(stderr, "line %d: frame not queued\n", lineno);
+				continue;
+			}
+			msg[n] = j1850_crc(msg, n);
+			for(i = 0; i < J1850_TX_SLOTS && tx_tickets[i]; i++);
+			if(i == J1850_TX_SLOTS || !(tx_tickets[i] = j1850_tx_queue(msg, n + 1)))
+			{
+				fprintf(stderr, J1850_TX ? "line %d: transmitter queue full\n" : "line %d: no transmitter (J1850_TX 0)\n", lineno);
+				continue;
+			}
+			++tx_queued;
+		}
+		else if(strcmp(cmd, "ecm") == 0)
+		{
+			n = parse_hex(line + pos, msg, 5);
+			if(n == 0)
+			{
+				fprintf(stderr, "line %d: PID missing\n", lineno);
+				continue;
+			}
+			ecm_len[msg[0]] = n - 1;
+			memcpy(ecm_data[msg[0]], msg + 1, n - 1);
+		}
+		else if(strcmp(cmd, "block") == 0)
+		{
+			unsigned int mode, len, lose = 0;
+
+			if(sscanf(line + pos, "%x %u lose %u", &mode, &len, &lose) < 2 || !mode || len > 0xFFFF)
+			{
+				fprintf(stderr, "line %d: block <mode> <length> [lose <seq>]\n", lineno);
+				continue;
+			}
+			ecm_block_mode = mode;
+			ecm_block_len = len;
+			ecm_block_lose = lose;
+			ecm_block_seq = 0;
+			ecm_block_pos = 0;
+		}
+		else if(strcmp(cmd, "speed") == 0)
+		{
+			hal_host_bus_speed = strncmp(line + pos, "4x", 2) == 0 ? J1850_SPEED_4X : J1850_SPEED_1X;
+			if(!J1850_HIGH_SPEED && hal_host_bus_speed == J1850_SPEED_4X)
+				fprintf(stderr, "line %d: the receiver only takes 1x frames (J1850_HIGH_SPEED 0)\n", lineno);
+		}
+		else if(strcmp(cmd, "button") == 0)
+		{
+			hal_host_pins.button = strncmp(line + pos, "down", 4) != 0;
+		}
+		else if(strcmp(cmd, "usart") == 0)
+		{
+			for(p = line + pos; *p; p++)	// one byte each USART byte time, as the PC would send them
+			{
+				if(*p == ' ' || *p == '\n' || *p == '\r') continue;
+				hal_host_usart_in(*p);
+				hal_host_advance(HAL_HOST_USART_CYCLES);
+			}
+		}
+		else if(strcmp(cmd, "end") == 0)
+		{
+			break;
+		}
+		else
+		{
+			fprintf(stderr, "line %d: unknown input '%s'\n", lineno, cmd);
+		}
+	}
+	wall = seconds() - wall;
+
+	printf("simulated %.3f s in %.3f s (x%.0f)\n", (double)(hal_host_clock - t0) / (TACHO_HOST_CYCLES_MS * 1000.0), wall,
+		(double)(hal_host_clock - t0) / (TACHO_HOST_CYCLES_MS * 1000.0) / (wall > 0 ? wall : 1e-9));
+	printf("frames sent %lu, received %lu, CRC errors %u, ring overflows %u, bus edges %u\n",
+		frames_sent, frames_ok, j1850_rx_crc_errors, j1850_ring_overflows, hal_host_bus_edges);
+	if(tx_queued)
+	{
+		printf("our frames queued %lu, sent %u, arbitration lost %u, given up %u, latency avg %.1f max %.1f us\n",
+			tx_queued, j1850_tx_sent, j1850_tx_lost, j1850_tx_failed, j1850_tx_latency_avg() * USART_LOG_US_PER_COUNT,
+			j1850_tx_latency_max * USART_LOG_US_PER_COUNT);
+	}
+	if(diag_requests || ecm_answers)
+	{
+		printf("diagnostic requests %u, answers %u (ECM sent %lu), timeouts %u, not sent %u, bus load %u%%, periods x%u\n",
+			diag_requests, diag_answers, ecm_answers, diag_timeouts, diag_tx_errors, diag_load, 1u << diag_slow);
+	}
+	if(block_records)
+	{
+		printf("block transfers done %u, given up %u, not started %u, records %lu, data bytes %u, wrong %lu\n",
+			block_done, block_errors, block_dropped, block_records, block_bytes, block_wrong);
+	}
+	printf("display refreshes sent %u, skipped %u (same image), MM5450 transfers latched %u\n",
+		MM5450_transfers, MM5450_skipped, hal_host_mm5450_transfers);
+	printf("power on to: self-test end %.1f ms, first rpm decoded %.1f ms, first rpm shown %.1f ms\n",
+		(double)t_boot / TACHO_HOST_CYCLES_MS, (double)t_rpm / TACHO_HOST_CYCLES_MS,
+		(double)t_rpm_shown / TACHO_HOST_CYCLES_MS);
+	tacho_host_tasks();
+	return 0;
+}
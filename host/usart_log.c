@@ -0,0 +1,247 @@
+/*************************************************************************
+**  HARLEY DAVIDSON Sportster 883/1200 - J1850 VPW Interface
+**  Released under GNU GENERAL PUBLIC LICENSE
+**  Main MCU: MICROCHIP PIC18F2553
+**  Homepage: www.momex.cat
+**  Contact: morales.xavier@momex.cat
+**
+**
+**  Revision History
+**  11/06/2016   XM  v1.00   Initial Release on Github
+**
+**
+**   NOTE: The timestamp is the Timer1 of the PIC with its overflows, 32
+**         bits of 1.6us counts (sched_timestamp). It only wraps after 1.9
+**         hours, the time between two frames is taken as the shortest one.
+**************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../j1850.h"
+#include "../j1850_cal.h"
+#include "../stats.h"
+#include "../bench.h"
+#include "../block.h"
+#include "usart_log.h"
+
+// a longer record of the PIC would be taken as an overrun and dropped
+#if USART_LOG_MAX < STATS_RECORD_LEN || USART_LOG_MAX < BENCH_RECORD_LEN || USART_LOG_MAX < BLOCK_RECORD_LEN || \
+    USART_LOG_MAX < J1850_CAL_REPORT_LEN || USART_LOG_MAX < USART_LOG_HEADER + 12
+#error "USART_LOG_MAX (usart_log.h) is shorter than a record of the PIC"
+#endif
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Initialize a decoder
+**           Inicialitza un descodificador
+** Parameters: decoder
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+void usart_log_init(usart_log_decoder *d)
+{
+	memset(d, 0, sizeof(*d));
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Internal function, check and split a complete record
+**           Funcio interna, comprova i separa els camps d'un registre complet
+** Parameters: decoder, record to fill
+** Returns: 1 if the record is good, 0 if not
+**---------------------------------------------------------------------------
+*/
+static int usart_log_parse(usart_log_decoder *d, usart_log_record *rec)
+{
+	if(d->n == 0) return 0;
+
+	memcpy(rec->payload, d->buf, d->n);
+	rec->size = d->n;
+	rec->type = d->buf[0];
+	if(rec->type != USART_LOG_FRAME) return 1;	// other records are left to the caller
+
+	if(d->n < USART_LOG_HEADER || d->buf[2] > 12 || d->n != USART_LOG_HEADER + d->buf[2]) return 0;
+	rec->status = d->buf[1];
+	rec->len = d->buf[2];
+	rec->timestamp = d->buf[3] | (d->buf[4] << 8) | ((uint32_t)d->buf[5] << 16) | ((uint32_t)d->buf[6] << 24);
+	rec->data = rec->payload + USART_LOG_HEADER;
+
+	if(d->have_time) d->time += (uint32_t)(rec->timestamp - d->last_ts);
+	d->have_time = 1;
+	d->last_ts = rec->timestamp;
+	rec->time = d->time;
+	return 1;
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Feed one byte read from the serial port
+**           Processa un byte llegit del port serie
+** Parameters: decoder, byte, record to fill
+** Returns: 1 when a good record has been written on rec, otherwise 0
+**---------------------------------------------------------------------------
+*/
+int usart_log_feed(usart_log_decoder *d, uint8_t ch, usart_log_record *rec)
+{
+	int ok;
+
+	if(ch == SLIP_END)
+	{
+		ok = !d->overrun && !d->esc && usart_log_parse(d, rec);
+		if(ok) ++d->records;
+		else if(d->n || d->overrun) ++d->bad;	// empty records are only line noise
+		d->n = 0;
+		d->esc = 0;
+		d->overrun = 0;
+		return ok;
+	}
+
+	if(d->esc)
+	{
+		d->esc = 0;
+		if(ch == SLIP_ESC_END) ch = SLIP_END;
+		else if(ch == SLIP_ESC_ESC) ch = SLIP_ESC;
+		else d->overrun = 1;	// protocol error, drop the record
+	}
+	else if(ch == SLIP_ESC)
+	{
+		d->esc = 1;
+		return 0;
+	}
+
+	if(d->n == USART_LOG_MAX) d->overrun = 1;
+	else d->buf[d->n++] = ch;
+	return 0;
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Feed one character of a hex log ("28 1B 10 02 0A F0 1C" + CR). A frame record is
+**           returned at the end of each line, with status OK and no timestamp (the old format only
+**           had good frames). LF is accepted as end of line too, so CR LF files are also read
+**           Processa un caracter d'un registre hexadecimal, retorna una trama per linia
+** Parameters: decoder, character, record to fill
+** Returns: 1 when a good record has been written on rec, otherwise 0
+**---------------------------------------------------------------------------
+*/
+int usart_log_hex_feed(usart_log_decoder *d, uint8_t ch, usart_log_record *rec)
+{
+	int ok, x;
+
+	if(ch >= '0' && ch <= '9') x = ch - '0';
+	else if(ch >= 'A' && ch <= 'F') x = ch - 'A' + 10;
+	else if(ch >= 'a' && ch <= 'f') x = ch - 'a' + 10;
+	else x = -1;
+
+	if(x >= 0)
+	{
+		if(d->hex_digits == 2) d->overrun = 1;	// more than 2 digits
+		d->hex_val = (d->hex_val << 4) | x;
+		++d->hex_digits;
+		return 0;
+	}
+	if(ch != ' ' && ch != '\r' && ch != '\n')
+	{
+		d->overrun = 1;		// not a hex log character
+		return 0;
+	}
+
+	if(d->hex_digits)		// end of a byte
+	{
+		if(d->n == 12) d->overrun = 1;
+		else d->buf[d->n++] = d->hex_val;
+		d->hex_digits = 0;
+		d->hex_val = 0;
+	}
+	if(ch == ' ') return 0;
+
+	ok = d->n && !d->overrun;	// end of line, empty lines (LF of CR LF) are skipped
+	if(ok)
+	{
+		memcpy(rec->payload, d->buf, d->n);
+		rec->size = d->n;
+		rec->type = USART_LOG_FRAME;
+		rec->status = J1850_RETURN_CODE_OK;
+		rec->len = d->n;
+		rec->timestamp = 0;
+		rec->time = 0;
+		rec->data = rec->payload;
+		++d->records;
+	}
+	else if(d->n || d->overrun) ++d->bad;
+	d->n = 0;
+	d->overrun = 0;
+	return ok;
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Print a record that is not a frame: calibration report of the receiver (USART_LOG_CAL),
+**           statistics (USART_LOG_STATS, times in us) and benchmark (USART_LOG_BENCH, instruction
+**           cycles). Other types only with their size
+**           Mostra un registre que no es una trama
+** Parameters: record
+** Returns: 1 if printed, 0 if it is a frame (left to the caller)
+**---------------------------------------------------------------------------
+*/
+int usart_log_print(const usart_log_record *rec)
+{
+	const uint8_t *p = rec->payload;
+	int i;
+
+	if(rec->type == USART_LOG_FRAME) return 0;
+	if(rec->type == USART_LOG_CAL && rec->size == J1850_CAL_REPORT_LEN)
+	{
+		printf("%12s CAL %s: active short < %.1f, passive long > %.1f, SOF >= %.1f us", "",
+			p[1] == J1850_CAL_ADAPT ? "adapt" : "learn", p[2] * USART_LOG_US_PER_COUNT,
+			p[3] * USART_LOG_US_PER_COUNT, p[4] * USART_LOG_US_PER_COUNT);
+		printf(" (centres:");
+		for(i = 5; i < J1850_CAL_REPORT_LEN; i++) printf(" %.1f", p[i] * USART_LOG_US_PER_COUNT);
+		printf(")\n");
+		return 1;
+	}
+	if(rec->type == USART_LOG_STATS && rec->size >= STATS_RECORD_HEADER && p[1] <= STATS_HEADERS &&
+	   rec->size == STATS_RECORD_HEADER + 5 * p[1])
+	{
+		printf("%12s STATS: CRC errors %u, SOF errors %u, bit errors %u, NO_DATA %u, ring overflows %u, USART dropped %u\n", "",
+			p[4] | (p[5] << 8), p[6] | (p[7] << 8), p[8] | (p[9] << 8), p[10] | (p[11] << 8), p[12], p[13]);
+		printf("%12s STATS: longest ISR high %.1f us, low %.1f us, main loop min %.1f avg %.1f max %.1f us\n", "",
+			(p[14] | (p[15] << 8)) * USART_LOG_US_PER_COUNT, (p[16] | (p[17] << 8)) * USART_LOG_US_PER_COUNT,
+			(p[18] | (p[19] << 8)) * USART_LOG_US_PER_COUNT, (p[20] | (p[21] << 8)) * USART_LOG_US_PER_COUNT,
+			(p[22] | (p[23] << 8)) * USART_LOG_US_PER_COUNT);
+		printf("%12s STATS: sent %u, arbitration lost %u, given up %u, latency avg %.1f max %.1f us\n", "",
+			p[24] | (p[25] << 8), p[26] | (p[27] << 8), p[28] | (p[29] << 8),
+			(p[30] | (p[31] << 8)) * USART_LOG_US_PER_COUNT, (p[32] | (p[33] << 8)) * USART_LOG_US_PER_COUNT);
+		for(i = 0; i < p[1]; i++)
+		{
+			const uint8_t *h = p + STATS_RECORD_HEADER + 5 * i;
+			printf("%12s STATS: header %02X %02X %02X frames %u\n", "", h[0], h[1], h[2], h[3] | (h[4] << 8));
+		}
+		printf("%12s STATS: other headers frames %u\n", "", p[2] | (p[3] << 8));
+		return 1;
+	}
+	if(rec->type == USART_LOG_BENCH && rec->size == BENCH_RECORD_LEN && p[1] == BENCH_PROBES)
+	{
+		printf("%12s BENCH: empty probe %u cycles\n", "", p[2] | (p[3] << 8));
+		for(i = 0; i < BENCH_PROBES; i++)
+		{
+			const uint8_t *b = p + BENCH_RECORD_HEADER + 8 * i;
+			printf("%12s BENCH: probe %d runs %u, cycles min %u avg %u max %u\n", "", i,
+				b[0] | (b[1] << 8), b[2] | (b[3] << 8), b[4] | (b[5] << 8), b[6] | (b[7] << 8));
+		}
+		return 1;
+	}
+	if(rec->type == USART_LOG_BLOCK && rec->size >= BLOCK_RECORD_HEADER && rec->size <= BLOCK_RECORD_LEN)
+	{
+		static const char *status[] = {"more", "done", "lost", "timeout", "overflow"};
+
+		printf("%12s BLOCK %02X %02X at %u, %s:", "", p[1], p[2], p[4] | (p[5] << 8),
+			p[3] <= BLOCK_OVERFLOW ? status[p[3]] : "?");
+		for(i = BLOCK_RECORD_HEADER; i < rec->size; i++) printf(" %02X", p[i]);
+		printf("\n");
+		return 1;
+	}
+	printf("record type 0x%02X, %u bytes\n", rec->type, rec->size);
+	return 1;
+}
@@ -0,0 +1,62 @@
+/*************************************************************************
+**  HARLEY DAVIDSON Sportster 883/1200 - J1850 VPW Interface
+**  Released under GNU GENERAL PUBLIC LICENSE
+**  Main MCU: MICROCHIP PIC18F2553
+**  Homepage: www.momex.cat
+**  Contact: morales.xavier@momex.cat
+**
+**
+**  Revision History
+**  11/06/2016   XM  v1.00   Initial Release on Github
+**
+**
+**   NOTE: PC decoder of the binary USART log (USART_LOG_BINARY in
+**         usart_tx.h). Bytes are fed one by one as they are read from the
+**         serial port, a record is returned each time a SLIP_END arrives.
+**         The old format (hex bytes separated by spaces and terminated with
+**         CR, USART_LOG_BINARY 0) is decoded the same way, one line at a time.
+**         Descodificador de PC del registre binari de la USART.
+**************************************************************************/
+
+#ifndef __USART_LOG_H__
+#define __USART_LOG_H__
+
+#include "../macros.h"
+#include "../usart_tx.h"
+
+#define USART_LOG_MAX	128	// biggest record accepted (after SLIP decoding), checked against the records in usart_log.c
+#define USART_LOG_US_PER_COUNT	1.6	// Timer1 count (T1CK8 at 20MHz)
+
+typedef struct {
+	uint8_t type;			// USART_LOG_xxx
+	uint8_t size;			// record bytes on payload
+	uint8_t payload[USART_LOG_MAX];	// whole record, type byte included
+	// USART_LOG_FRAME fields
+	uint8_t status;			// J1850_RETURN_CODE_OK or J1850_RETURN_CODE_DATA_ERROR
+	uint8_t len;			// number of frame bytes
+	uint32_t timestamp;		// Timer1 and its overflows, sent by the PIC
+	uint64_t time;			// timestamp without wraps, in Timer1 counts since the first frame
+	uint8_t *data;			// frame bytes (points into payload)
+} usart_log_record;
+
+typedef struct {
+	uint8_t buf[USART_LOG_MAX];
+	int n;				// bytes on buf
+	int esc;			// last byte was SLIP_ESC
+	int overrun;			// record too long, skip until SLIP_END
+	int have_time;			// last_ts is valid
+	int hex_digits;			// hex log: digits of the byte being read
+	uint8_t hex_val;		// hex log: value of the byte being read
+	uint32_t last_ts;
+	uint64_t time;
+	unsigned long records;		// good records
+	unsigned long bad;		// records that could not be decoded
+} usart_log_decoder;
+
+//Function Prototypes
+extern void usart_log_init(usart_log_decoder *d);
+extern int usart_log_feed(usart_log_decoder *d, uint8_t ch, usart_log_record *rec);
+extern int usart_log_hex_feed(usart_log_decoder *d, uint8_t ch, usart_log_record *rec);
+extern int usart_log_print(const usart_log_record *rec);
+
+#endif // __USART_LOG_H__
@@ -0,0 +1,55 @@
+/*************************************************************************
+**  HARLEY DAVIDSON Sportster 883/1200 - J1850 VPW Interface
+**  Released under GNU GENERAL PUBLIC LICENSE
+**  Main MCU: MICROCHIP PIC18F2553
+**  Homepage: www.momex.cat
+**  Contact: morales.xavier@momex.cat
+**
+**
+**  Revision History
+**  11/06/2016   XM  v1.00   Initial Release on Github
+**
+**
+**  Abstract: Print a binary USART log captured from the tacho (for example
+**            with "cat /dev/ttyUSB0 > capture.bin") as one frame per line:
+**            time in ms, status and the frame bytes. The reports of the
+**            receiver calibration (USART_LOG_CAL) and the statistics
+**            (USART_LOG_STATS) are printed in us, the parts of the block
+**            transfers (USART_LOG_BLOCK) in hex.
+**            Mostra un registre binari capturat de la USART.
+**
+**  Build:    gcc -O2 -I.. -o usart_log_dump usart_log_dump.c usart_log.c
+**  Usage:    usart_log_dump [capture.bin]
+**************************************************************************/
+
+#include <stdio.h>
+
+#include "../j1850.h"
+#include "usart_log.h"
+
+int main(int argc, char **argv)
+{
+	usart_log_decoder d;
+	usart_log_record rec;
+	FILE *f = stdin;
+	int ch, i;
+
+	if(argc > 1 && !(f = fopen(argv[1], "rb")))
+	{
+		perror(argv[1]);
+		return 1;
+	}
+
+	usart_log_init(&d);
+	while((ch = getc(f)) != EOF)
+	{
+		if(!usart_log_feed(&d, ch, &rec)) continue;
+		if(usart_log_print(&rec)) continue;	// not a frame
+		printf("%12.3f %s", rec.time * USART_LOG_US_PER_COUNT / 1000.0,
+			rec.status == J1850_RETURN_CODE_OK ? "OK " : "CRC");
+		for(i = 0; i < rec.len; i++) printf(" %02X", rec.data[i]);
+		printf("\n");
+	}
+	fprintf(stderr, "%lu records, %lu bad\n", d.records, d.bad);
+	return 0;
+}
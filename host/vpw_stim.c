@@ -0,0 +1,181 @@
+/*************************************************************************
+**  HARLEY DAVIDSON Sportster 883/1200 - J1850 VPW Interface
+**  Released under GNU GENERAL PUBLIC LICENSE
+**  Main MCU: MICROCHIP PIC18F2553
+**  Homepage: www.momex.cat
+**  Contact: morales.xavier@momex.cat
+**
+**
+**  Revision History
+**  11/06/2016   XM  v1.00   Initial Release on Github
+**
+**
+**  Abstract: Write a gpsim script that runs the benchmark build of the
+**            firmware (BENCH 1 in bench.h, with the defaults J1850_TX 0 in
+**            j1850_tx.h, DIAG 0 in diag.h and USART_LOG_BINARY 1 in
+**            usart_tx.h) with the frames of a USART log
+**            replayed as VPW waveforms on RB0. The rear switch (RA0) is
+**            pressed during the self-test, so the display refresh runs, and
+**            the frames start after it. With -m the switch is also pressed
+**            after the self-test to select a mode (-m 3: fuel consumption). Every byte written on TXREG is logged
+**            by gpsim, the run stops at bench_done() once the USART_LOG_BENCH
+**            record has been sent, bench_report turns the log into the
+**            results file. gpsim has no PIC18F2553, the PIC18F2550 has the
+**            same core and peripherals (only the ADC differs, not used).
+**            Genera un guio de gpsim per mesurar els cicles del firmware.
+**
+**  Build:    gcc -O2 -I.. -o vpw_stim vpw_stim.c usart_log.c
+**  Usage:    vpw_stim [-b] [-s ms] [-g us] [-a us] [-p us] [-j us] [-n frames] [-m mode] [-o log] firmware.cod [log]
+**              -b     binary SLIP log (default: hex bytes + CR, as tacho_replay)
+**              -s ms  start of the first frame after power on (default 2500, after the self-test)
+**              -g us  extra gap between frames (default 0, frames at the nominal IFS)
+**              -a/-p  us added to every active/passive symbol, -j random jitter +-us
+**              -n     frames replayed (default 200)
+**              -m     mode shown during the run, 0-3 short presses after the self-test (default 0, rpm)
+**              -o     gpsim log written by the script (default bench.log)
+**            vpw_stim tacho.cod capture.txt > bench.stc
+**            gpsim -i -c bench.stc
+**            bench_report bench.log > bench.txt
+**            (host/bench.sh does all the steps, with the build of the firmware)
+**************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../j1850.h"
+#include "usart_log.h"
+
+// nominal VPW symbols, in us
+#define VPW_SHORT_US	64
+#define VPW_LONG_US	128
+#define VPW_SOF_US	200
+#define VPW_IFS_US	300
+
+#define STIM_CYCLES_US	(INT_CLK / 1000000L)	// instruction cycles per us
+#define STIM_BUTTON_MS	50	// switch pressed from STIM_BUTTON_MS to 2*STIM_BUTTON_MS after power on
+#define STIM_MODE_MS	2300	// mode presses (-m), after the self-test: STIM_BUTTON_MS long, one every 4*STIM_BUTTON_MS
+
+static double skew_active, skew_passive, jitter;
+static unsigned long edges;
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Write one edge of RB0 (time, level) on the stimulus. RB0 is the bus after the NPN,
+**           0 while the bus is active
+** Parameters: cycle, bus active
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+static void edge(double cycle, int active)
+{
+	printf("%s%.0f, %d", edges % 4 ? ", " : (edges ? ",\n  " : "  "), cycle, !active);
+	++edges;
+}
+
+static double symbol_us(double us, int active)
+{
+	us += active ? skew_active : skew_passive;
+	if(jitter > 0) us += jitter * (2.0 * rand() / RAND_MAX - 1.0);
+	return us;
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Edges of one frame, SOF at the given cycle
+** Parameters: frame bytes, number of bytes, cycle of the SOF
+** Returns: cycle of the end of the frame (EOD)
+**---------------------------------------------------------------------------
+*/
+static double frame(const uint8_t *msg_buf, uint8_t nbytes, double t)
+{
+	int level = 1, bit, i, j;
+
+	edge(t, 1);
+	t += symbol_us(VPW_SOF_US, 1) * STIM_CYCLES_US;
+	for(i = 0; i < nbytes; i++)
+	{
+		for(j = 0; j < 8; j++)
+		{
+			level ^= 1;
+			edge(t, level);
+			bit = (msg_buf[i] >> (7 - j)) & 1;
+			// passive symbol: 1=long, active symbol: 1=short
+			t += symbol_us((bit ^ level) ? VPW_LONG_US : VPW_SHORT_US, level) * STIM_CYCLES_US;
+		}
+	}
+	if(level) edge(t, 0);	// EOD, bus back to passive
+	return t;
+}
+
+int main(int argc, char **argv)
+{
+	usart_log_decoder d;
+	usart_log_record rec;
+	FILE *in = stdin;
+	const char *log = "bench.log";
+	double t, start_ms = 2500, gap_us = 0;
+	unsigned long max = 200, n = 0;
+	int binary = 0, mode = 0, ch, ok, i, k;
+
+	for(i = 1; i < argc && argv[i][0] == '-' && argv[i][1]; i++)
+	{
+		if(strcmp(argv[i], "-b") == 0) binary = 1;
+		else if(strcmp(argv[i], "-s") == 0 && i + 1 < argc) start_ms = atof(argv[++i]);
+		else if(strcmp(argv[i], "-g") == 0 && i + 1 < argc) gap_us = atof(argv[++i]);
+		else if(strcmp(argv[i], "-a") == 0 && i + 1 < argc) skew_active = atof(argv[++i]);
+		else if(strcmp(argv[i], "-p") == 0 && i + 1 < argc) skew_passive = atof(argv[++i]);
+		else if(strcmp(argv[i], "-j") == 0 && i + 1 < argc) jitter = atof(argv[++i]);
+		else if(strcmp(argv[i], "-n") == 0 && i + 1 < argc) max = strtoul(argv[++i], 0, 0);
+		else if(strcmp(argv[i], "-m") == 0 && i + 1 < argc) mode = atoi(argv[++i]) & 3;
+		else if(strcmp(argv[i], "-o") == 0 && i + 1 < argc) log = argv[++i];
+		else break;
+	}
+	if(i >= argc || argv[i][0] == '-')
+	{
+		fprintf(stderr, "usage: vpw_stim [-b] [-s ms] [-g us] [-a us] [-p us] [-j us] [-n frames] [-m mode] [-o log] firmware.cod [log]\n");
+		return 1;
+	}
+	if(i + 1 < argc && !(in = fopen(argv[i + 1], binary ? "rb" : "r")))
+	{
+		perror(argv[i + 1]);
+		return 1;
+	}
+
+	printf("# gpsim benchmark run, written by vpw_stim\n");
+	printf("load p18f2550 %s\n\n", argv[i]);	// program and symbols (bench_done)
+	printf("# RA0, rear switch pressed during the self-test (the tacho is switched ON), then %d times (mode)\n", mode);
+	printf("stimulus asynchronous_stimulus\ninitial_state 1\nstart_cycle 0\n");
+	printf("{ %ld, 0, %ld, 1", STIM_BUTTON_MS * 1000L * STIM_CYCLES_US, 2 * STIM_BUTTON_MS * 1000L * STIM_CYCLES_US);
+	for(k = 0; k < mode; k++)
+	{
+		t = (STIM_MODE_MS + 4 * STIM_BUTTON_MS * k) * 1000.0 * STIM_CYCLES_US;
+		printf(",\n  %.0f, 0, %.0f, 1", t, t + STIM_BUTTON_MS * 1000.0 * STIM_CYCLES_US);
+	}
+	printf(" }\n");
+	printf("name button\nend\nnode nbutton\nattach nbutton porta0 button\n\n");
+
+	printf("# RB0, J1850 bus after the NPN (0 = bus active)\n");
+	printf("stimulus asynchronous_stimulus\ninitial_state 1\nstart_cycle 0\n{\n");
+	usart_log_init(&d);
+	t = start_ms * 1000.0 * STIM_CYCLES_US;
+	while(n < max && (ch = getc(in)) != EOF)
+	{
+		ok = binary ? usart_log_feed(&d, ch, &rec) : usart_log_hex_feed(&d, ch, &rec);
+		if(!ok || rec.type != USART_LOG_FRAME || rec.status != J1850_RETURN_CODE_OK || rec.len == 0) continue;
+		t = frame(rec.data, rec.len, t) + (VPW_IFS_US + gap_us) * STIM_CYCLES_US;
+		++n;
+	}
+	if(n == 0)
+	{
+		fprintf(stderr, "no frames\n");
+		return 1;
+	}
+	printf("\n}\nname vpw\nend\nnode nvpw\nattach nvpw portb0 vpw\n\n");
+
+	printf("# every byte sent on the USART, the results are on the USART_LOG_BENCH record\n");
+	printf("log on %s\nlog w TXREG\n", log);
+	printf("break e bench_done\nrun\nlog off\nquit\n");
+	fprintf(stderr, "%lu frames, %lu edges, last frame ends at %.1f ms\n", n, edges, t / (1000.0 * STIM_CYCLES_US));
+	return 0;
+}
@@ -16,8 +16,10 @@
 **         Based on Mictronics file j1850.c v1.07
 **************************************************************************/
 
-#include <p18f2553.h>
+#include "hal.h"
 #include "j1850.h"
+#include "j1850_rx.h"
+#include "j1850_tx.h"
 #include "macros.h"
 
 char display7seg2[10] = {0b01000000,0b11111000,0b00100010,0b00110000,0b10011000,0b00010100,0b10000100,0b01111000,0b00000000,0b00011000};
@@ -41,6 +43,7 @@ void j1850_init(void)
 
 }
 
+#if !J1850_TX	// busy wait transmitter, see j1850_send_msg()
 /* 
 **-------------------------------------------------------------------------------------------------------------------- 
 ** Abstract: This is an internal function used by the J1850 module to wait for the bus to become idle.
@@ -63,87 +66,98 @@ static void j1850_wait_idle(void)
 		}
 	}
 }
+#endif
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Start the interrupt driven receiver (j1850_rx.c). INT0 interrupts on every bus edge and
+**           Timer0 (8 bit, CK8) measures the symbols. Timer0 is preloaded so that it overflows when
+**           RX_EOD_MIN (j1850_rx_eod, the one of the speed of the frame) has passed without any edge,
+**           so the EOD is also detected by interrupt.
+**           Engega el receptor per interrupcions. INT0 salta a cada flanc i el Timer0 mesura els simbols.
+** Parameters: Pointer to frame buffer / punter al buffer de la trama
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+#define RX_T0_BASE(eod)	((uint8_t)(256 - (eod)))	// Timer0 preload, overflow after eod counts
 
-/* 
-**--------------------------------------------------------------------------- 
-** Abstract: Receive J1850 frame (max 12 bytes)
-**           Rebre trama J1850 (màxim 12 bytes)
-** Parameters: Pointer to frame buffer / punter al missatge al buffer
-** Returns: Number of received bytes OR in case of error, error code with bit 7 set as error indication
-**          Número de bytes rebuts o en cas d'error, el codi d'error amb el bit 7 usat com a inidcador d'error
-**--------------------------------------------------------------------------- 
-*/ 
-uint8_t j1850_recv_msg(uint8_t *msg_buf )
-{
-	uint8_t nbits;			// bit position counter within a byte
-	uint8_t nbytes;			// number of received bytes
-	uint8_t bit_state;		// used to compare bit state, active or passive
-	uint16_t tcnt1_buf;		//XM: used to compare counter
-	
-	/*wait for responds (if 100us pass without detection of a SOF--> answer with an error)*/			
-	timer0_16start(CK16B128);
-
-	while(!is_vpw_active())	// run as long bus is passive (IDLE)
-	{
-		if(timer0_get() >= WAIT_300us)	// check for 300us
-		{
-			timer0_stop();
-			
-			return J1850_RETURN_CODE_NO_DATA | 0x80;	// error, no responds within 100us
-		}
-	}
-	// wait for SOF
-	timer0_start(CK8);	// restart timer1
-	while(is_vpw_active())	// run as long bus is active (SOF is an active symbol)
-	{
-		if(timer0_get() >=  RX_SOF_MAX) return J1850_RETURN_CODE_BUS_ERROR | 0x80;	// error on SOF timeout
-	}
+static uint8_t rx_t0_wrapped;	// number of Timer0 overflows since the last edge (max 2)
+static uint8_t rx_t0_eod;	// eod of the Timer0 preload of the symbol being measured
 
-	
-	timer0_stop();
-	if(timer0_get() < RX_SOF_MIN) return J1850_RETURN_CODE_BUS_ERROR | 0x80;	// error, symbol was not SOF
+void j1850_rx_start(uint8_t *msg_buf)
+{
+	j1850_rx_init(msg_buf);
 
-	bit_state = is_vpw_active();	// store actual bus state
+	rx_t0_wrapped = 2;
+	rx_t0_eod = j1850_rx_eod;
 	timer0_start(CK8);
-	for(nbytes = 0; nbytes < 12; ++nbytes)
-	{
-		nbits = 8;
-		do
-		{
-			*msg_buf <<= 1;			//this is for refer bit by bit for every for cycle
-
-			while(is_vpw_active() == bit_state) // compare last with actual bus state, wait for change
-			{
-	
-				if(timer0_get() >= RX_EOD_MIN	)	// check for EOD symbol
-				{
-					timer0_stop();
-					return nbytes;	// return number of received bytes
-				}
-			}
-			bit_state = is_vpw_active();	// store actual bus state
-			tcnt1_buf = timer0_get();
-			timer0_start(CK8);
-
-			if( tcnt1_buf < RX_SHORT_MIN) return J1850_RETURN_CODE_BUS_ERROR | 0x80;	// error, pulse was to short
+	timer0_set(RX_T0_BASE(rx_t0_eod));
+	INTCON2bits.TMR0IP = 1;		// Timer0 on high priority, same as INT0
+	INTCONbits.TMR0IF = 0;
+	INTCONbits.TMR0IE = 0;		// enabled on the first edge
+
+	// first interrupt on the edge that changes the current bus state
+	INTCON2bits.INTEDG0 = is_vpw_active() ? !VPW_ACTIVE_EDGE : VPW_ACTIVE_EDGE;
+	INTCONbits.INT0IF = 0; 		//clear INT0 flag
+	INTCONbits.INT0IE = 1; 		//enable INT0 external interrupt
+}
 
-			// check for short active pulse = "1" bit
-			if( (tcnt1_buf < RX_SHORT_MAX) && !is_vpw_active() )
-				*msg_buf |= 1;
+/*
+**---------------------------------------------------------------------------
+** Abstract: Receiver part of the high priority ISR. It handles one single event (Timer0 overflow or
+**           INT0 edge) and returns, if the other one is also pending the ISR is entered again.
+**           Only called when INT0 or Timer0 interrupted, any other entry is taken as an INT0 edge.
+**           Part de la ISR d'alta prioritat. Tracta un sol event (Timer0 o INT0) i retorna.
+** Parameters: none
+** Returns: J1850_RX_PENDING while no frame has been finished
+**          Number of received bytes OR in case of error, error code with bit 7 set as error indication
+**---------------------------------------------------------------------------
+*/
+uint8_t j1850_rx_isr(void)
+{
+	uint8_t cnt;		// Timer0 value at the edge
+	uint8_t width;		// symbol width in us2cntT0CON8 counts
+	uint8_t bus_active;	// bus state since the last edge
+	uint8_t eod;		// preload of the symbol that has just finished
+	uint8_t rx;		// result of the receiver
 
-			// check for long passive pulse = "1" bit
-			if( (tcnt1_buf > RX_LONG_MIN) && (tcnt1_buf < RX_LONG_MAX) && is_vpw_active() )
-				*msg_buf |= 1;
+	bus_active = (INTCON2bits.INTEDG0 != VPW_ACTIVE_EDGE);
 
-		} while(--nbits);// end 8 bit while loop. XM: Part of the Do-While. While nbits is not 0 has to Do all that above and decrement on bit each time.
-		
-		++msg_buf;	// store next byte. XM: Goes to the next memory direction, this means the next byte on the struct[]
-	
-	}	// end 12 byte for loop
+	if(INTCONbits.TMR0IE && INTCONbits.TMR0IF)	// no edge during RX_EOD_MIN
+	{
+		INTCONbits.TMR0IF = 0;
+		if(rx_t0_wrapped < 2) ++rx_t0_wrapped;
+		if(!bus_active) INTCONbits.TMR0IE = 0;	// bus is idle, nothing more to measure until next edge
+		return j1850_rx_timeout(bus_active);
+	}
 
-	// return after a maximum of 12 bytes
-	timer0_stop();	
-	return nbytes;
+	cnt = timer0_get();
+	eod = rx_t0_eod;
+	timer0_set(RX_T0_BASE(eod));	// restart symbol measurement
+	INTCONbits.INT0IF = 0; 		//clear INT0 flag
+	INTCON2bits.INTEDG0 ^= 1;	// next interrupt on the opposite edge
+
+	// cnt - RX_T0_BASE(eod) without overflow and cnt + eod after one overflow are the same byte,
+	// after one overflow a sum that wraps the byte (width < cnt) is a symbol longer than 255 counts
+	width = cnt + eod;
+	if(rx_t0_wrapped > 1 || (rx_t0_wrapped && width < cnt))
+		width = 0xFF;		// longer than any J1850 symbol
+
+	rx_t0_wrapped = 0;
+	INTCONbits.TMR0IF = 0;
+	INTCONbits.TMR0IE = 1;
+
+	j1850_tx_edge(!bus_active);	// IFS wait and arbitration of the transmitter (j1850_tx.c)
+	rx = j1850_rx_edge(!bus_active, width);
+#if J1850_HIGH_SPEED
+	if(rx_t0_eod != j1850_rx_eod)	// SOF of the other speed, the first data symbol ends its EOD at the new time
+	{
+		cnt = timer0_get() - RX_T0_BASE(rx_t0_eod);
+		rx_t0_eod = j1850_rx_eod;
+		timer0_set(RX_T0_BASE(rx_t0_eod) + cnt);
+	}
+#endif
+	return rx;
 }
 
 
@@ -156,6 +170,21 @@ uint8_t j1850_recv_msg(uint8_t *msg_buf )
 **          1 = OK
 **--------------------------------------------------------------------------- 
 */ 
+#if J1850_TX
+// The frame is sent by the Timer3 interrupt (j1850_tx.c), here it only waits for the result.
+// The callers that can not wait use j1850_tx_queue() and j1850_tx_status() instead
+uint8_t j1850_send_msg(uint8_t *msg_buf, int8_t nbytes)
+{
+	uint8_t ticket;
+	uint8_t status;
+
+	if(nbytes < 1 || nbytes > 12)	return J1850_RETURN_CODE_DATA_ERROR;	// error, message to long, see SAE J1850
+
+	while(!(ticket = j1850_tx_queue(msg_buf, nbytes)));	// wait for a free slot on the queue
+	while((status = j1850_tx_status(ticket)) == J1850_TX_PENDING);
+	return status;
+}
+#else
 uint8_t j1850_send_msg(uint8_t *msg_buf, int8_t nbytes)
 {
 	uint8_t temp_byte;	// temporary byte store
@@ -210,43 +239,4 @@ while (timer0_get() <= TX_EOF); // wait for EOF complete
 timer0_stop();
 return J1850_RETURN_CODE_OK;	// no error
 }
-
-/* 
-**--------------------------------------------------------------------------- 
-** 
-** Abstract: Calculate J1850 CRC. XM: Not used for Tachometer, used for dummy emmiter node.
-**           Calcular el J1850 CRC. XM: No s'utilitza pel tacòmetre, s'utilitza pel node emisor per motius de test.
-** Parameters: Pointer to frame buffer, frame length / Punter al missatge al buffer, número bytes del missatge
-** Returns: CRC of frame
-**--------------------------------------------------------------------------- 
-*/ 
-// calculate J1850 message CRC
-uint8_t j1850_crc(uint8_t *msg_buf, int8_t nbytes)
-{
-	uint8_t crc_reg=0xff,poly,byte_count,bit_count;
-	uint8_t *byte_point;
-	uint8_t bit_point;
-
-	for (byte_count=0, byte_point=msg_buf; byte_count<nbytes; ++byte_count, ++byte_point)
-	{
-		for (bit_count=0, bit_point=0x80 ; bit_count<8; ++bit_count, bit_point>>=1)
-		{
-			if (bit_point & *byte_point)	// case for new bit = 1
-			{
-				if (crc_reg & 0x80)
-					poly=1;	// define the polynomial
-				else
-					poly=0x1c;
-				crc_reg= ( (crc_reg << 1) | 1) ^ poly;
-			}
-			else		// case for new bit = 0
-			{
-				poly=0;
-				if (crc_reg & 0x80)
-					poly=0x1d;
-				crc_reg= (crc_reg << 1) ^ poly;
-			}
-		}
-	}
-	return ~crc_reg;	// Return CRC
-}
+#endif // J1850_TX
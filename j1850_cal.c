@@ -0,0 +1,222 @@
+/*************************************************************************
+**  HARLEY DAVIDSON Sportster 883/1200 - J1850 VPW Interface
+**  Released under GNU GENERAL PUBLIC LICENSE
+**  Main MCU: MICROCHIP PIC18F2553
+**  Homepage: www.momex.cat
+**  Contact: morales.xavier@momex.cat
+**
+**
+**  Revision History
+**  11/06/2016   XM  v1.00   Initial Release on Github
+**
+**
+**   NOTE: The high priority ISR counts on one bank of j1850_cal_hist while
+**         j1850_cal_update() empties the other one, the bank is swapped
+**         with a single byte write, so no interrupt is disabled. The
+**         counts are added to a running histogram that loses 1/4 on every
+**         update, so the thresholds follow the last second of traffic. The
+**         SOF symbols are known by the state of the receiver, so they only
+**         need a running mean instead of a histogram.
+**         The thresholds are bytes, the ISR always reads them whole.
+**************************************************************************/
+
+#include "j1850.h"
+#include "j1850_cal.h"
+#include "usart_tx.h"
+#include "macros.h"
+
+// first bin whose centre is not below width w (us2cntT0CON8 counts)
+#define CAL_BIN(w)	(((w) + (1 << (J1850_CAL_SHIFT - 1)) - 1) >> J1850_CAL_SHIFT)
+#define CAL_HALF_BIN	((1 << J1850_CAL_SHIFT) - 1)	// twice the mean of the widths of a bin minus its first one
+
+volatile j1850_cal_limits j1850_cal_lim = {RX_SHORT_MAX, RX_LONG_MIN, RX_SOF_MIN};
+
+#if J1850_CAL
+uint8_t j1850_cal_hist[2][2][J1850_CAL_BINS];
+uint16_t j1850_cal_sof_sum[2];
+uint8_t j1850_cal_sof_n[2];
+volatile uint8_t j1850_cal_bank;
+
+static uint16_t cal_run[2][J1850_CAL_BINS];	// running histograms, only used by the main loop
+static uint32_t cal_sof_sum;			// running sum and number of the SOF widths
+static uint16_t cal_sof_n;
+static uint8_t cal_mode;			// J1850_CAL_LEARN or J1850_CAL_ADAPT
+static uint8_t cal_updates;			// updates since the last report
+static uint8_t cal_report[J1850_CAL_REPORT_LEN];
+static volatile uint8_t cal_pending;		// cal_report is waiting for the ISR
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Start the calibration with the RX_* thresholds and empty histograms. Has to be called
+**           before the receiver is started
+**           Comenca la calibracio amb els llindars RX_* i els histogrames buits
+** Parameters: J1850_CAL_LEARN: only histograms and reports. J1850_CAL_ADAPT: thresholds are moved
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+void j1850_cal_init(uint8_t mode)
+{
+	uint8_t i, j;
+
+	j1850_cal_lim.short_max = RX_SHORT_MAX;
+	j1850_cal_lim.long_min = RX_LONG_MIN;
+	j1850_cal_lim.sof_min = RX_SOF_MIN;
+	for(i = 0; i < 2; i++)
+	{
+		for(j = 0; j < J1850_CAL_BINS; j++)
+		{
+			j1850_cal_hist[0][i][j] = 0;
+			j1850_cal_hist[1][i][j] = 0;
+			cal_run[i][j] = 0;
+		}
+		j1850_cal_sof_sum[i] = 0;
+		j1850_cal_sof_n[i] = 0;
+	}
+	cal_sof_sum = 0;
+	cal_sof_n = 0;
+	j1850_cal_bank = 0;
+	cal_mode = mode;
+	cal_updates = 0;
+	cal_pending = 0;
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Internal function, centre of the symbols counted between two widths
+**           Funcio interna, centre dels simbols comptats entre dues amplades
+** Parameters: running histogram, first width, first width that is not included (counts)
+** Returns: weighted mean width in counts, 0 if there are less than J1850_CAL_MIN counts
+**---------------------------------------------------------------------------
+*/
+static uint8_t cal_centre(uint16_t *run, uint8_t from, uint8_t to)
+{
+	uint8_t bin, last;
+	uint16_t n;
+	uint32_t sum;
+
+	bin = CAL_BIN(from);
+	last = CAL_BIN(to);
+	if(last > J1850_CAL_BINS) last = J1850_CAL_BINS;
+	n = 0;
+	sum = 0;
+	for(; bin < last; bin++)
+	{
+		n += run[bin];
+		sum += (uint32_t)run[bin] * bin;
+	}
+	if(n < J1850_CAL_MIN) return 0;
+	return (uint8_t)(((sum << (J1850_CAL_SHIFT + 1)) + (uint32_t)n * CAL_HALF_BIN) / (2 * (uint32_t)n));
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Internal function, threshold in the middle of two symbol centres, inside a window
+**           Funcio interna, llindar entre els centres de dos simbols, dins d'una finestra
+** Parameters: centre of the shorter and of the longer symbol (0=unknown), window, current threshold
+** Returns: new threshold, the current one if any centre is unknown
+**---------------------------------------------------------------------------
+*/
+static uint8_t cal_split(uint8_t lo, uint8_t hi, uint8_t min, uint8_t max, uint8_t current)
+{
+	uint8_t mid;
+
+	if(!lo || !hi) return current;
+	mid = (uint8_t)(((uint16_t)lo + hi) >> 1);
+	if(mid < min) return min;
+	if(mid > max) return max;
+	return mid;
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Task of the main loop, every J1850_CAL_MS. Takes the histogram bank filled by the ISR,
+**           adds it to the running histograms and, on J1850_CAL_ADAPT, moves the thresholds. Every
+**           J1850_CAL_REPORT updates a report record is prepared for the ISR (j1850_cal_record())
+**           Tasca del bucle principal. Actualitza els histogrames i els llindars
+** Parameters: none
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+void j1850_cal_update(void)
+{
+	uint8_t *bank;
+	uint16_t *run;
+	uint8_t i, done;
+	uint8_t a_short, a_long, a_sof, p_short, p_long;
+
+	done = j1850_cal_bank;
+	j1850_cal_bank ^= 1;	// from now on the ISR counts on the other bank
+	bank = j1850_cal_hist[done][0];
+	run = cal_run[0];
+	for(i = 0; i < 2 * J1850_CAL_BINS; i++)
+	{
+		run[i] -= run[i] >> J1850_CAL_DECAY;
+		run[i] += bank[i];
+		bank[i] = 0;
+	}
+	cal_sof_sum -= cal_sof_sum >> J1850_CAL_DECAY;
+	cal_sof_sum += j1850_cal_sof_sum[done];
+	cal_sof_n -= cal_sof_n >> J1850_CAL_DECAY;
+	cal_sof_n += j1850_cal_sof_n[done];
+	j1850_cal_sof_sum[done] = 0;
+	j1850_cal_sof_n[done] = 0;
+
+	// data symbols split by the current thresholds. A passive symbol equal to long_min is a short
+	a_short = cal_centre(cal_run[J1850_CAL_ACTIVE], RX_SHORT_MIN, j1850_cal_lim.short_max);
+	a_long = cal_centre(cal_run[J1850_CAL_ACTIVE], j1850_cal_lim.short_max, RX_EOD_MIN);
+	a_sof = 0;
+	if(cal_sof_n >= J1850_CAL_MIN_SOF) a_sof = (uint8_t)((cal_sof_sum + (cal_sof_n >> 1)) / cal_sof_n);
+	p_short = cal_centre(cal_run[J1850_CAL_PASSIVE], RX_SHORT_MIN, j1850_cal_lim.long_min + 1);
+	p_long = cal_centre(cal_run[J1850_CAL_PASSIVE], j1850_cal_lim.long_min + 1, RX_EOD_MIN);
+
+	if(cal_mode == J1850_CAL_ADAPT)
+	{
+		j1850_cal_lim.short_max = cal_split(a_short, a_long, CAL_SHORT_LONG_MIN, CAL_SHORT_LONG_MAX, j1850_cal_lim.short_max);
+		j1850_cal_lim.long_min = cal_split(p_short, p_long, CAL_SHORT_LONG_MIN, CAL_SHORT_LONG_MAX, j1850_cal_lim.long_min);
+		j1850_cal_lim.sof_min = cal_split(a_long, a_sof, CAL_SOF_MIN_MIN, CAL_SOF_MIN_MAX, j1850_cal_lim.sof_min);
+	}
+
+	if(++cal_updates < J1850_CAL_REPORT || cal_pending) return;	// the last report has not been sent yet
+	cal_updates = 0;
+	cal_report[0] = USART_LOG_CAL;
+	cal_report[1] = cal_mode;
+	cal_report[2] = j1850_cal_lim.short_max;
+	cal_report[3] = j1850_cal_lim.long_min;
+	cal_report[4] = j1850_cal_lim.sof_min;
+	cal_report[5] = a_short;
+	cal_report[6] = a_long;
+	cal_report[7] = a_sof;
+	cal_report[8] = p_short;
+	cal_report[9] = p_long;
+	cal_pending = 1;
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: ISR side. Report record prepared by j1850_cal_update(), it has to be written on the USART
+**           ring before the ISR returns (the high priority ISR is the only writer of the ring)
+**           Costat de la ISR. Registre d'informe pendent d'enviar
+** Parameters: none
+** Returns: Pointer to the record (J1850_CAL_REPORT_LEN bytes), 0 if there is nothing to send
+**---------------------------------------------------------------------------
+*/
+uint8_t *j1850_cal_record(void)
+{
+	if(!cal_pending) return 0;
+	cal_pending = 0;
+	return cal_report;
+}
+#else
+void j1850_cal_init(uint8_t mode)
+{
+}
+
+void j1850_cal_update(void)
+{
+}
+
+uint8_t *j1850_cal_record(void)
+{
+	return 0;
+}
+#endif // J1850_CAL
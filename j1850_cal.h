@@ -0,0 +1,98 @@
+/*************************************************************************
+**  HARLEY DAVIDSON Sportster 883/1200 - J1850 VPW Interface
+**  Released under GNU GENERAL PUBLIC LICENSE
+**  Main MCU: MICROCHIP PIC18F2553
+**  Homepage: www.momex.cat
+**  Contact: morales.xavier@momex.cat
+**
+**
+**  Revision History
+**  11/06/2016   XM  v1.00   Initial Release on Github
+**
+**
+**   NOTE: Adaptive calibration of the receiver thresholds. The receiver
+**         (j1850_rx.c) counts the width of every accepted data symbol on a
+**         histogram, one for active and one for passive symbols, and adds
+**         up the SOF widths. A task of the main loop finds the centre of
+**         each symbol and moves the short/long and SOF thresholds to the
+**         middle between them, always inside the CAL_* windows around the
+**         SAE J1850 limits.
+**         Calibracio adaptativa dels llindars del receptor.
+**************************************************************************/
+
+#ifndef __J1850_CAL_H__	//if j1850_cal.h has not been defined--> define it || if yes --> do nothing
+#define __J1850_CAL_H__
+
+#include "macros.h"
+#include "j1850.h"
+
+// 1: adaptive thresholds (this module). 0: fixed RX_* limits of j1850.h, nothing is counted
+#ifndef J1850_CAL	// or -DJ1850_CAL=0
+#define J1850_CAL	1
+#endif
+
+#define J1850_CAL_MS		100	// the histograms are collected and the thresholds updated every J1850_CAL_MS
+#define J1850_CAL_REPORT	10	// a report record is sent on the USART every J1850_CAL_REPORT updates
+#define J1850_CAL_SHIFT		2	// histogram bin = width >> J1850_CAL_SHIFT (4 counts, 6.4us)
+#define J1850_CAL_BINS		26	// data symbols, up to RX_EOD_MIN
+#define J1850_CAL_DECAY		2	// every update the running histograms lose 1/4 of their counts
+#define J1850_CAL_MIN		64	// running counts needed on both sides of a threshold to move it
+#define J1850_CAL_MIN_SOF	16	// running count of SOF symbols needed to move the SOF minimum
+
+#define J1850_CAL_ACTIVE	0	// histogram of the active data symbols (short "1", long "0")
+#define J1850_CAL_PASSIVE	1	// histogram of the passive data symbols (short "0", long "1")
+
+// modes, see j1850_cal_init()
+#define J1850_CAL_LEARN		0	// histograms and reports only, the thresholds stay on the RX_* values
+#define J1850_CAL_ADAPT		1	// the thresholds follow the histograms
+
+// windows of the adaptive thresholds. The short/long threshold can move from the SAE limit (96us)
+// halfway to the nominal short (64us) or long (128us), so a symbol with the nominal time is always
+// taken right. The SOF minimum goes from the hand tuned RX_SOF_MIN up to the SAE limit (163us)
+#define CAL_SHORT_LONG_MIN	us2cntT0CON8(80)
+#define CAL_SHORT_LONG_MAX	us2cntT0CON8(112)
+#define CAL_SOF_MIN_MIN		RX_SOF_MIN
+#define CAL_SOF_MIN_MAX		RX_EOD_MIN
+
+// thresholds used by j1850_rx_edge(), in us2cntT0CON8 counts
+typedef struct {
+	uint8_t short_max;	// active symbol shorter than this is a short ("1"), RX_SHORT_MAX
+	uint8_t long_min;	// passive symbol longer than this is a long ("1"), RX_LONG_MIN
+	uint8_t sof_min;	// minimum start of frame, RX_SOF_MIN
+} j1850_cal_limits;
+
+#if J1850_CAL
+#define RX_CAL_SHORT_MAX	j1850_cal_lim.short_max
+#define RX_CAL_LONG_MIN		j1850_cal_lim.long_min
+#define RX_CAL_SOF_MIN		j1850_cal_lim.sof_min
+#else
+#define RX_CAL_SHORT_MAX	RX_SHORT_MAX
+#define RX_CAL_LONG_MIN		RX_LONG_MIN
+#define RX_CAL_SOF_MIN		RX_SOF_MIN
+#endif
+
+// Report record, sent with usart_tx_record() (SLIP framed like the frames):
+//   byte 0: record type (USART_LOG_CAL)
+//   byte 1: mode (J1850_CAL_LEARN or J1850_CAL_ADAPT)
+//   byte 2-4: thresholds short_max, long_min, sof_min
+//   byte 5-9: measured centre of the active short, active long, SOF, passive short and passive long
+//             symbols (0 = not enough symbols)
+//   all the widths in us2cntT0CON8 counts (1.6us)
+#define J1850_CAL_REPORT_LEN	10
+
+extern volatile j1850_cal_limits j1850_cal_lim;
+
+// ISR side of the histograms: [bank][J1850_CAL_ACTIVE/PASSIVE][bin] and the sum and number of the SOF
+// widths of each bank. The receiver only counts on the bank j1850_cal_bank, the other one belongs to
+// the main loop
+extern uint8_t j1850_cal_hist[2][2][J1850_CAL_BINS];
+extern uint16_t j1850_cal_sof_sum[2];
+extern uint8_t j1850_cal_sof_n[2];
+extern volatile uint8_t j1850_cal_bank;
+
+//Function Prototypes
+extern void j1850_cal_init(uint8_t mode);
+extern void j1850_cal_update(void);
+extern uint8_t *j1850_cal_record(void);
+
+#endif // __J1850_CAL_H__
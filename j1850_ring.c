@@ -0,0 +1,111 @@
+/*************************************************************************
+**  HARLEY DAVIDSON Sportster 883/1200 - J1850 VPW Interface
+**  Released under GNU GENERAL PUBLIC LICENSE
+**  Main MCU: MICROCHIP PIC18F2553
+**  Homepage: www.momex.cat
+**  Contact: morales.xavier@momex.cat
+**
+**
+**  Revision History
+**  11/06/2016   XM  v1.00   Initial Release on Github
+**
+**
+**   NOTE: Single producer (ISR) / single consumer (main loop) frame ring.
+**         ring_head is only written by the ISR and ring_tail only by the main
+**         loop, both are 8 bit so they are always read in one instruction.
+**         The slot at ring_head is never read by the main loop, so the
+**         receiver writes the frame directly on it (no copy is needed).
+**************************************************************************/
+
+#include "j1850_ring.h"
+#include "macros.h"
+
+#define RING_MASK	(J1850_RING_SIZE - 1)
+
+static j1850_frame ring[J1850_RING_SIZE];
+static volatile uint8_t ring_head;	// next slot to be written by the ISR
+static volatile uint8_t ring_tail;	// next slot to be read by the main loop
+volatile uint8_t j1850_ring_overflows;
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Empty the ring. Has to be called before the receiver interrupt is enabled
+**           Buida la cua. S'ha de cridar abans d'activar la interrupcio del receptor
+** Parameters: none
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+void j1850_ring_init(void)
+{
+	ring_head = 0;
+	ring_tail = 0;
+	j1850_ring_overflows = 0;
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: ISR side. Slot where the next received frame has to be written
+**           Costat de la ISR. Posicio on s'ha d'escriure la seguent trama
+** Parameters: none
+** Returns: Pointer to the slot
+**---------------------------------------------------------------------------
+*/
+j1850_frame *j1850_ring_wr(void)
+{
+	return &ring[ring_head];
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: ISR side. Publish the frame written on j1850_ring_wr() to the main loop. If the ring is
+**           full the frame is dropped (the slot will be used again) and j1850_ring_overflows is increased
+**           Costat de la ISR. Passa la trama al bucle principal. Si la cua es plena es perd la trama
+** Parameters: number of bytes, status, timestamp
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+void j1850_ring_commit(uint8_t len, uint8_t status, uint16_t timestamp)
+{
+	j1850_frame *frame;
+	uint8_t next;
+
+	next = (ring_head + 1) & RING_MASK;
+	if(next == ring_tail)	// ring full, main loop has not read the oldest frame yet
+	{
+		++j1850_ring_overflows;
+		return;
+	}
+
+	frame = &ring[ring_head];
+	frame->len = len;
+	frame->status = status;
+	frame->timestamp = timestamp;
+	ring_head = next;	// publish, has to be the last write
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Main loop side. Oldest frame not processed yet. It stays valid until j1850_ring_release()
+**           Costat del bucle principal. Trama mes antiga encara no processada
+** Parameters: none
+** Returns: Pointer to the frame, 0 if the ring is empty
+**---------------------------------------------------------------------------
+*/
+j1850_frame *j1850_ring_rd(void)
+{
+	if(ring_tail == ring_head) return 0;
+	return &ring[ring_tail];
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Main loop side. Give back the slot returned by j1850_ring_rd() to the ISR
+**           Costat del bucle principal. Retorna la posicio llegida a la ISR
+** Parameters: none
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+void j1850_ring_release(void)
+{
+	ring_tail = (ring_tail + 1) & RING_MASK;
+}
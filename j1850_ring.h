@@ -0,0 +1,42 @@
+/*************************************************************************
+**  HARLEY DAVIDSON Sportster 883/1200 - J1850 VPW Interface
+**  Released under GNU GENERAL PUBLIC LICENSE
+**  Main MCU: MICROCHIP PIC18F2553
+**  Homepage: www.momex.cat
+**  Contact: morales.xavier@momex.cat
+**
+**
+**  Revision History
+**  11/06/2016   XM  v1.00   Initial Release on Github
+**
+**
+**   NOTE: Ring of received frames between the ISR (only writer) and the
+**         main loop (only reader). Each index is written by one side only,
+**         so no interrupt has to be disabled to pass the frames.
+**         Cua de trames entre la ISR (escriptor) i el bucle principal (lector).
+**************************************************************************/
+
+#ifndef __J1850_RING_H__	//if J1850_ring.h has not been defined--> define it || if yes --> do nothing
+#define __J1850_RING_H__
+
+#include "macros.h"
+
+#define J1850_RING_SIZE	8	// number of frame slots, has to be a power of 2. One slot is always owned by the ISR
+
+typedef struct {
+	uint8_t len;		// number of received bytes
+	uint8_t status;		// J1850_RETURN_CODE_xxx
+	uint16_t timestamp;	// Timer1 value (T1CK8, 1.6us counts) when the frame was finished
+	uint8_t data[12];	// J1850 message buffer
+} j1850_frame;
+
+extern volatile uint8_t j1850_ring_overflows;	// frames lost because the main loop was too slow
+
+//Function Prototypes
+extern void j1850_ring_init(void);
+extern j1850_frame *j1850_ring_wr(void);
+extern void j1850_ring_commit(uint8_t len, uint8_t status, uint16_t timestamp);
+extern j1850_frame *j1850_ring_rd(void);
+extern void j1850_ring_release(void);
+
+#endif // __J1850_RING_H__
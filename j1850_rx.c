@@ -0,0 +1,291 @@
+/*************************************************************************
+**  HARLEY DAVIDSON Sportster 883/1200 - J1850 VPW Interface
+**  Released under GNU GENERAL PUBLIC LICENSE
+**  Main MCU: MICROCHIP PIC18F2553
+**  Homepage: www.momex.cat
+**  Contact: morales.xavier@momex.cat
+**
+**
+**  Revision History
+**  11/06/2016   XM  v1.00   Initial Release on Github
+**
+**
+**   NOTE: Edge driven receiver, it replaces the j1850_recv_msg of the
+**         Mictronics code that polled the bus for the whole frame. The
+**         symbol classification is the same, every call handles one
+**         single edge and returns.
+**         With J1850_HIGH_SPEED the width of the SOF tells the speed of the
+**         frame (1x or 4x), and the limits of its data symbols are copied
+**         to rx_t, so the edges cost the same at both speeds.
+**         Receptor per flancs. Cada crida tracta un sol flanc.
+**************************************************************************/
+
+#include "j1850.h"
+#include "j1850_rx.h"
+#include "j1850_cal.h"
+#include "macros.h"
+
+static uint8_t rx_state;	// J1850_RX_IDLE, J1850_RX_SOF, J1850_RX_DATA or J1850_RX_SKIP
+static uint8_t rx_nbits;	// bits still missing on the current byte
+static uint8_t rx_nbytes;	// number of received bytes
+static uint8_t rx_byte;		// byte being received
+static uint8_t *rx_buf;		// frame buffer (12 bytes)
+static uint8_t *rx_ptr;		// next byte to be written on rx_buf
+static uint8_t rx_crc;		// CRC register, updated when each byte is completed
+volatile uint16_t j1850_rx_crc_errors;	// frames rejected because of a wrong CRC
+volatile uint16_t j1850_rx_sof_errors;	// BUS_ERROR, first active symbol was not a SOF
+volatile uint16_t j1850_rx_bit_errors;	// BUS_ERROR, symbol too short or break inside a frame
+volatile uint16_t j1850_rx_no_data;	// NO_DATA, frame finished without any complete byte
+
+// J1850_SPEED_1X and J1850_SPEED_4X, SAE J1850 times (j1850.h)
+const rom j1850_timing j1850_timings[J1850_SPEEDS] = {
+	{TX_SHORT, TX_LONG, TX_SOF, TX_EOF, TX_IFS,
+	 RX_SHORT_MIN, RX_SHORT_MAX, RX_LONG_MIN, RX_LONG_MAX, RX_SOF_MIN, RX_SOF_MAX, RX_EOD_MIN},
+	{TX4_SHORT, TX4_LONG, TX4_SOF, TX4_EOF, TX4_IFS,
+	 RX4_SHORT_MIN, RX4_SHORT_MAX, RX4_LONG_MIN, RX4_LONG_MAX, RX4_SOF_MIN, RX4_SOF_MAX, RX4_EOD_MIN}
+};
+
+#if J1850_HIGH_SPEED
+volatile uint8_t j1850_speed = J1850_SPEED_1X;
+volatile uint8_t j1850_rx_eod = RX_EOD_MIN;
+
+// limits of the data symbols of the frame being received, set on its SOF
+typedef struct {
+	uint8_t short_min;
+	uint8_t short_max;
+	uint8_t long_min;
+	uint8_t long_max;
+} rx_timing;
+static rx_timing rx_t;
+static uint8_t rx_speed;	// speed of the frame being received
+#define RX_T_SHORT_MIN	rx_t.short_min
+#define RX_T_SHORT_MAX	rx_t.short_max
+#define RX_T_LONG_MIN	rx_t.long_min
+#define RX_T_LONG_MAX	rx_t.long_max
+#define RX_T_1X		(rx_speed == J1850_SPEED_1X)	// the calibration only counts the 1x symbols
+#else
+#define RX_T_SHORT_MIN	RX_SHORT_MIN
+#define RX_T_SHORT_MAX	RX_CAL_SHORT_MAX
+#define RX_T_LONG_MIN	RX_CAL_LONG_MIN
+#define RX_T_LONG_MAX	RX_LONG_MAX
+#define RX_T_1X		1
+#endif
+
+#if J1850_CAL
+// count one accepted symbol for the calibration (j1850_cal.c)
+#define RX_CAL_COUNT(polarity, width)	if(RX_T_1X && (width) < (J1850_CAL_BINS << J1850_CAL_SHIFT)) \
+	{ rx_hist = &j1850_cal_hist[j1850_cal_bank][polarity][(width) >> J1850_CAL_SHIFT]; if(*rx_hist != 255) ++*rx_hist; }
+#define RX_CAL_SOF(width)	if(RX_T_1X && j1850_cal_sof_n[j1850_cal_bank] != 255) \
+	{ ++j1850_cal_sof_n[j1850_cal_bank]; j1850_cal_sof_sum[j1850_cal_bank] += (width); }
+static uint8_t *rx_hist;
+#else
+#define RX_CAL_COUNT(polarity, width)
+#define RX_CAL_SOF(width)
+#endif
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Internal function, end of frame. The CRC has already been calculated during the reception,
+**           it only has to be compared with the residue of a good frame
+**           Funcio interna, final de trama. El CRC ja s'ha calculat durant la recepcio
+** Parameters: none
+** Returns: Number of received bytes OR J1850_RETURN_CODE_DATA_ERROR with bit 7 set if the CRC is wrong
+**          OR J1850_RETURN_CODE_NO_DATA with bit 7 set if there is no byte
+**---------------------------------------------------------------------------
+*/
+static uint8_t j1850_rx_check(void)
+{
+	if(rx_nbytes == 0)
+	{
+		++j1850_rx_no_data;
+		return J1850_RETURN_CODE_NO_DATA | 0x80;	// error, SOF and EOD only
+	}
+	if(rx_crc != J1850_CRC_RESIDUE)
+	{
+		++j1850_rx_crc_errors;
+		return J1850_RETURN_CODE_DATA_ERROR | 0x80;	// error, frame is corrupt
+	}
+#if J1850_HIGH_SPEED
+	j1850_speed = rx_speed;		// the bus is at the speed of the last good frame
+#endif
+	return rx_nbytes;
+}
+
+#if J1850_HIGH_SPEED
+/*
+**---------------------------------------------------------------------------
+** Abstract: Internal function, speed of a SOF and limits of the data symbols of its frame. The 1x
+**           short/long thresholds are the calibrated ones (j1850_cal.c), the 4x ones are fixed
+**           Funcio interna, velocitat d'un SOF i limits dels simbols de la seva trama
+** Parameters: SOF width in us2cntT0CON8 counts
+** Returns: 1 if it is a SOF of any speed, 0 otherwise
+**---------------------------------------------------------------------------
+*/
+static uint8_t rx_sof(uint8_t width)
+{
+	if(width >= RX_CAL_SOF_MIN && width < RX_SOF_MAX)
+	{
+		rx_speed = J1850_SPEED_1X;
+		rx_t.short_min = RX_SHORT_MIN;
+		rx_t.short_max = RX_CAL_SHORT_MAX;
+		rx_t.long_min = RX_CAL_LONG_MIN;
+		rx_t.long_max = RX_LONG_MAX;
+		j1850_rx_eod = RX_EOD_MIN;
+		return 1;
+	}
+	if(width >= RX4_SOF_MIN && width < RX4_SOF_MAX)
+	{
+		rx_speed = J1850_SPEED_4X;
+		rx_t.short_min = RX4_SHORT_MIN;
+		rx_t.short_max = RX4_SHORT_MAX;
+		rx_t.long_min = RX4_LONG_MIN;
+		rx_t.long_max = RX4_LONG_MAX;
+		j1850_rx_eod = RX4_EOD_MIN;
+		return 1;
+	}
+	return 0;
+}
+#else
+#define rx_sof(width)	((width) >= RX_CAL_SOF_MIN && (width) < RX_SOF_MAX)
+#endif
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Initialize the receiver, the next active edge will be taken as a SOF
+**           Inicialitza el receptor, el seguent flanc actiu es considerara un SOF
+** Parameters: Pointer to frame buffer (12 bytes) / punter al buffer de la trama
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+void j1850_rx_init(uint8_t *msg_buf)
+{
+	rx_buf = msg_buf;
+	rx_state = J1850_RX_IDLE;
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Change the buffer used for the next frames. Only call it between frames (after a frame or an
+**           error has been returned), the frame being received keeps its buffer until it finishes
+**           Canvia el buffer de les seguents trames
+** Parameters: Pointer to frame buffer (12 bytes) / punter al buffer de la trama
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+void j1850_rx_buffer(uint8_t *msg_buf)
+{
+	rx_buf = msg_buf;
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Process one bus edge. Has to be called on every change of the bus state, it only
+**           classifies the symbol that has just finished against the RX_* limits of j1850.h (the
+**           short/long and SOF thresholds are the RX_CAL_* ones, moved by j1850_cal.c), or the RX4_*
+**           ones if the SOF was a 4x one
+**           Processa un flanc del bus. Classifica el simbol que acaba de finalitzar
+** Parameters: bus_active: bus state after the edge (1=active)
+**             width: duration of the symbol that has just finished, in us2cntT0CON8 counts (255=longer)
+** Returns: J1850_RX_PENDING while the frame is not finished
+**          Number of received bytes OR in case of error, error code with bit 7 set as error indication
+**---------------------------------------------------------------------------
+*/
+uint8_t j1850_rx_edge(uint8_t bus_active, uint8_t width)
+{
+	switch(rx_state)
+	{
+	case J1850_RX_IDLE:
+		if(bus_active)	// bus goes active, it can be a SOF
+		{
+			rx_state = J1850_RX_SOF;
+		}
+		return J1850_RX_PENDING;
+
+	case J1850_RX_SOF:	// end of the active SOF symbol
+		if(!rx_sof(width))
+		{
+			rx_state = J1850_RX_IDLE;
+			++j1850_rx_sof_errors;
+			return J1850_RETURN_CODE_BUS_ERROR | 0x80;	// error, symbol was not SOF
+		}
+		RX_CAL_SOF(width);
+		rx_state = J1850_RX_DATA;
+		rx_ptr = rx_buf;
+		rx_nbytes = 0;
+		rx_nbits = 8;
+		rx_crc = 0xFF;
+		return J1850_RX_PENDING;
+
+	case J1850_RX_DATA:
+		if(width < RX_T_SHORT_MIN || (!bus_active && width >= j1850_rx_eod))
+		{
+			rx_state = J1850_RX_IDLE;
+			++j1850_rx_bit_errors;
+			return J1850_RETURN_CODE_BUS_ERROR | 0x80;	// error, pulse was to short or a break
+		}
+
+		rx_byte <<= 1;
+		if(bus_active)
+		{
+			// check for long passive pulse = "1" bit
+			if(width > RX_T_LONG_MIN && width < RX_T_LONG_MAX) rx_byte |= 1;
+			RX_CAL_COUNT(J1850_CAL_PASSIVE, width);
+		}
+		else
+		{
+			// check for short active pulse = "1" bit
+			if(width < RX_T_SHORT_MAX) rx_byte |= 1;
+			RX_CAL_COUNT(J1850_CAL_ACTIVE, width);
+		}
+
+		if(--rx_nbits) return J1850_RX_PENDING;
+
+		*rx_ptr++ = rx_byte;	// byte completed
+		rx_crc = j1850_crc_table[rx_crc ^ rx_byte];
+		rx_nbits = 8;
+		if(++rx_nbytes < 12) return J1850_RX_PENDING;
+
+		rx_state = J1850_RX_SKIP;	// maximum of 12 bytes, ignore the rest of the frame
+		return j1850_rx_check();
+
+	default:	// J1850_RX_SKIP
+		return J1850_RX_PENDING;
+	}
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Has to be called when no edge has been seen during j1850_rx_eod (RX_EOD_MIN of the speed
+**           of the frame) after the last one. A passive bus at this point is the EOD symbol, so the
+**           frame is finished.
+**           S'ha de cridar si no hi ha cap flanc durant j1850_rx_eod. Si el bus es passiu es un EOD.
+** Parameters: bus_active: current bus state (1=active)
+** Returns: J1850_RX_PENDING if no frame has been finished
+**          Number of received bytes OR in case of error, error code with bit 7 set as error indication
+**---------------------------------------------------------------------------
+*/
+uint8_t j1850_rx_timeout(uint8_t bus_active)
+{
+	if(bus_active) return J1850_RX_PENDING;	// long active symbol, it is classified on its edge
+
+	if(rx_state == J1850_RX_DATA)
+	{
+		rx_state = J1850_RX_IDLE;
+		return j1850_rx_check();	// EOD, return number of received bytes
+	}
+	rx_state = J1850_RX_IDLE;
+	return J1850_RX_PENDING;
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Number of bytes written on the buffer by the last frame, also when it has been rejected
+**           Numero de bytes escrits al buffer per l'ultima trama, tambe si ha estat rebutjada
+** Parameters: none
+** Returns: number of bytes
+**---------------------------------------------------------------------------
+*/
+uint8_t j1850_rx_len(void)
+{
+	return rx_nbytes;
+}
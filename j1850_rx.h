@@ -0,0 +1,59 @@
+/*************************************************************************
+**  HARLEY DAVIDSON Sportster 883/1200 - J1850 VPW Interface
+**  Released under GNU GENERAL PUBLIC LICENSE
+**  Main MCU: MICROCHIP PIC18F2553
+**  Homepage: www.momex.cat
+**  Contact: morales.xavier@momex.cat
+**
+**
+**  Revision History
+**  11/06/2016   XM  v1.00   Initial Release on Github
+**
+**
+**   NOTE: Edge driven J1850 VPW receiver. It does not touch any PIC register,
+**         the ISR glue in j1850.c (or a host program) feeds it with the width
+**         of every symbol, so it can also be compiled and tested on a PC.
+**         Receptor J1850 VPW per flancs. No accedeix a cap registre del PIC.
+**************************************************************************/
+
+#ifndef __J1850_RX_H__	//if J1850_rx.h has not been defined--> define it || if yes --> do nothing
+#define __J1850_RX_H__
+
+#include "macros.h"
+#include "j1850.h"
+
+// receiver states
+#define J1850_RX_IDLE	0	// waiting for the bus to go active (SOF)
+#define J1850_RX_SOF	1	// measuring the SOF active symbol
+#define J1850_RX_DATA	2	// receiving data bits, frame ends with EOD
+#define J1850_RX_SKIP	3	// 12 bytes already received, wait for the bus to go idle
+
+// returned while a frame is still in progress. It can not be confused with a number of bytes (0-12)
+// or with an error code (bit 7 set)
+#define J1850_RX_PENDING	0x40
+
+// error counters, only written by the receiver (and cleared by stats.c)
+extern volatile uint16_t j1850_rx_crc_errors;	// frames rejected because of a wrong CRC
+extern volatile uint16_t j1850_rx_sof_errors;	// BUS_ERROR, first active symbol was not a SOF
+extern volatile uint16_t j1850_rx_bit_errors;	// BUS_ERROR, symbol too short or break inside a frame
+extern volatile uint16_t j1850_rx_no_data;	// NO_DATA, frame finished without any complete byte
+
+#if J1850_HIGH_SPEED
+// speed of the last good frame (J1850_SPEED_xx), the transmitter sends at it. The main loop can also
+// write it, to switch before the first frame at the new speed is received
+extern volatile uint8_t j1850_speed;
+// RX_EOD_MIN of the speed of the frame being received, the preload of Timer0 in j1850_rx_isr()
+extern volatile uint8_t j1850_rx_eod;
+#else
+#define j1850_speed	J1850_SPEED_1X
+#define j1850_rx_eod	RX_EOD_MIN
+#endif
+
+//Function Prototypes
+extern void j1850_rx_init(uint8_t *msg_buf);
+extern void j1850_rx_buffer(uint8_t *msg_buf);
+extern uint8_t j1850_rx_edge(uint8_t bus_active, uint8_t width);
+extern uint8_t j1850_rx_timeout(uint8_t bus_active);
+extern uint8_t j1850_rx_len(void);
+
+#endif // __J1850_RX_H__
@@ -0,0 +1,547 @@
+/*************************************************************************
+**  HARLEY DAVIDSON Sportster 883/1200 - J1850 VPW Interface
+**  Released under GNU GENERAL PUBLIC LICENSE
+**  Main MCU: MICROCHIP PIC18F2553
+**  Homepage: www.momex.cat
+**  Contact: morales.xavier@momex.cat
+**
+**
+**  Revision History
+**  11/06/2016   XM  v1.00   Initial Release on Github
+**
+**
+**   NOTE: Timer3 (T3CK8, 1.6us counts) runs free and its overflow is the
+**         time of the next bus edge: each symbol reloads it relative to the
+**         last overflow, so the ISR latency does not add up along the frame.
+**         A slot belongs to the main loop while its status is not pending:
+**         it writes the frame and sets J1850_TX_PENDING last. The high
+**         priority ISR only sends pending slots and writes their final
+**         status, so no interrupt is disabled. CCP1 (PWM) and CCP2 (1ms
+**         tick) are in use, a compare unit is not left for the transmitter.
+**         With J1850_HIGH_SPEED the symbol times are copied to tx_t from
+**         j1850_timings when the IFS wait starts, at the speed of the bus.
+**         Els flancs de la trama es programen amb el desbordament del Timer3.
+**************************************************************************/
+
+#include "hal.h"
+#include "j1850.h"
+#include "j1850_rx.h"
+#include "j1850_tx.h"
+#include "bench.h"
+#include "macros.h"
+
+volatile uint16_t j1850_tx_sent;
+volatile uint16_t j1850_tx_lost;
+volatile uint16_t j1850_tx_failed;
+volatile uint16_t j1850_tx_latency_max;
+
+#if J1850_TX
+
+#if BENCH
+#error "Timer3 is the cycle counter of the benchmark build, set J1850_TX to 0 in j1850_tx.h (and DIAG to 0 in diag.h)"
+#endif
+
+// transmitter states
+#define J1850_TX_IDLE	0	// no pending frame, TMR3IE off
+#define J1850_TX_START	1	// frame queued by the main loop, the ISR takes it on the next Timer3 interrupt
+#define J1850_TX_WAIT	2	// waiting for TX_IFS of idle bus, restarted on every edge
+#define J1850_TX_DATA	3	// SOF and data symbols
+#define J1850_TX_EOF	4	// bus passive after the last symbol
+
+static j1850_tx_frame tx_slots[J1850_TX_SLOTS];
+static j1850_tx_frame *tx_cur;		// slot being sent
+static volatile uint8_t tx_state;
+static uint8_t tx_ticket;		// last ticket given
+
+static volatile uint32_t tx_latency_sum;	// latencies of the sent frames, average = tx_latency_sum / tx_latency_n
+static volatile uint16_t tx_latency_n;
+
+static uint8_t *tx_ptr;		// next byte to send
+static uint8_t tx_left;		// bytes still to send after tx_byte
+static uint8_t tx_byte;		// byte being sent, next bit on bit 7
+static uint8_t tx_nbits;	// bits of tx_byte still to send
+static uint8_t tx_active;	// the transmitter drives the bus active
+
+#if J1850_HIGH_SPEED
+// symbol times of the frame being sent, from j1850_timings[tx_speed]
+typedef struct {
+	uint8_t shrt;
+	uint8_t lng;
+	uint8_t sof;
+	uint8_t eof;
+	uint8_t ifs;
+} tx_timing;
+static tx_timing tx_t;
+static uint8_t tx_speed;	// speed of tx_t
+#define TX_T_SHORT	tx_t.shrt
+#define TX_T_LONG	tx_t.lng
+#define TX_T_SOF	tx_t.sof
+#define TX_T_EOF	tx_t.eof
+#define TX_T_IFS	tx_t.ifs
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Internal function, symbol times of the current speed of the bus (j1850_speed)
+**           Funcio interna, temps dels simbols de la velocitat actual del bus
+** Parameters: none
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+static void tx_timing_load(void)
+{
+	const rom j1850_timing *t;
+
+	tx_speed = j1850_speed;
+	t = &j1850_timings[tx_speed];
+	tx_t.shrt = t->tx_short;
+	tx_t.lng = t->tx_long;
+	tx_t.sof = t->tx_sof;
+	tx_t.eof = t->tx_eof;
+	tx_t.ifs = t->tx_ifs;
+}
+#else
+#define TX_T_SHORT	TX_SHORT
+#define TX_T_LONG	TX_LONG
+#define TX_T_SOF	TX_SOF
+#define TX_T_EOF	TX_EOF
+#define TX_T_IFS	TX_IFS
+#define tx_timing_load()
+#endif
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Empty the queue and start Timer3 with its interrupt on high priority (same as INT0, so
+**           the edges of the receiver and of the transmitter are never nested)
+**           Buida la cua i engega el Timer3 amb la interrupcio d'alta prioritat
+** Parameters: none
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+void j1850_tx_init(void)
+{
+	uint8_t i;
+
+	PIE2bits.TMR3IE = 0;
+	tx_state = J1850_TX_IDLE;
+	tx_ticket = 0;
+	tx_active = 0;
+	for(i = 0; i < J1850_TX_SLOTS; i++)
+	{
+		tx_slots[i].status = J1850_RETURN_CODE_UNKNOWN;
+		tx_slots[i].ticket = 0;
+	}
+	j1850_tx_stats_clear();
+	vpw_passive();
+	timer3_start(T3CK8);
+	IPR2bits.TMR3IP = 1;
+	PIR2bits.TMR3IF = 0;
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Main loop side. Copy a frame on the queue and return at once, the ISR sends it when the
+**           bus is free and there is no pending frame with a lower priority byte. The slot of the
+**           oldest finished frame is used again. The bytes are sent as they are, the caller adds
+**           the CRC (j1850_crc)
+**           Costat del bucle principal. Copia una trama a la cua i retorna sense esperar
+** Parameters: Pointer to frame buffer, frame length (1-12, CRC included)
+** Returns: ticket for j1850_tx_status() (never 0), 0 if the queue is full or the length is wrong
+**---------------------------------------------------------------------------
+*/
+uint8_t j1850_tx_queue(uint8_t *msg_buf, uint8_t nbytes)
+{
+	j1850_tx_frame *frame, *slot;
+	uint8_t i, age, oldest;
+
+	if(nbytes == 0 || nbytes > 12) return 0;	// see SAE J1850
+
+	frame = 0;
+	oldest = 0;
+	for(i = 0, slot = tx_slots; i < J1850_TX_SLOTS; i++, slot++)
+	{
+		if(slot->status == J1850_TX_PENDING) continue;
+		age = slot->ticket ? tx_ticket - slot->ticket : 0xFF;
+		if(!frame || age > oldest)
+		{
+			frame = slot;
+			oldest = age;
+		}
+	}
+	if(!frame) return 0;	// all the slots pending
+
+	for(i = 0; i < nbytes; i++)
+	{
+		frame->data[i] = msg_buf[i];
+	}
+	frame->len = nbytes;
+	frame->lost = 0;
+	frame->queued = timer1_get();
+	if(++tx_ticket == 0) tx_ticket = 1;
+	frame->ticket = tx_ticket;
+	frame->status = J1850_TX_PENDING;	// publish, the ISR can take it from now on
+
+	// if the ISR finishes a frame after this test it finds the new one itself
+	if(tx_state == J1850_TX_IDLE)
+	{
+		tx_state = J1850_TX_START;
+		PIR2bits.TMR3IF = 1;	// the interrupt starts at once
+		PIE2bits.TMR3IE = 1;
+	}
+	return tx_ticket;
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Main loop side. State of a queued frame
+**           Costat del bucle principal. Estat d'una trama de la cua
+** Parameters: ticket given by j1850_tx_queue()
+** Returns: J1850_TX_PENDING while it is queued or being sent (also between retries), then
+**          J1850_RETURN_CODE_OK or J1850_RETURN_CODE_BUS_ERROR (arbitration lost on every try).
+**          J1850_RETURN_CODE_UNKNOWN if the slot has already been used by a newer frame
+**---------------------------------------------------------------------------
+*/
+uint8_t j1850_tx_status(uint8_t ticket)
+{
+	uint8_t i;
+
+	for(i = 0; i < J1850_TX_SLOTS; i++)
+	{
+		if(ticket && tx_slots[i].ticket == ticket) return tx_slots[i].status;
+	}
+	return J1850_RETURN_CODE_UNKNOWN;
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Main loop side. There are frames on the queue or being sent
+**           Costat del bucle principal. Hi ha trames per enviar
+** Parameters: none
+** Returns: number of frames not finished yet
+**---------------------------------------------------------------------------
+*/
+uint8_t j1850_tx_busy(void)
+{
+	uint8_t i, n;
+
+	n = 0;
+	for(i = 0; i < J1850_TX_SLOTS; i++)
+	{
+		if(tx_slots[i].status == J1850_TX_PENDING) ++n;
+	}
+	return n;
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Main loop side. Latency of a sent frame, from j1850_tx_queue() to its EOD: the wait for
+**           the frames before it, the retries and the frame itself
+**           Costat del bucle principal. Latencia d'una trama enviada
+** Parameters: ticket given by j1850_tx_queue()
+** Returns: Timer1 counts (1.6us), 0 if it has not been sent
+**---------------------------------------------------------------------------
+*/
+uint16_t j1850_tx_latency(uint8_t ticket)
+{
+	uint8_t i;
+
+	for(i = 0; i < J1850_TX_SLOTS; i++)
+	{
+		if(ticket && tx_slots[i].ticket == ticket && tx_slots[i].status == J1850_RETURN_CODE_OK)
+		{
+			return tx_slots[i].latency;
+		}
+	}
+	return 0;
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Main loop side. Average latency of the sent frames / clear the counters
+**           Costat del bucle principal. Latencia mitjana de les trames enviades / posa a 0 els comptadors
+** Parameters: none
+** Returns: Timer1 counts (1.6us), 0 if no frame has been sent (j1850_tx_latency_avg)
+**---------------------------------------------------------------------------
+*/
+uint16_t j1850_tx_latency_avg(void)
+{
+	uint32_t sum;
+	uint16_t n;
+
+	do	// the ISR can add a frame in the middle
+	{
+		n = tx_latency_n;
+		sum = tx_latency_sum;
+	} while(n != tx_latency_n);
+	return n ? (uint16_t)(sum / n) : 0;
+}
+
+void j1850_tx_stats_clear(void)
+{
+	j1850_tx_sent = 0;
+	j1850_tx_lost = 0;
+	j1850_tx_failed = 0;
+	j1850_tx_latency_max = 0;
+	tx_latency_n = 0;
+	tx_latency_sum = 0;
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Take the pending frame with the lowest priority byte, the oldest one if there are
+**           several
+**           Agafa la trama pendent amb el byte de prioritat mes baix
+** Parameters: none
+** Returns: none, tx_cur is 0 if there is no pending frame
+**---------------------------------------------------------------------------
+*/
+static void tx_pick(void)
+{
+	j1850_tx_frame *slot;
+	uint8_t i;
+
+	tx_cur = 0;
+	for(i = 0, slot = tx_slots; i < J1850_TX_SLOTS; i++, slot++)
+	{
+		if(slot->status != J1850_TX_PENDING) continue;
+		if(!tx_cur || slot->data[0] < tx_cur->data[0] ||
+		   (slot->data[0] == tx_cur->data[0] && (int8_t)(slot->ticket - tx_cur->ticket) < 0))
+		{
+			tx_cur = slot;
+		}
+	}
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Wait for the bus to be idle before the next frame, or stop the Timer3 interrupt if
+**           there is no pending frame. The frame is chosen again at the end of the wait, a higher
+**           priority one can be queued meanwhile
+**           Espera el bus lliure abans de la seguent trama, o para si no n'hi ha cap
+** Parameters: none
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+static void tx_begin(void)
+{
+	tx_pick();
+	if(!tx_cur)
+	{
+		tx_state = J1850_TX_IDLE;
+		PIE2bits.TMR3IE = 0;
+		return;
+	}
+	tx_state = J1850_TX_WAIT;
+	tx_timing_load();
+	timer3_set(0 - TX_T_IFS);
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: End of the frame being sent. The bus is released and the frame finished, or left
+**           pending for a retry if it lost the arbitration less than J1850_TX_RETRIES times. The
+**           next frame (the same one or a higher priority one queued meanwhile) waits for the IFS
+**           after the frame that won
+**           Final de la trama. S'allibera el bus i s'acaba la trama o es torna a provar
+** Parameters: J1850_RETURN_CODE_OK or J1850_RETURN_CODE_BUS_ERROR (arbitration lost)
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+static void tx_done(uint8_t status)
+{
+	uint16_t latency;
+
+	vpw_passive();
+	tx_active = 0;
+	if(status == J1850_RETURN_CODE_OK)
+	{
+		latency = timer1_get() - tx_cur->queued - TX_T_EOF;	// EOD, the EOF is not waited by the caller
+		tx_cur->latency = latency;
+		if(latency > j1850_tx_latency_max) j1850_tx_latency_max = latency;
+		tx_latency_sum += latency;
+		++tx_latency_n;
+		if((tx_latency_sum & 0x80000000) || (tx_latency_n & 0x8000))	// keep the average, halving both
+		{
+			tx_latency_sum >>= 1;
+			tx_latency_n >>= 1;
+		}
+		++j1850_tx_sent;
+		tx_cur->status = J1850_RETURN_CODE_OK;
+	}
+	else
+	{
+		++j1850_tx_lost;
+		if(++tx_cur->lost > J1850_TX_RETRIES)
+		{
+			++j1850_tx_failed;
+			tx_cur->status = J1850_RETURN_CODE_BUS_ERROR;
+		}
+	}
+	tx_begin();
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Transmitter part of the high priority ISR, one symbol edge on each Timer3 overflow.
+**           Passive symbols: "1" long, "0" short. Active symbols: "1" short, "0" long. The frame
+**           always starts with a passive symbol after the SOF, and a node that is passive while
+**           the bus is active has lost the arbitration
+**           Part de la ISR d'alta prioritat. Un flanc de la trama a cada desbordament del Timer3.
+** Parameters: none
+** Returns: 1 if the interrupt was a Timer3 overflow, 0 otherwise
+**---------------------------------------------------------------------------
+*/
+uint8_t j1850_tx_isr(void)
+{
+	uint16_t delay;		// symbol time in T3CK8 counts
+
+	if(!PIE2bits.TMR3IE || !PIR2bits.TMR3IF) return 0;
+	PIR2bits.TMR3IF = 0;
+
+	if(tx_state == J1850_TX_START)
+	{
+		tx_begin();
+		return 1;
+	}
+	if(tx_state == J1850_TX_WAIT)
+	{
+		if(is_vpw_active())	// no edge for TX_IFS but the bus is still active (break), wait more
+		{
+			timer3_set(0 - TX_T_IFS);
+			return 1;
+		}
+#if J1850_HIGH_SPEED
+		if(tx_speed != j1850_speed)	// the bus has changed its speed during the wait, the IFS of the new one
+		{
+			tx_timing_load();
+			timer3_set(0 - TX_T_IFS);
+			return 1;
+		}
+#endif
+		tx_pick();		// pending frames can only have been added
+		tx_ptr = tx_cur->data;
+		tx_left = tx_cur->len;
+		tx_nbits = 0;
+		vpw_active();		// SOF
+		tx_active = 1;
+		tx_state = J1850_TX_DATA;
+		timer3_set(timer3_get() - TX_T_SOF);
+		return 1;
+	}
+	if(tx_state == J1850_TX_EOF)
+	{
+		tx_done(J1850_RETURN_CODE_OK);
+		return 1;
+	}
+	if(tx_state != J1850_TX_DATA) return 1;
+
+	if(tx_nbits == 0)
+	{
+		if(tx_left == 0)	// last active symbol finished, EOD + EOF
+		{
+			vpw_passive();
+			tx_active = 0;
+			tx_state = J1850_TX_EOF;
+			timer3_set(timer3_get() - TX_T_EOF);
+			return 1;
+		}
+		tx_byte = *tx_ptr++;
+		--tx_left;
+		tx_nbits = 8;
+	}
+
+	if(tx_active)	// passive symbol
+	{
+		vpw_passive();
+		tx_active = 0;
+		if(is_vpw_active())	// another node keeps the bus active
+		{
+			tx_done(J1850_RETURN_CODE_BUS_ERROR);
+			return 1;
+		}
+		delay = (tx_byte & 0x80) ? TX_T_LONG : TX_T_SHORT;
+	}
+	else		// active symbol, ACTIVE dominates
+	{
+		if(is_vpw_active())	// the bus went active before the end of our passive symbol
+		{
+			tx_done(J1850_RETURN_CODE_BUS_ERROR);
+			return 1;
+		}
+		vpw_active();
+		tx_active = 1;
+		delay = (tx_byte & 0x80) ? TX_T_SHORT : TX_T_LONG;
+	}
+	tx_byte <<= 1;
+	--tx_nbits;
+	timer3_set(timer3_get() - delay);	// overflow delay counts after the last one
+	return 1;
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Bus edge seen by the receiver (j1850_rx_isr). It restarts the IFS wait, and during the
+**           frame an active edge while the transmitter is passive means that the arbitration is
+**           lost: the frame is finished with J1850_RETURN_CODE_BUS_ERROR
+**           Flanc del bus vist pel receptor. Reinicia l'espera o detecta l'arbitratge perdut
+** Parameters: bus state after the edge
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+void j1850_tx_edge(uint8_t bus_active)
+{
+	if(tx_state == J1850_TX_WAIT)
+	{
+		timer3_set(0 - TX_T_IFS);
+	}
+	else if(tx_state == J1850_TX_DATA && bus_active && !tx_active)
+	{
+		tx_done(J1850_RETURN_CODE_BUS_ERROR);
+	}
+}
+#else
+void j1850_tx_init(void)
+{
+}
+
+uint8_t j1850_tx_queue(uint8_t *msg_buf, uint8_t nbytes)
+{
+	return 0;
+}
+
+uint8_t j1850_tx_status(uint8_t ticket)
+{
+	return J1850_RETURN_CODE_UNKNOWN;
+}
+
+uint8_t j1850_tx_busy(void)
+{
+	return 0;
+}
+
+uint16_t j1850_tx_latency(uint8_t ticket)
+{
+	return 0;
+}
+
+uint16_t j1850_tx_latency_avg(void)
+{
+	return 0;
+}
+
+void j1850_tx_stats_clear(void)
+{
+	j1850_tx_sent = 0;
+	j1850_tx_lost = 0;
+	j1850_tx_failed = 0;
+	j1850_tx_latency_max = 0;
+}
+
+uint8_t j1850_tx_isr(void)
+{
+	return 0;
+}
+
+void j1850_tx_edge(uint8_t bus_active)
+{
+}
+#endif // J1850_TX
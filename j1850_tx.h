@@ -0,0 +1,71 @@
+/*************************************************************************
+**  HARLEY DAVIDSON Sportster 883/1200 - J1850 VPW Interface
+**  Released under GNU GENERAL PUBLIC LICENSE
+**  Main MCU: MICROCHIP PIC18F2553
+**  Homepage: www.momex.cat
+**  Contact: morales.xavier@momex.cat
+**
+**
+**  Revision History
+**  11/06/2016   XM  v1.00   Initial Release on Github
+**
+**
+**   NOTE: Interrupt driven J1850 VPW transmitter. The main loop puts the
+**         frames on a queue and goes on, the Timer3 overflow (high
+**         priority ISR) drives every symbol edge: IFS wait, SOF, data bits
+**         and EOF. The INT0 edges of the receiver tell the transmitter when
+**         the bus is taken by another node (arbitration lost). The queue
+**         is sent in the order of the priority byte (first header byte, the
+**         lower wins the arbitration on the bus too), and a frame that
+**         loses the arbitration is sent again after the IFS of the winner,
+**         up to J1850_TX_RETRIES times.
+**         Emissor J1850 VPW per interrupcions, temporitzat amb el Timer3.
+**************************************************************************/
+
+#ifndef __J1850_TX_H__	//if j1850_tx.h has not been defined--> define it || if yes --> do nothing
+#define __J1850_TX_H__
+
+#include "macros.h"
+
+// 1: transmitter on Timer3 (this module). 0: no transmitter, j1850_send_msg() waits on Timer0 as before.
+// Timer3 is also the cycle counter of the benchmark build, both can not be used at the same time.
+// 0 on the tacho board, it has no pin to drive the bus (see vpw_active() in hal_pic18.h)
+#ifndef J1850_TX	// or -DJ1850_TX=1 on a board with a bus driver
+#define J1850_TX	0
+#endif
+
+#define J1850_TX_SLOTS	4	// frames on the queue
+#define J1850_TX_RETRIES	8	// times a frame is sent again after losing the arbitration
+
+// returned by j1850_tx_status() while the frame is on the queue or being sent,
+// then J1850_RETURN_CODE_OK or J1850_RETURN_CODE_BUS_ERROR (arbitration lost J1850_TX_RETRIES + 1 times)
+#define J1850_TX_PENDING	0x40
+
+typedef struct {
+	uint8_t len;		// number of bytes to send, CRC included
+	volatile uint8_t status;	// J1850_TX_PENDING, then J1850_RETURN_CODE_xxx. Slot free if not pending
+	uint8_t ticket;		// number given by j1850_tx_queue(), never 0 (0 = slot never used)
+	uint8_t lost;		// arbitrations lost
+	uint16_t queued;	// Timer1 (T1CK8, 1.6us counts) when it was queued
+	uint16_t latency;	// Timer1 counts from j1850_tx_queue() to the end of the frame (EOD)
+	uint8_t data[12];	// J1850 message buffer
+} j1850_tx_frame;
+
+// counters, only written by the transmitter (and cleared by stats.c)
+extern volatile uint16_t j1850_tx_sent;		// frames sent
+extern volatile uint16_t j1850_tx_lost;		// arbitrations lost, each one is a retry or a failed frame
+extern volatile uint16_t j1850_tx_failed;	// frames given up after J1850_TX_RETRIES
+extern volatile uint16_t j1850_tx_latency_max;	// longest latency of a sent frame, Timer1 counts
+
+//Function Prototypes
+extern void j1850_tx_init(void);
+extern uint8_t j1850_tx_queue(uint8_t *msg_buf, uint8_t nbytes);
+extern uint8_t j1850_tx_status(uint8_t ticket);
+extern uint8_t j1850_tx_busy(void);
+extern uint16_t j1850_tx_latency(uint8_t ticket);
+extern uint16_t j1850_tx_latency_avg(void);
+extern void j1850_tx_stats_clear(void);
+extern uint8_t j1850_tx_isr(void);
+extern void j1850_tx_edge(uint8_t bus_active);
+
+#endif // __J1850_TX_H__
@@ -42,11 +42,7 @@ CK256		= 0b11000111,
 CK16B128	= 0b10000110
 };
 
-/* Define Timer0*/
-#define timer0_start(x)	T0CON=x;TMR0L=0;  // Timer0 enabled with a preescaler x
-#define timer0_16start(x)	T0CON=x;WriteTimer0(0);  // Timer0 16bit enabled with a preescaler x
-#define timer0_get()	TMR0L
-#define timer0_stop()	T0CON=STOP;
+/* Timer0 macros (timer0_start...) are on the HAL, hal_pic18.h and host/hal_host.h */
 #define INT_CLK	20000000L/4L
 
 
@@ -65,9 +61,17 @@ CK16B128	= 0b10000110
 //((unsigned char) (((us) * ((unsigned long)(INT_CLK) / 8L) + 500000L) / 1000000L))
 #define us2cntT3CON8(us) ((unsigned char) (((us) * ((unsigned long)(INT_CLK) / 8L) + 500000L) / 1000000L))
 
+#if defined(__18CXX)	// MPLAB C18
 typedef signed char int8_t;
 typedef unsigned char uint8_t;
+typedef signed short int16_t;
 typedef unsigned short uint16_t;
+typedef unsigned long uint32_t;
+#else			// PC build of the portable modules (host/), there is no rom/ram address space
+#include <stdint.h>
+#define rom
+#define far
+#endif
 
 //TIMER3 - enumeration of the preescalers (16 bit counter 0-65535), internal clock = F_CPU/4
 //REGISTER T0CON (TIMER 0)
@@ -83,11 +87,6 @@ T3CK8	= 0b10110001,
 T3CK1	= 0b10000001
 };
 
-/* Define Timer3*/
-#define timer3_start(x)	T3CON=x;WriteTimer3(0);  // Timer3 16bit enabled with a preescaler x
-#define timer3_get()	ReadTimer3()
-#define timer3_stop()	T3CON=T3STOP;
-
 //TIMER1 - enumeration of the preescalers (16 bit counter 0-65535)(8 bit counter 0-255), internal clock = F_CPU/4
 //bit7 (RD16)--> 1=Enables timer3 in one 16bit operation / 0= Enables timer3 in two 8bit operation
 //bit 6(T1RUN): Timer1 system clock status bit --> fixed to 0
@@ -102,11 +101,6 @@ T1STOP	= 0b00000000,
 T1CK8	= 0b10110001
 };
 
-/* Define Timer1*/
-#define timer1_start(x)	T1CON=x;WriteTimer1(0);  // Timer3 16bit enabled with a preescaler x
-#define timer1_get()	ReadTimer1()
-#define timer1_stop()	T1CON=T1STOP;
-
 #endif //MACROS_H
 
 
@@ -0,0 +1,173 @@
+/*************************************************************************
+**  HARLEY DAVIDSON Sportster 883/1200 - J1850 VPW Interface
+**  Released under GNU GENERAL PUBLIC LICENSE
+**  Main MCU: MICROCHIP PIC18F2553
+**  Homepage: www.momex.cat
+**  Contact: morales.xavier@momex.cat
+**
+**
+**  Revision History
+**  11/06/2016   XM  v1.00   Initial Release on Github
+**
+**
+**   NOTE: sched_ms is only written by the low priority ISR. It is 16 bit, so
+**         the main loop reads it with sched_now() (read again if the ISR has
+**         changed it in the middle). The tasks are fixed rate: the next run
+**         is one period after the previous one, not after the end of it.
+**         sched_wraps belongs to the high priority ISR, an overflow that
+**         comes while it runs is added by sched_timestamp() itself.
+**************************************************************************/
+
+#include "hal.h"
+#include "sched.h"
+#include "macros.h"
+
+static volatile uint16_t sched_ms;	// ms since sched_init()
+static uint16_t tick_next;		// Timer1 value of the next tick (CCPR2)
+volatile uint16_t sched_wraps;
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Start the 1ms tick: CCP2 compare with Timer1, CCP2IF on low priority, and the count of
+**           the Timer1 overflows, TMR1IF on high priority. Timer1 has to be running with T1CK8 and
+**           it must not be written after this (it is never reset by CCP2)
+**           Engega el tic de 1ms amb el comparador CCP2 i el Timer1
+** Parameters: none
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+void sched_init(void)
+{
+	PIE2bits.CCP2IE = 0;
+	sched_ms = 0;
+	tick_next = timer1_get() + SCHED_TICK;
+	ccp2_compare_set(tick_next);
+	ccp2_compare_start();
+	PIR2bits.CCP2IF = 0;
+	IPR2bits.CCP2IP = 0;	// tick on low priority
+	PIE2bits.CCP2IE = 1;
+
+	PIE1bits.TMR1IE = 0;
+	sched_wraps = 0;
+	PIR1bits.TMR1IF = 0;
+	IPR1bits.TMR1IP = 1;	// same ISR as the timestamps, so sched_wraps needs no protection
+	PIE1bits.TMR1IE = 1;
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Current tick, safe to call from the main loop
+**           Valor actual del tic
+** Parameters: none
+** Returns: ms since sched_init() (16 bit, wraps after 65.5s, compare with differences)
+**---------------------------------------------------------------------------
+*/
+uint16_t sched_now(void)
+{
+	uint16_t now;
+
+	do
+	{
+		now = sched_ms;
+	} while(now != sched_ms);
+	return now;
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Clear the statistics of the tasks and set their first run one period from now
+**           Inicialitza les tasques, la primera execucio es d'aqui un periode
+** Parameters: task table, number of tasks
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+void sched_start(sched_task *tasks, uint8_t ntasks)
+{
+	uint16_t now = sched_now();
+
+	while(ntasks--)
+	{
+		tasks->next = now + tasks->period;
+		tasks->runs = 0;
+		tasks->late = 0;
+		tasks->time_last = 0;
+		tasks->time_max = 0;
+		tasks->time_sum = 0;
+		++tasks;
+	}
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Run once each task whose time has come, in table order, and measure it with Timer1.
+**           If the main loop has missed whole periods they are not run again (counted on 'late')
+**           Executa les tasques que toquen i mesura el seu temps d'execucio
+** Parameters: task table, number of tasks
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+void sched_run(sched_task *tasks, uint8_t ntasks)
+{
+	uint16_t now, start, time;
+
+	while(ntasks--)
+	{
+		now = sched_now();
+		if((int16_t)(now - tasks->next) >= 0)
+		{
+			tasks->next += tasks->period;
+			if((int16_t)(now - tasks->next) >= 0)	// more than one period late
+			{
+				++tasks->late;
+				tasks->next = now + tasks->period;
+			}
+			start = timer1_get();
+			tasks->run();
+			time = timer1_get() - start;
+			tasks->time_last = time;
+			if(time > tasks->time_max) tasks->time_max = time;
+			tasks->time_sum += time;
+			++tasks->runs;
+		}
+		++tasks;
+	}
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Tick part of the low priority ISR, next compare value one tick after the previous one
+**           Part de la ISR de baixa prioritat, tic de 1ms
+** Parameters: none
+** Returns: 1 if it was a tick (the ISR can run its 1ms work), 0 if not
+**---------------------------------------------------------------------------
+*/
+uint8_t sched_tick_isr(void)
+{
+	if(!PIE2bits.CCP2IE || !PIR2bits.CCP2IF) return 0;
+
+	PIR2bits.CCP2IF = 0;
+	tick_next += SCHED_TICK;
+	ccp2_compare_set(tick_next);
+	++sched_ms;
+	return 1;
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: High priority ISR side. 32 bit timestamp: Timer1 and its overflows. An overflow after
+**           the SCHED_WRAP_ISR() of this ISR is still pending on TMR1IF, it is added here if
+**           Timer1 has been read after it (low half)
+**           Costat de la ISR d'alta prioritat. Marca de temps de 32 bits
+** Parameters: none
+** Returns: Timer1 counts (1.6us) since Timer1 was started, wraps after 1.9 hours
+**---------------------------------------------------------------------------
+*/
+uint32_t sched_timestamp(void)
+{
+	uint16_t t, wraps;
+
+	t = timer1_get();
+	wraps = sched_wraps;
+	if(PIR1bits.TMR1IF && t < 0x8000) ++wraps;
+	return ((uint32_t)wraps << 16) | t;
+}
@@ -0,0 +1,58 @@
+/*************************************************************************
+**  HARLEY DAVIDSON Sportster 883/1200 - J1850 VPW Interface
+**  Released under GNU GENERAL PUBLIC LICENSE
+**  Main MCU: MICROCHIP PIC18F2553
+**  Homepage: www.momex.cat
+**  Contact: morales.xavier@momex.cat
+**
+**
+**  Revision History
+**  11/06/2016   XM  v1.00   Initial Release on Github
+**
+**
+**   NOTE: 1ms tick and run to completion scheduler of the main loop.
+**         The tick is CCP2 on compare mode with the free running Timer1
+**         (T1CK8), so the frame timestamps are not disturbed. Each task is
+**         a function without arguments that returns when its work is done,
+**         it is called every 'period' ms from sched_run().
+**         The Timer1 overflows are counted by the high priority ISR
+**         (SCHED_WRAP_ISR), the timestamps of the frames have 32 bits.
+**         Tic de 1ms i planificador de tasques del bucle principal.
+**************************************************************************/
+
+#ifndef __SCHED_H__	//if sched.h has not been defined--> define it || if yes --> do nothing
+#define __SCHED_H__
+
+#include "macros.h"
+
+#define SCHED_TICK	625	// Timer1 counts (T1CK8, 1.6us) of 1ms
+
+// Timer1 overflows (every 104.8ms), only written and read by the high priority ISR
+extern volatile uint16_t sched_wraps;
+
+// Timer1 overflow part of the high priority ISR. A macro, it runs on every bus edge
+#define SCHED_WRAP_ISR()	if(PIE1bits.TMR1IE && PIR1bits.TMR1IF){PIR1bits.TMR1IF=0; ++sched_wraps;}
+
+typedef struct {
+	void (*run)(void);	// task
+	uint16_t period;	// ms between two runs
+	uint16_t next;		// sched_now() of the next run
+	uint32_t runs;		// times it has run
+	uint16_t late;		// runs skipped because the main loop came too late
+	uint16_t time_last;	// execution time of the last run, Timer1 counts (1.6us)
+	uint16_t time_max;	// longest execution time
+	uint32_t time_sum;	// sum of the execution times, average = time_sum / runs
+} sched_task;
+
+// sched_task table entry, the rest of the fields are set by sched_start()
+#define SCHED_TASK(func, period_ms)	{func, period_ms, 0, 0, 0, 0, 0, 0}
+
+//Function Prototypes
+extern void sched_init(void);
+extern uint16_t sched_now(void);
+extern void sched_start(sched_task *tasks, uint8_t ntasks);
+extern void sched_run(sched_task *tasks, uint8_t ntasks);
+extern uint8_t sched_tick_isr(void);
+extern uint32_t sched_timestamp(void);
+
+#endif // __SCHED_H__
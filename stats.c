@@ -0,0 +1,220 @@
+/*************************************************************************
+**  HARLEY DAVIDSON Sportster 883/1200 - J1850 VPW Interface
+**  Released under GNU GENERAL PUBLIC LICENSE
+**  Main MCU: MICROCHIP PIC18F2553
+**  Homepage: www.momex.cat
+**  Contact: morales.xavier@momex.cat
+**
+**
+**  Revision History
+**  11/06/2016   XM  v1.00   Initial Release on Github
+**
+**
+**   NOTE: The 16 bit counters of the ISRs can change while the main loop
+**         reads them, they are read until two reads match. A reset from
+**         the main loop can lose an event counted at the same time, it
+**         does not matter for statistics.
+**************************************************************************/
+
+#include "hal.h"
+#include "j1850.h"
+#include "j1850_rx.h"
+#include "j1850_tx.h"
+#include "j1850_ring.h"
+#include "usart_tx.h"
+#include "usart_rx.h"
+#include "stats.h"
+#include "macros.h"
+
+typedef struct {
+	uint8_t header[3];	// priority, target, source
+	uint16_t frames;	// frames received with this header
+} stats_header;
+
+static stats_header stats_headers[STATS_HEADERS];
+static uint8_t stats_nheaders;		// rows used on stats_headers, in order of arrival
+static uint16_t stats_other;		// frames whose header did not fit on stats_headers
+static uint16_t loop_last;		// Timer1 at the last stats_loop()
+static uint8_t loop_started;		// loop_last is valid
+static uint16_t loop_min, loop_max;	// main loop period, Timer1 counts
+static uint32_t loop_sum, loop_n;	// sum and number of periods, average = loop_sum / loop_n
+static uint8_t stats_pending;		// STATS_CMD_SEND received, record not sent yet
+static uint8_t stats_record[STATS_RECORD_LEN];	// kept until usart_tx_busy() returns 0
+
+volatile uint16_t stats_isr_high_max;
+volatile uint16_t stats_isr_low_max;
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Clear all the counters, also the ones kept by the other modules
+**           Posa a 0 tots els comptadors
+** Parameters: none
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+void stats_init(void)
+{
+	stats_nheaders = 0;
+	stats_other = 0;
+	loop_started = 0;
+	loop_min = 0xFFFF;
+	loop_max = 0;
+	loop_sum = 0;
+	loop_n = 0;
+	stats_pending = 0;
+	stats_isr_high_max = 0;
+	stats_isr_low_max = 0;
+	j1850_rx_crc_errors = 0;
+	j1850_rx_sof_errors = 0;
+	j1850_rx_bit_errors = 0;
+	j1850_rx_no_data = 0;
+	j1850_ring_overflows = 0;
+	usart_tx_dropped = 0;
+	j1850_tx_stats_clear();
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Count a good frame on the row of its header. A new header takes a free row, when
+**           there is none it is counted with the other headers
+**           Compta una trama bona a la fila de la seva capcalera
+** Parameters: Pointer to frame buffer, frame length
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+void stats_frame(uint8_t *msg, uint8_t nbytes)
+{
+	stats_header *row;
+	uint8_t i;
+
+	if(nbytes >= 3)
+	{
+		for(i = 0, row = stats_headers; i < stats_nheaders; i++, row++)
+		{
+			if(row->header[0] == msg[0] && row->header[1] == msg[1] && row->header[2] == msg[2])
+			{
+				++row->frames;
+				return;
+			}
+		}
+		if(stats_nheaders < STATS_HEADERS)
+		{
+			row->header[0] = msg[0];
+			row->header[1] = msg[1];
+			row->header[2] = msg[2];
+			row->frames = 1;
+			++stats_nheaders;
+			return;
+		}
+	}
+	++stats_other;
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Has to be called once on every pass of the main loop, measures its period
+**           S'ha de cridar a cada passada del bucle principal, en mesura el periode
+** Parameters: none
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+void stats_loop(void)
+{
+	uint16_t now, period;
+
+	now = timer1_get();
+	if(loop_started)
+	{
+		period = now - loop_last;
+		if(period < loop_min) loop_min = period;
+		if(period > loop_max) loop_max = period;
+		loop_sum += period;
+		++loop_n;
+		if(loop_sum & 0x80000000)	// keep the average, halving both
+		{
+			loop_sum >>= 1;
+			loop_n >>= 1;
+		}
+	}
+	loop_started = 1;
+	loop_last = now;
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Internal functions, read a counter written by an ISR / write a 16 bit value on the
+**           record, low byte first
+**           Funcions internes, llegeix un comptador d'una ISR / escriu un valor de 16 bits
+** Parameters: counter / position on the record, value
+** Returns: value of the counter (stats_get)
+**---------------------------------------------------------------------------
+*/
+static uint16_t stats_get(volatile uint16_t *counter)
+{
+	uint16_t value;
+
+	do
+	{
+		value = *counter;
+	} while(value != *counter);
+	return value;
+}
+
+static void stats_put(uint8_t *rec, uint16_t value)
+{
+	rec[0] = (uint8_t)value;
+	rec[1] = (uint8_t)(value >> 8);
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Task of the main loop. Reads the commands of the PC (STATS_CMD_xxx, any other byte is
+**           ignored) and sends the USART_LOG_STATS record when it has been asked for
+**           Tasca del bucle principal. Llegeix les comandes del PC i envia les estadistiques
+** Parameters: none
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+void stats_task(void)
+{
+	uint8_t cmd, i;
+	uint8_t *rec;
+
+	while((cmd = usart_rx_get()) != 0)
+	{
+		if(cmd == STATS_CMD_SEND) stats_pending = 1;
+		else if(cmd == STATS_CMD_RESET) stats_init();
+	}
+	if(!stats_pending || usart_tx_busy()) return;	// stats_record is still being sent
+	stats_pending = 0;
+
+	rec = stats_record;
+	rec[0] = USART_LOG_STATS;
+	rec[1] = stats_nheaders;
+	stats_put(rec + 2, stats_other);
+	stats_put(rec + 4, stats_get(&j1850_rx_crc_errors));
+	stats_put(rec + 6, stats_get(&j1850_rx_sof_errors));
+	stats_put(rec + 8, stats_get(&j1850_rx_bit_errors));
+	stats_put(rec + 10, stats_get(&j1850_rx_no_data));
+	rec[12] = j1850_ring_overflows;
+	rec[13] = usart_tx_dropped;
+	stats_put(rec + 14, stats_get(&stats_isr_high_max));
+	stats_put(rec + 16, stats_get(&stats_isr_low_max));
+	stats_put(rec + 18, loop_n ? loop_min : 0);
+	stats_put(rec + 20, loop_n ? (uint16_t)(loop_sum / loop_n) : 0);
+	stats_put(rec + 22, loop_max);
+	stats_put(rec + 24, stats_get(&j1850_tx_sent));
+	stats_put(rec + 26, stats_get(&j1850_tx_lost));
+	stats_put(rec + 28, stats_get(&j1850_tx_failed));
+	stats_put(rec + 30, j1850_tx_latency_avg());
+	stats_put(rec + 32, stats_get(&j1850_tx_latency_max));
+	rec += STATS_RECORD_HEADER;
+	for(i = 0; i < stats_nheaders; i++, rec += 5)
+	{
+		rec[0] = stats_headers[i].header[0];
+		rec[1] = stats_headers[i].header[1];
+		rec[2] = stats_headers[i].header[2];
+		stats_put(rec + 3, stats_headers[i].frames);
+	}
+	usart_tx_send(stats_record, STATS_RECORD_HEADER + 5 * stats_nheaders);
+}
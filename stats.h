@@ -0,0 +1,64 @@
+/*************************************************************************
+**  HARLEY DAVIDSON Sportster 883/1200 - J1850 VPW Interface
+**  Released under GNU GENERAL PUBLIC LICENSE
+**  Main MCU: MICROCHIP PIC18F2553
+**  Homepage: www.momex.cat
+**  Contact: morales.xavier@momex.cat
+**
+**
+**  Revision History
+**  11/06/2016   XM  v1.00   Initial Release on Github
+**
+**
+**   NOTE: Bus and decoder statistics. The counters are kept by the modules
+**         that see the events (j1850_rx.c, j1850_tx.c, j1850_ring.c,
+**         usart_tx.c, the ISRs of main.c), this module counts the frames per header and
+**         the main loop period, and sends all of them to the PC when it
+**         asks for them with a command on the USART.
+**         Estadistiques del bus i del descodificador.
+**************************************************************************/
+
+#ifndef __STATS_H__	//if stats.h has not been defined--> define it || if yes --> do nothing
+#define __STATS_H__
+
+#include "macros.h"
+
+#define STATS_HEADERS	8	// different headers counted, the rest are counted together
+#define STATS_MS	10	// the commands of the PC are read every STATS_MS
+
+// commands of the PC (one byte on the USART)
+#define STATS_CMD_SEND	'S'	// send a USART_LOG_STATS record
+#define STATS_CMD_RESET	'R'	// clear all the counters
+
+// USART_LOG_STATS record (usart_tx.h), 16 bit values low byte first:
+//   byte 0: record type (USART_LOG_STATS)
+//   byte 1: number of headers counted (0-STATS_HEADERS)
+//   byte 2-3: frames with other headers
+//   byte 4-5: frames with a wrong CRC
+//   byte 6-7: BUS_ERROR on the SOF (not a SOF)
+//   byte 8-9: BUS_ERROR on the bits (symbol too short or break)
+//   byte 10-11: NO_DATA (SOF and EOD without any byte)
+//   byte 12: frames lost, ring of the main loop full (j1850_ring_overflows)
+//   byte 13: frames and records lost, USART TX ring full (usart_tx_dropped)
+//   byte 14-15: longest high priority ISR, Timer1 counts (1.6us)
+//   byte 16-17: longest low priority ISR, Timer1 counts
+//   byte 18-23: main loop period min, average and max, Timer1 counts
+//   byte 24-25: our frames sent (j1850_tx.c)
+//   byte 26-27: arbitrations lost by our frames
+//   byte 28-29: our frames given up after J1850_TX_RETRIES
+//   byte 30-33: latency of our frames average and max, Timer1 counts
+//   byte 34-: 5 bytes per header: priority, target, source and frames received
+#define STATS_RECORD_HEADER	34
+#define STATS_RECORD_LEN	(STATS_RECORD_HEADER + 5 * STATS_HEADERS)
+
+// longest ISRs, written by main.c
+extern volatile uint16_t stats_isr_high_max;
+extern volatile uint16_t stats_isr_low_max;
+
+//Function Prototypes
+extern void stats_init(void);
+extern void stats_frame(uint8_t *msg, uint8_t nbytes);
+extern void stats_loop(void);
+extern void stats_task(void);
+
+#endif // __STATS_H__
@@ -0,0 +1,744 @@
+/*************************************************************************
+**  HARLEY DAVIDSON Sportster 883/1200 - J1850 VPW Interface
+**  License: Creative Commons CC BY-SA 3.0
+**  Main MCU: MICROCHIP PIC18F2553
+**  Homepage: www.momex.cat
+**  Contact: morales.xavier@momex.cat
+**
+**
+**  Revision History
+**  11/06/2016   XM  v1.00   Initial Release on Github
+**
+**
+**  Abstract: Decode and display part of the tacho, the main loop of main.c.
+**            It only uses the hardware through hal.h, so the same code runs
+**            on the PIC and on the PC simulation (host/tacho_sim.c)
+**            Descodificacio i visualitzacio, el bucle principal de main.c
+**************************************************************************/
+
+/*INCLUDE CUSTOM HEADERS*/
+#include "hal.h"
+#include "macros.h"
+#include "j1850_ring.h"
+#include "j1850_cal.h"
+#include "stats.h"
+#include "bench.h"
+#include "filter.h"
+#include "fuel.h"
+#include "diag.h"
+#include "block.h"
+#include "MM5450.h"
+#include "bcd.h"
+#include "sched.h"
+#include "button.h"
+#include "tacho.h"
+
+//gear display, on ROM
+const rom char display7seg[18] = {0b01000001,0b11111001,0b00100011,0b00110001,0b10011001,0b00010101,0b00000101,0b01111001,0b00000001,0b00011001,0b11111111,0b01111111,0b11111011,0b11111101,0b11110111,0b11101111,0b11011111,0b10111111};   
+// 0           1          2           3         4         5          6        7           8          9          10:OFF      11:a      12:b       13:c       14:d        15:e    16:f 17:- g
+
+//decoded values, written by the frame handlers and shown by tacho_refresh()
+static int mode;			//mode indicator. 0:rpm 7seg, 1:speed + rpm bar, 2: Temp + rpm bar, 3: fuel consumption 7seg
+static unsigned int rpm[2];		//array for rpm. rpm[0]=for the display    rpm[1]=current rpm (filtered)
+static unsigned int speed[2];		//array for speed. speed[0]=for the display    speed[1]=current speed (filtered)
+static char engon;			//flag to know if engine is ON
+static unsigned int temp[2];		//array for temp. temp[0]=for the display    temp[1]=current temp (filtered)
+static uint8_t load;			//engine load %, answer of the ECM to PID 0x04 (diag.c)
+static uint8_t iat;			//intake air temperature + 40, answer of the ECM to PID 0x0F (diag.c)
+static uint8_t recv_nbytes;		//info from reception of message
+
+//filters of the decoded values (TACHO_xxx_EMA, _BAND and _CONFIRM on tacho.h)
+static filter_median rpm_median;	//a single wrong rpm frame is removed
+static filter_ema rpm_ema;
+static filter_hyst rpm_hyst;		//rpm[0]
+static filter_confirm engon_confirm;	//engon
+static filter_ema speed_ema;
+static filter_hyst speed_hyst;		//speed[0]
+static filter_ema temp_ema;
+static filter_hyst temp_hyst;		//temp[0]
+static filter_confirm gear_confirm;	//gear shown, GEAR_NONE until the first one is confirmed
+#define GEAR_NONE	0xFF		//not a gear value, shown as "-"
+
+//power on self-test (tacho_boot), one step every TACHO_BOOT_STEP_MS. The display belongs to it until BOOT_DONE
+#define BOOT_LEDS	9	//steps 0-7: segments one by one, 8: all OFF, 9-15: LEDs from bottom to top
+#define BOOT_OFF	16	//all OFF
+#define BOOT_SWITCH	17	//the tacho remains OFF until the switch is pressed and released
+#define BOOT_DONE	23	//0,5s after the switch
+static uint8_t boot_step;
+static uint8_t boot_switch;		//switch pressed and released during the self-test
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Show a value of display7seg on the gear display, unless the self-test is running
+**           Mostra un valor al display de la marxa, excepte durant el test inicial
+** Parameters: index of display7seg
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+static void gear_show(uint8_t idx){
+	if(boot_step==BOOT_DONE){
+		GEAR_7SEG=display7seg[idx];
+	}
+}
+
+/***************************************************************************
+**   Frame handlers. They are called by frame_dispatch() with the message
+**   buffer of a frame whose header matches their row on frame_table
+***************************************************************************/
+
+//rpm: median of 3 and EMA on rpm[1]. Engine ON/OFF when TACHO_ENGON_CONFIRM frames in a row are on the other side of TACHO_ENGON_RPM
+static void frame_rpm(uint8_t *msg){
+	unsigned int raw;
+	uint8_t on;
+
+	raw= (((unsigned char)msg[4]*0x100+(unsigned char)msg[5])>>2);			//0x100=256dec, /4
+	rpm[1]=filter_ema_run(&rpm_ema,filter_median_run(&rpm_median,raw),TACHO_RPM_EMA);
+	on=engon;
+	if (raw>TACHO_ENGON_RPM){
+		on=1;
+	}else if (raw<TACHO_ENGON_RPM){
+		on=0;
+	}
+	engon=(char)filter_confirm_run(&engon_confirm,on,TACHO_ENGON_CONFIRM);
+}
+
+//Gear: the display changes when the same gear has been received TACHO_GEAR_CONFIRM times in a row
+static void frame_gear(uint8_t *msg){
+	uint8_t gear;
+
+	//current gear, 0xXX = 0x02,0x04,0x08,0x10,0x20, for gears 1-5
+	gear=(uint8_t)filter_confirm_run(&gear_confirm,msg[4],TACHO_GEAR_CONFIRM);
+	if(mode==3){
+		gear_show(10);
+	}else if(gear==0x00){
+		gear_show(0);
+	}else if(gear==0x02){
+		gear_show(1);
+	}else if(gear==0x04){
+		gear_show(2);
+	}else if(gear==0x08){
+		gear_show(3);
+	}else if(gear==0x10){
+		gear_show(4);
+	}else if(gear==0x20){
+		gear_show(5);
+	}else{
+		gear_show(17);	//GEAR_NONE or unknown value
+	}
+}
+
+//Engine Temp
+static void frame_temp(uint8_t *msg){
+	uint8_t t;
+
+	t=(unsigned char)msg[4];
+	if (t<40){
+		t=40;		//below 0 degrees shown as 0, a negative value would overflow the EMA
+	}
+	temp[1]=filter_ema_run(&temp_ema,t-40,TACHO_TEMP_EMA);
+}
+
+//Speed
+static void frame_speed(uint8_t *msg){
+	speed[1]=filter_ema_run(&speed_ema,(((unsigned char)msg[4]*0x100+(unsigned char)msg[5])>>7),TACHO_SPEED_EMA);		//0x100=256dec, /128
+}
+
+//Answer of the ECM to a diagnostic request, decoded by the handler of its PID on tacho_params
+static void frame_diag(uint8_t *msg){
+	diag_response(msg,recv_nbytes);
+}
+
+//Frame of a block transfer of the ECM (memory read...), reassembled and sent to the PC
+static void frame_block(uint8_t *msg){
+	block_frame(msg,recv_nbytes);
+}
+
+/***************************************************************************
+**   Stale handlers. Called by tacho_stale() when the frame of their row has
+**   not been received for TACHO_STALE_MS (ECU off, wire cut...)
+***************************************************************************/
+
+//rpm: engine stopped
+static void stale_rpm(void){
+	rpm[1]=0;
+	engon=0;
+	filter_median_init(&rpm_median);
+	filter_ema_init(&rpm_ema);
+	filter_confirm_init(&engon_confirm,0);
+}
+
+//Gear: "-" as before the first frame
+static void stale_gear(void){
+	filter_confirm_init(&gear_confirm,GEAR_NONE);
+	if(mode==3){
+		gear_show(10);
+	}else{
+		gear_show(17);
+	}
+}
+
+static void stale_temp(void){
+	temp[1]=0;
+	filter_ema_init(&temp_ema);
+}
+
+static void stale_speed(void){
+	speed[1]=0;
+	filter_ema_init(&speed_ema);
+}
+
+//the answers are not broadcast, each parameter has its own age (diag_fresh)
+static void stale_diag(void){
+}
+
+//a block transfer only comes when it has been asked for, its timeout is on block_task
+static void stale_block(void){
+}
+
+/***************************************************************************
+**   Parameters requested to the ECM (diag.c), order of TACHO_PARAM_xxx.
+**   Handlers of the answer data. To request a new parameter add one row.
+***************************************************************************/
+
+//Engine load, 0-255 = 0-100%
+static void param_load(uint8_t *data){
+	load=(uint8_t)(((uint16_t)data[0]*100+127)/255);
+}
+
+//Intake air temperature, C + 40 as received
+static void param_iat(uint8_t *data){
+	iat=data[0];
+}
+
+static diag_param tacho_params[TACHO_PARAMS] = {
+	DIAG_PARAM(0x04, 1, TACHO_LOAD_MS, param_load),
+	DIAG_PARAM(0x0F, 1, TACHO_IAT_MS, param_iat)
+};
+
+/***************************************************************************
+**   Frames decoded by the tacho. Key is the header (priority, target,
+**   source, mode) packed in 32 bits. Rows MUST be sorted by key, they are
+**   found with a binary search. To decode a new parameter add one row.
+***************************************************************************/
+#define FRAME_KEY(prio,target,source,mod)	(((uint32_t)(prio)<<24) | ((uint32_t)(target)<<16) | ((uint16_t)(source)<<8) | (mod))
+
+typedef struct {
+	uint32_t key;			//FRAME_KEY of the header
+	uint8_t len;			//minimum number of bytes used by the handler
+	void (*handler)(uint8_t *msg);	//decode function
+	void (*stale)(void);		//called when the frame has not been received for TACHO_STALE_MS
+} frame_entry;
+
+const rom frame_entry frame_table[] = {
+	{FRAME_KEY(0x28,0x1B,0x10,0x02), 6, frame_rpm, stale_rpm},	//rpm
+	{FRAME_KEY(0x48,0x29,0x10,0x02), 6, frame_speed, stale_speed},	//speed
+	{FRAME_KEY(DIAG_RSP_PRIO,DIAG_RSP_TARGET,DIAG_ECU,DIAG_MODE_ANSWER), 6, frame_diag, stale_diag},	//diagnostic answers
+	{FRAME_KEY(BLOCK_PRIO,DIAG_TESTER,DIAG_ECU,BLOCK_MODE_MEMORY), BLOCK_DATA+1, frame_block, stale_block},	//memory read
+	{FRAME_KEY(BLOCK_PRIO,DIAG_TESTER,DIAG_ECU,BLOCK_MODE_DATA), BLOCK_DATA+1, frame_block, stale_block},	//data block read
+	{FRAME_KEY(0xA8,0x3B,0x10,0x03), 5, frame_gear, stale_gear},	//gear
+	{FRAME_KEY(0xA8,0x49,0x10,0x10), 5, frame_temp, stale_temp}	//engine temp
+};
+#define FRAME_TABLE_LEN	(sizeof(frame_table)/sizeof(frame_table[0]))	//up to 8 rows (frame_stale)
+#define FRAME_ROW_RPM	0	//row of frame_rpm
+
+static uint16_t frame_time[FRAME_TABLE_LEN];	//last time (sched_now) each row was received
+static uint8_t frame_stale;			//rows whose value is too old, bit per row
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Find the header of a frame on frame_table and call its handler. Frames not on the table
+**           (most of the bus traffic) are rejected after the search, without comparing byte by byte
+**           Busca la capcalera de la trama a frame_table i crida la seva funcio
+** Parameters: Pointer to frame buffer, frame length / Punter al missatge al buffer, numero bytes del missatge
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+static void frame_dispatch(uint8_t *msg, uint8_t nbytes){
+	uint32_t key;
+	uint8_t lo, hi, mid;
+
+	if (nbytes<4){
+		return;		//not even a header
+	}
+	key=FRAME_KEY(msg[0],msg[1],msg[2],msg[3]);
+	lo=0;
+	hi=FRAME_TABLE_LEN;
+	while (lo<hi){
+		mid=(lo+hi)>>1;
+		if (frame_table[mid].key==key){
+			if (nbytes>=frame_table[mid].len){
+				frame_table[mid].handler(msg);
+				frame_time[mid]=sched_now();
+				frame_stale&=~(1<<mid);
+			}
+			return;
+		}else if (frame_table[mid].key<key){
+			lo=mid+1;
+		}else{
+			hi=mid;
+		}
+	}
+}
+
+
+//main loop variables
+static uint8_t blink_off;		//RPM bar OFF phase of the blinking
+static uint8_t ledArray[5];		//array for Display
+static unsigned char digits[4];		//calculation of the 4 digits for the 4x7segments
+static int brightness;			//value for light intensity for MM5450
+
+//7 segment common annode. PORT Values for 7 6 5 ...2 1 0 bits for values from 0 to 9, OFF, 7x RPM bar status(idle, 1000,...,6000) i E (d'error)
+//On ROM with the bit order of the MM5450 outputs (MM5450_GLYPH), each digit is a ledArray byte
+static const rom uint8_t display4x7seg[20] = {
+	MM5450_GLYPH(0b11111100),MM5450_GLYPH(0b01100000),MM5450_GLYPH(0b11011010),MM5450_GLYPH(0b11110010),MM5450_GLYPH(0b01100110),	// 0-4
+	MM5450_GLYPH(0b10110110),MM5450_GLYPH(0b10111110),MM5450_GLYPH(0b11100000),MM5450_GLYPH(0b11111110),MM5450_GLYPH(0b11110110),	// 5-9
+	MM5450_GLYPH(0b00000000),											// 10: OFF
+	MM5450_GLYPH(0b00000010),MM5450_GLYPH(0b00000110),MM5450_GLYPH(0b00001110),MM5450_GLYPH(0b00011110),				// 11-14: RPM bar
+	MM5450_GLYPH(0b00111110),MM5450_GLYPH(0b01111110),MM5450_GLYPH(0b11111110),							// 15-17: RPM bar
+	MM5450_GLYPH(0b00111110),											// 18: E
+	MM5450_GLYPH(0b00000010)											// 19: -
+};
+#define DIGIT_DP	MM5450_GLYPH(0b00000001)	//decimal point, ORed on the ledArray byte of the digit
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Power on self-test, task every TACHO_BOOT_STEP_MS. Lights the segments of the 4 digits
+**           and of the gear display one by one, then the LEDs from bottom to top, and waits for the
+**           switch with the display OFF. The frames are received and decoded meanwhile
+**           Test inicial dels segments i LEDs, sense aturar la recepcio de trames
+** Parameters: none
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+static void tacho_boot(void){
+	if(boot_step==BOOT_DONE){
+		return;
+	}
+
+	if(boot_step<BOOT_LEDS-1){		//segment a, b,... dp of the 4 digits
+		ledArray[0]=1<<boot_step;
+		ledArray[1]=ledArray[0];
+		ledArray[2]=ledArray[0];
+		ledArray[3]=ledArray[0];
+		ledArray[4]=0b00000000;
+		//As Gear 7seg display does not have DP, this if will prevent to show strange value
+		if(boot_step==7){
+			GEAR_7SEG=display7seg[10];
+		}else{
+			GEAR_7SEG=display7seg[11+boot_step];
+		}
+	}else if(boot_step==BOOT_LEDS){		//Light ON from bottom to top LED
+		RPM_BAR=0;	//0V --> RPM bar will work
+		DIG3=1;		//5v --> Digit3 will not work
+		ledArray[0]=0b00000000;
+		ledArray[1]=0b00000000;
+		ledArray[2]=0b00000000;
+		ledArray[3]=0b01000000;
+		ledArray[4]=0b01000000;
+		LED_MODE2=1;
+	}else if(boot_step==BOOT_LEDS+1){
+		ledArray[3]=0b01100000;
+	}else if(boot_step==BOOT_LEDS+2){
+		ledArray[3]=0b01110000;
+		ledArray[4]=0b11000000;
+		LED_MODE1=1;
+	}else if(boot_step==BOOT_LEDS+3){
+		ledArray[3]=0b11111000;
+	}else if(boot_step==BOOT_LEDS+4){
+		ledArray[2]=0b10000000;	
+		ledArray[3]=0b11111100;
+		LED_MODE0=1;
+	}else if(boot_step==BOOT_LEDS+5){
+		ledArray[0]=0b10000000;
+		ledArray[3]=0b11111110;
+	}else if(boot_step==BOOT_LEDS+6){
+		ledArray[3]=0b11111111;
+	}else if(boot_step==BOOT_LEDS-1 || boot_step==BOOT_OFF){	//All OFF
+		ledArray[0]=0x00;
+		ledArray[1]=0x00;
+		ledArray[2]=0x00;
+		ledArray[3]=0x00;
+		ledArray[4]=0x00;
+		GEAR_7SEG=display7seg[10];	//Gear display OFF
+		LED_MODE0=0;		//LEDs OFF
+		LED_MODE1=0;
+		LED_MODE2=0;
+		RPM_BAR=1;		//5V --> RPM bar will not work
+		DIG3=0;			//0v --> Digit3 will work
+	}else if(boot_step==BOOT_SWITCH){	//until switch is not depressed, Digital Tacho will remain OFF
+		if(!boot_switch){
+			return;
+		}
+	}else if(boot_step==BOOT_DONE-1){	//Tacho ON
+		boot_step=BOOT_DONE;
+		LED_MODE0=1;		//mode 0 (RPM)
+		gear_show(17);		//"-" until the next gear frame
+		return;
+	}
+	if(boot_step<=BOOT_OFF){
+		MM5450_update(ledArray);
+	}
+	boot_step=boot_step+1;
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Initial values of the decoded data, start of the tasks and first step of the self-test.
+**           The tick has to be running (sched_init)
+**           Valors inicials, engegada de les tasques i primer pas del test. El tic ha d'estar en marxa
+** Parameters: none
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+void tacho_init(void){
+	//arrays init
+	digits[0]=8;	
+	digits[1]=8;
+	digits[2]=8;
+	digits[3]=8;
+	
+	rpm[0]=0;
+	rpm[1]=0;
+
+	speed[0]=0;
+	speed[1]=0;
+
+	temp[0]=0;
+	temp[1]=0;
+
+	engon=0;		//Engine OFF
+
+	//filters empty, the first frame is taken as it is
+	filter_median_init(&rpm_median);
+	filter_ema_init(&rpm_ema);
+	filter_hyst_init(&rpm_hyst);
+	filter_confirm_init(&engon_confirm,0);
+	filter_ema_init(&speed_ema);
+	filter_hyst_init(&speed_hyst);
+	filter_ema_init(&temp_ema);
+	filter_hyst_init(&temp_hyst);
+	filter_confirm_init(&gear_confirm,GEAR_NONE);	//"-" until a gear is confirmed
+	fuel_init();
+	load=0;
+	iat=0;
+
+	//System auxiliar variables init
+	recv_nbytes=0x50; 	//0b 1010 0000
+	blink_off=0;
+	brightness=BRIGHTNESS_HIGH;	//set by main() before the boot test
+	mode=0;			//initial mode=0 (RPM), LED_MODE0 is set at the end of the self-test
+
+	frame_stale=0xFF;	//nothing received yet, gear shows "-" until the first frame (recv_nbytes)
+
+	boot_step=0;
+	boot_switch=0;
+	sched_start(tacho_tasks,TACHO_TASKS);
+	diag_start(tacho_params,TACHO_PARAMS);	//first requests on the first run of diag_task
+	block_init();
+	tacho_boot();		//first step now, the next ones every TACHO_BOOT_STEP_MS
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Rear switch events (button.c), task every TACHO_BUTTON_MS. A short press changes the
+**           mode, a long one the brightness. Both act when the switch is released
+**           Polsador. Una pulsacio curta canvia el mode, una llarga la intensitat
+** Parameters: none
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+static void tacho_button(void){
+	uint8_t event;
+
+	event=button_get();
+	if(event==BUTTON_NONE || event==BUTTON_PRESS){
+		return;		//nothing to do until the switch is released
+	}
+	if(boot_step!=BOOT_DONE){	//self-test, only a press and release to switch the tacho ON
+		boot_switch=1;
+		return;
+	}
+
+	/***********************************************************************************************************
+	***********************************   BRIGHTNESS AND MODE CHANGE   *****************************************
+	************************************************************************************************************/
+	if(event==BUTTON_SHORT){	//change of mode
+		if(mode==0){		//RPM
+			mode=1;		//--> Speed
+			LED_MODE0=0;
+			LED_MODE1=1;
+			LED_MODE2=0;
+		}else if(mode==1){	//Speed
+			mode=2;		//--> Temp
+			LED_MODE0=0;
+			LED_MODE1=0;
+			LED_MODE2=1;
+		}else if(mode==2){	//Temp
+			mode=3;		//--> Fuel consump
+			LED_MODE0=0;
+			LED_MODE1=0;
+			LED_MODE2=0;
+		}else if(mode==3){	//Fuel consump
+			mode=0;		//--> RPM
+			LED_MODE0=1;
+			LED_MODE1=0;
+			LED_MODE2=0;
+		}
+	}else{			//BUTTON_LONG
+		//max value=120, but for safety reasons (too much heat) is software limited to 60
+		//brightness=brightness+10;
+		if(brightness==BRIGHTNESS_HIGH){		
+			brightness=BRIGHTNESS_LOW;
+		}else if(brightness==BRIGHTNESS_LOW){
+			brightness=BRIGHTNESS_HIGH;					
+		} //values will be either 10 or 60
+		SetDCPWM1(brightness);
+	}
+	/**************************************************************************************************/
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Decode the oldest received frame, if any
+**           Descodifica la trama rebuda mes antiga
+** Parameters: none
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+static void tacho_frames(void){
+	j1850_frame *frame;		//received frame being decoded (0 if none)
+	BENCH_MARK(mark)
+
+	frame=j1850_ring_rd();		//oldest frame not decoded yet, each frame is decoded only once
+	if (frame!=0){
+		recv_nbytes=frame->len;
+	}
+
+	if (recv_nbytes & 0x50){	//Until first signal is not received it will show a "-"
+		gear_show(17);		// "-"
+	}else{
+		if(recv_nbytes & 0x80){	//in case of error
+			//rpm[1]=(recv_nbytes && 0x0F);
+		}else if(frame!=0){
+			stats_frame(frame->data,frame->len);	//frames per header
+			diag_frame(frame->len);			//bus load
+			BENCH_BEGIN(mark)
+			frame_dispatch(frame->data,frame->len);	//rpm, gear, temp or speed (see frame_table)
+			BENCH_END(BENCH_DECODE,mark)
+		}
+	}
+	if (frame!=0){
+		j1850_ring_release();	//slot free again for the ISR
+	}
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Value to show, the EMA of a value (with its fraction bits) through its hysteresis, rounded
+**           Valor a mostrar, la mitjana amb histeresi i arrodonida
+** Parameters: hysteresis, EMA, shift of the EMA, band in 1/2^shift units
+** Returns: value
+**---------------------------------------------------------------------------
+*/
+static unsigned int show_value(filter_hyst *hyst, filter_ema *ema, uint8_t shift, uint16_t band){
+	return (filter_hyst_run(hyst,ema->acc,band)+((1<<shift)>>1))>>shift;
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Compute the digits and the RPM bar of the current mode and send them to the MM5450,
+**           task every TACHO_REFRESH_MS
+**           Calcula els digits i la barra de RPM i els envia al MM5450
+** Parameters: none
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+static void tacho_refresh(void){
+	uint16_t fuel=FUEL_NONE;	//mode 3 value
+	BENCH_MARK(mark)
+
+	if(boot_step!=BOOT_DONE){
+		return;		//the display belongs to the self-test
+	}
+	BENCH_BEGIN(mark)
+
+	//Modify ledArray to show the values we want in all 7 Segments connected to MICREL
+	//Digit[3] is the one showing thousands and digit[0] is the one showing units (it will be fixed to 0 for rpm)
+	//Decimal point is in Digit[1] and it can be activated
+
+	//values to show, they only move when the filtered value is more than a band away (no flicker between two digits)
+	temp[0]=show_value(&temp_hyst,&temp_ema,TACHO_TEMP_EMA,TACHO_TEMP_BAND);
+	speed[0]=show_value(&speed_hyst,&speed_ema,TACHO_SPEED_EMA,TACHO_SPEED_BAND);
+	rpm[0]=show_value(&rpm_hyst,&rpm_ema,TACHO_RPM_EMA,TACHO_RPM_BAND);
+	//averages of the fuel consumption, on every mode. rpm corrected with the answers of the ECM, if recent
+	fuel_update(fuel_air(rpm[1],
+		diag_fresh(&tacho_params[TACHO_PARAM_LOAD])?load:FUEL_UNKNOWN,
+		diag_fresh(&tacho_params[TACHO_PARAM_IAT])?iat:FUEL_UNKNOWN),speed[1]);
+	
+	//show (or not) the RPM bar and set the value for digit3
+	if(mode==1 || mode==2){	//mode 1, 2 RPM bar i 7seg
+		RPM_BAR=0;	//0V --> RPM bar will work
+		DIG3=1;		//5v --> digit3 will not work
+		
+		if(rpm[0]<700){
+			digits[3]=10;
+		}else if(rpm[0]>=700 && rpm[0]<1500){	//yellow
+			digits[3]=11;
+		}else if(rpm[0]>=1500 && rpm[0]<2500){  //yellow
+			digits[3]=12;
+		}else if(rpm[0]>=2500 && rpm[0]<3500){  //green
+			digits[3]=13;
+		}else if(rpm[0]>=3500 && rpm[0]<4000){  //green
+			digits[3]=14;
+		}else if(rpm[0]>=4000 && rpm[0]<4500){  //yellow
+			digits[3]=15;
+		}else if(rpm[0]>=4500 && rpm[0]<5000){  //yellow
+			digits[3]=16;
+		}else if(rpm[0]>=5000 && rpm[0]<5500){  //red
+			digits[3]=17;
+		}else if(rpm[0]>=5500){			//red, blinking above 6500 (tacho_blink)
+			if(blink_off){
+				digits[3]=10;
+			}else{
+				digits[3]=17;
+			}
+		}else{
+			//off due to shouldn't enter here
+			digits[3]=10;
+		}
+
+		
+	}else if(mode==0 || mode==3 ){	//RPM normal
+		RPM_BAR=1;	//5V --> RPM bar will not work
+		DIG3=0;		//0v --> Digit3 will work
+		
+	}
+	//end setting the RPM bar
+
+	//setting digit 2,1 amd 0 values for each mode
+	if(mode==0){
+		bcd_rpm(rpm[0],digits);		//rounded to 50 rpm, 800 at idle
+	}else if(mode==1){  //Speed
+		bcd_value(speed[0],digits);	// e.g. 1237 --> 2 3 7 on digits 2..0 (digit 3 is the RPM bar)
+	}else if(mode==2){		//Temperature
+		bcd_value(temp[0],digits);
+	}else if(mode==3){	//Fuel consumption, x10 on FUEL_UNITS (fuel.c)
+		//Estimation from rpm and speed, corrected with load and air temperature by fuel_air() when DIAG asks for them (diag.c)
+		fuel=fuel_average();
+		if(fuel==FUEL_NONE){	//stopped: "---"
+			digits[0]=19;
+			digits[1]=19;
+			digits[2]=19;
+		}else{
+			bcd_value(fuel,digits);	// e.g. 75 --> 7.5
+			if(digits[1]==BCD_OFF){
+				digits[1]=0;		//0.x
+			}
+		}
+		digits[3]=10;		//digit OFF, up to 99.9
+	}
+
+	//Modify the bits of ledArray. Once finished, only need to send it to MIcrel
+	ledArray[0]=display4x7seg[digits[0]];	//DIGIT 0
+	ledArray[1]=display4x7seg[digits[1]];	//DIGIT 1
+	if(mode==3 && fuel!=FUEL_NONE){
+		ledArray[1]|=DIGIT_DP;			//one decimal
+	}
+	ledArray[2]=display4x7seg[digits[2]];	//DIGIT 2
+	ledArray[3]=display4x7seg[digits[3]];	//DIGIT 3 or RPM bar
+	//Still free ledArray[4] (outputs 33-35).
+	//Add code if you want to use them for Fuel tank level
+	
+	//Array sent once it is complete, and only if it has changed
+	MM5450_update(ledArray);
+	BENCH_END(BENCH_REFRESH,mark)
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: RPM bar blinking, task every TACHO_BLINK_MS. Above 6500 rpm the bar changes between
+**           all ON and OFF, it starts ON
+**           Parpelleig de la barra de RPM per sobre de 6500 rpm
+** Parameters: none
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+static void tacho_blink(void){
+	if(rpm[0]<6500){
+		blink_off=0;
+	}else{
+		blink_off=!blink_off;
+	}
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Stale data, task every TACHO_STALE_CHECK_MS. Calls the stale handler of each row of
+**           frame_table not received for TACHO_STALE_MS, once until it is received again
+**           Dades massa antigues, crida la funcio stale de les trames que no arriben
+** Parameters: none
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+static void tacho_stale(void){
+	uint16_t now;
+	uint8_t i, bit;
+
+	now=sched_now();
+	for (i=0,bit=1;i<FRAME_TABLE_LEN;i++,bit<<=1){
+		if (!(frame_stale & bit) && (uint16_t)(now-frame_time[i])>=TACHO_STALE_MS){
+			frame_stale|=bit;
+			frame_table[i].stale();
+		}
+	}
+}
+
+//tasks of the main loop, run by sched_run() (order of TACHO_TASK_xxx)
+sched_task tacho_tasks[TACHO_TASKS] = {
+	SCHED_TASK(tacho_refresh, TACHO_REFRESH_MS),
+	SCHED_TASK(tacho_blink, TACHO_BLINK_MS),
+	SCHED_TASK(tacho_button, TACHO_BUTTON_MS),
+	SCHED_TASK(tacho_stale, TACHO_STALE_CHECK_MS),
+	SCHED_TASK(tacho_boot, TACHO_BOOT_STEP_MS),
+	SCHED_TASK(j1850_cal_update, J1850_CAL_MS),
+	SCHED_TASK(stats_task, STATS_MS),
+	SCHED_TASK(bench_task, BENCH_MS),
+	SCHED_TASK(diag_task, DIAG_MS),
+	SCHED_TASK(block_task, BLOCK_MS)
+};
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: State of the tacho, for the PC simulation and the statistics
+**           Estat del tacometre
+** Parameters: none
+** Returns: TACHO_STATUS_xxx bits
+**---------------------------------------------------------------------------
+*/
+uint8_t tacho_status(void){
+	uint8_t status;
+
+	status=0;
+	if(boot_step!=BOOT_DONE){
+		status|=TACHO_STATUS_BOOT;
+	}
+	if(!(frame_stale & (1<<FRAME_ROW_RPM))){
+		status|=TACHO_STATUS_RPM;
+	}
+	return status;
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: One pass of the main loop: received frames, then the tasks whose time has come
+**           (display refresh, blinking, switch and stale data)
+**           Una passada del bucle principal
+** Parameters: none
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+void tacho_loop(void){
+	stats_loop();	//period of the main loop
+	tacho_frames();
+	sched_run(tacho_tasks,TACHO_TASKS);
+}
@@ -0,0 +1,83 @@
+/*************************************************************************
+**  HARLEY DAVIDSON Sportster 883/1200 - J1850 VPW Interface
+**  Released under GNU GENERAL PUBLIC LICENSE
+**  Main MCU: MICROCHIP PIC18F2553
+**  Homepage: www.momex.cat
+**  Contact: morales.xavier@momex.cat
+**
+**
+**  Revision History
+**  11/06/2016   XM  v1.00   Initial Release on Github
+**
+**
+**   NOTE: Decode and display part of the tacho (tacho.c), shared by the
+**         PIC main() and the PC simulation.
+**         Descodificacio i visualitzacio, comu al PIC i a la simulacio.
+**************************************************************************/
+
+#ifndef __TACHO_H__	//if tacho.h has not been defined--> define it || if yes --> do nothing
+#define __TACHO_H__
+
+#include "macros.h"
+#include "sched.h"
+
+// PWM duty of the MM5450 brightness, a long press of the switch changes between both
+// max value=120, but for safety reasons (too much heat) is software limited to 60
+#define BRIGHTNESS_HIGH	60
+#define BRIGHTNESS_LOW	10
+
+// tasks of the main loop (tacho_tasks), periods in ms
+#define TACHO_TASK_REFRESH	0	// display refresh
+#define TACHO_TASK_BLINK	1	// RPM bar blinking
+#define TACHO_TASK_BUTTON	2	// rear switch
+#define TACHO_TASK_STALE	3	// stale data timeouts
+#define TACHO_TASK_BOOT		4	// power on self-test of the display
+#define TACHO_TASK_CAL		5	// thresholds of the J1850 receiver (j1850_cal.c)
+#define TACHO_TASK_STATS	6	// commands of the PC and statistics record (stats.c)
+#define TACHO_TASK_BENCH	7	// results of the benchmark build (bench.c), nothing on the normal build
+#define TACHO_TASK_DIAG		8	// diagnostic requests to the ECM (diag.c)
+#define TACHO_TASK_BLOCK	9	// block transfers of the ECM sent to the PC (block.c)
+#define TACHO_TASKS		10
+
+#define TACHO_REFRESH_MS	100
+#define TACHO_BLINK_MS		200
+#define TACHO_BUTTON_MS		10	// events of button.c, the switch itself is sampled by the tick (BUTTON_LONG_MS...)
+#define TACHO_STALE_CHECK_MS	100
+#define TACHO_STALE_MS		1000	// a value not received for this long is cleared (stale handlers of frame_table)
+#define TACHO_BOOT_STEP_MS	100
+
+// parameters requested to the ECM (tacho_params, diag.c), periods in ms at low bus load
+#define TACHO_PARAM_LOAD	0	// engine load, for the fuel consumption
+#define TACHO_PARAM_IAT		1	// intake air temperature, for the fuel consumption
+#define TACHO_PARAMS		2
+#define TACHO_LOAD_MS		200
+#define TACHO_IAT_MS		2000
+
+// filters of the decoded values (filter.c): shifts of the EMAs, bands of the hysteresis of the displayed
+// values and samples in a row needed to change the gear and the engine state. The hysteresis is run on the
+// EMA with its fraction bits, so the bands are in 1/2^shift units
+#define TACHO_RPM_EMA		1	// rpm: median of 3 (one wrong frame), then EMA
+#define TACHO_RPM_BAND		50	// 25 rpm, half of the 50 rpm step of the display
+#define TACHO_SPEED_EMA		2
+#define TACHO_SPEED_BAND	3	// 0.75 km/h
+#define TACHO_TEMP_EMA		2
+#define TACHO_TEMP_BAND		3	// 0.75 degrees
+#define TACHO_GEAR_CONFIRM	3
+#define TACHO_ENGON_CONFIRM	4
+#define TACHO_ENGON_RPM		500	// engine ON above it, OFF below it
+
+// tacho_status() bits
+#define TACHO_STATUS_BOOT	0x01	// self-test running or waiting for the switch, the display is not used yet
+#define TACHO_STATUS_RPM	0x02	// rpm received and not stale
+
+// gear display, values for 7 6 5 ...2 1 0 bits of port B
+extern const rom char display7seg[18];
+
+extern sched_task tacho_tasks[TACHO_TASKS];
+
+//Function Prototypes
+extern void tacho_init(void);
+extern void tacho_loop(void);
+extern uint8_t tacho_status(void);
+
+#endif // __TACHO_H__
@@ -0,0 +1,94 @@
+/*************************************************************************
+**  HARLEY DAVIDSON Sportster 883/1200 - J1850 VPW Interface
+**  Released under GNU GENERAL PUBLIC LICENSE
+**  Main MCU: MICROCHIP PIC18F2553
+**  Homepage: www.momex.cat
+**  Contact: morales.xavier@momex.cat
+**
+**
+**  Revision History
+**  11/06/2016   XM  v1.00   Initial Release on Github
+**
+**
+**   NOTE: The only writer of the ring is the low priority RX interrupt and
+**         the only reader is the main loop, rx_head is only written by the
+**         interrupt and rx_tail by the main loop (same as j1850_ring.c).
+**************************************************************************/
+
+#include "hal.h"
+#include "usart_rx.h"
+#include "macros.h"
+
+#define RX_MASK	(USART_RX_SIZE - 1)
+
+static uint8_t rx_buf[USART_RX_SIZE];
+static volatile uint8_t rx_head;	// next byte to be written
+static volatile uint8_t rx_tail;	// next byte to be read
+volatile uint8_t usart_rx_dropped;
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Empty the ring and enable the RX interrupt as low priority. The USART has to be opened
+**           with continuous reception (USART_CONT_RX)
+**           Buida la cua i activa la interrupcio RX com a baixa prioritat
+** Parameters: none
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+void usart_rx_init(void)
+{
+	rx_head = 0;
+	rx_tail = 0;
+	usart_rx_dropped = 0;
+	IPR1bits.RCIP = 0;	// RX interrupt on low priority
+	PIE1bits.RCIE = 1;
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Main loop side. Oldest received byte
+**           Costat del bucle principal. Byte rebut mes antic
+** Parameters: none
+** Returns: byte, 0 if nothing has been received (the commands are never 0)
+**---------------------------------------------------------------------------
+*/
+uint8_t usart_rx_get(void)
+{
+	uint8_t ch;
+
+	if(rx_tail == rx_head) return 0;
+	ch = rx_buf[rx_tail];
+	rx_tail = (rx_tail + 1) & RX_MASK;
+	return ch;
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: RX part of the low priority ISR, takes the received byte. After an overrun the USART
+**           stops receiving, it is restarted and the lost bytes are counted
+**           Part de la ISR de baixa prioritat, llegeix el byte rebut
+** Parameters: none
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+void usart_rx_isr(void)
+{
+	uint8_t ch, next;
+
+	if(!PIE1bits.RCIE || !PIR1bits.RCIF) return;
+
+	ch = usart_rx_read();
+	if(usart_rx_overrun())
+	{
+		usart_rx_restart();
+		++usart_rx_dropped;
+	}
+	next = (rx_head + 1) & RX_MASK;
+	if(next == rx_tail)	// ring full, the main loop has not read the commands
+	{
+		++usart_rx_dropped;
+		return;
+	}
+	rx_buf[rx_head] = ch;
+	rx_head = next;
+}
@@ -0,0 +1,33 @@
+/*************************************************************************
+**  HARLEY DAVIDSON Sportster 883/1200 - J1850 VPW Interface
+**  Released under GNU GENERAL PUBLIC LICENSE
+**  Main MCU: MICROCHIP PIC18F2553
+**  Homepage: www.momex.cat
+**  Contact: morales.xavier@momex.cat
+**
+**
+**  Revision History
+**  11/06/2016   XM  v1.00   Initial Release on Github
+**
+**
+**   NOTE: USART reception of the commands sent by the PC. The low priority
+**         RX interrupt (RCIF) writes each byte on a small ring, the main
+**         loop reads it with usart_rx_get().
+**         Recepcio de les comandes del PC per la USART.
+**************************************************************************/
+
+#ifndef __USART_RX_H__	//if usart_rx.h has not been defined--> define it || if yes --> do nothing
+#define __USART_RX_H__
+
+#include "macros.h"
+
+#define USART_RX_SIZE	8	// ring size in bytes, has to be a power of 2
+
+extern volatile uint8_t usart_rx_dropped;	// bytes lost, ring full or USART overrun
+
+//Function Prototypes
+extern void usart_rx_init(void);
+extern uint8_t usart_rx_get(void);
+extern void usart_rx_isr(void);
+
+#endif // __USART_RX_H__
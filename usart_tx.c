@@ -0,0 +1,319 @@
+/*************************************************************************
+**  HARLEY DAVIDSON Sportster 883/1200 - J1850 VPW Interface
+**  Released under GNU GENERAL PUBLIC LICENSE
+**  Main MCU: MICROCHIP PIC18F2553
+**  Homepage: www.momex.cat
+**  Contact: morales.xavier@momex.cat
+**
+**
+**  Revision History
+**  11/06/2016   XM  v1.00   Initial Release on Github
+**
+**
+**   NOTE: The only writer of the ring is the high priority ISR and the only
+**         reader is the low priority TX interrupt. tx_head is only written by
+**         the writer and tx_tail by the reader, so no interrupt is disabled.
+**         The main loop does not write on the ring, its records (answers to
+**         the PC commands) are sent by the TX interrupt from the caller's
+**         buffer, between two records of the ring (usart_tx_send).
+**************************************************************************/
+
+#include "hal.h"
+#include "j1850.h"
+#include "usart_tx.h"
+#include "macros.h"
+
+#define TX_MASK	(USART_TX_SIZE - 1)
+
+static uint8_t tx_buf[USART_TX_SIZE];
+static volatile uint8_t tx_head;	// next byte to be written
+static volatile uint8_t tx_tail;	// next byte to be sent
+volatile uint8_t usart_tx_dropped;
+
+static uint8_t *tx_rec;			// record of the main loop, next byte to be sent
+static volatile uint8_t tx_rec_left;	// bytes of tx_rec still to be sent + the SLIP_END, 0 if none
+static uint8_t tx_rec_esc;		// second byte of an escape still to be sent, 0 if none
+static uint8_t tx_ring_open;		// a record of the ring has been started and its SLIP_END not sent yet
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Empty the ring and set the TX interrupt as low priority. The USART has to be opened
+**           with OpenUSART(USART_TX_INT_OFF...), TXIE is only enabled while there is data to send
+**           Buida la cua i configura la interrupcio TX com a baixa prioritat
+** Parameters: none
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+void usart_tx_init(void)
+{
+	tx_head = 0;
+	tx_tail = 0;
+	usart_tx_dropped = 0;
+	tx_rec_left = 0;
+	tx_rec_esc = 0;
+	tx_ring_open = 0;
+	PIE1bits.TXIE = 0;
+	IPR1bits.TXIP = 0;	// TX interrupt on low priority
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Free bytes on the ring
+**           Bytes lliures a la cua
+** Parameters: none
+** Returns: number of bytes that can be written with usart_tx_put()
+**---------------------------------------------------------------------------
+*/
+uint8_t usart_tx_free(void)
+{
+	return (tx_tail - tx_head - 1) & TX_MASK;
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Write one byte on the ring and enable the TX interrupt. It does not wait, check
+**           usart_tx_free() before
+**           Escriu un byte a la cua. No espera, s'ha de comprovar usart_tx_free() abans
+** Parameters: byte to send
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+void usart_tx_put(uint8_t ch)
+{
+	tx_buf[tx_head] = ch;
+	tx_head = (tx_head + 1) & TX_MASK;
+	PIE1bits.TXIE = 1;	// TXIF is set while TXREG is empty, the interrupt starts at once
+}
+
+#if USART_LOG_BINARY
+/*
+**---------------------------------------------------------------------------
+** Abstract: Write one byte of a record with SLIP escaping
+**           Escriu un byte d'un registre amb la codificacio SLIP
+** Parameters: value
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+static void slip_put(uint8_t ch)
+{
+	if(ch == SLIP_END)
+	{
+		usart_tx_put(SLIP_ESC);
+		usart_tx_put(SLIP_ESC_END);
+	}
+	else if(ch == SLIP_ESC)
+	{
+		usart_tx_put(SLIP_ESC);
+		usart_tx_put(SLIP_ESC_ESC);
+	}
+	else
+	{
+		usart_tx_put(ch);
+	}
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Write a received frame as a binary record (see usart_tx.h). If the whole record does
+**           not fit on the ring, even with all the bytes escaped, the frame is dropped and counted
+**           Escriu una trama com un registre binari. Si no hi cap, es perd i es compta
+** Parameters: Pointer to frame buffer, frame length, status (J1850_RETURN_CODE_xxx), timestamp
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+void usart_tx_frame(uint8_t *msg_buf, uint8_t nbytes, uint8_t status, uint32_t timestamp)
+{
+	if(usart_tx_free() < 2 * (USART_LOG_HEADER + nbytes) + 1)
+	{
+		++usart_tx_dropped;
+		return;
+	}
+	slip_put(USART_LOG_FRAME);
+	slip_put(status);
+	slip_put(nbytes);
+	slip_put((uint8_t)timestamp);
+	slip_put((uint8_t)(timestamp >> 8));
+	slip_put((uint8_t)(timestamp >> 16));
+	slip_put((uint8_t)(timestamp >> 24));
+	while(nbytes--)
+	{
+		slip_put(*msg_buf++);
+	}
+	usart_tx_put(SLIP_END);
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Write a record that is not a frame (type on its first byte, see usart_tx.h). Dropped and
+**           counted like the frames if it does not fit on the ring
+**           Escriu un registre que no es una trama. Si no hi cap, es perd i es compta
+** Parameters: Pointer to the record, record length
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+void usart_tx_record(uint8_t *rec, uint8_t nbytes)
+{
+	if(usart_tx_free() < 2 * nbytes + 1)
+	{
+		++usart_tx_dropped;
+		return;
+	}
+	while(nbytes--)
+	{
+		slip_put(*rec++);
+	}
+	usart_tx_put(SLIP_END);
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Main loop side. Send a record (type on its first byte) from the caller's buffer. It is
+**           sent by the TX interrupt as soon as the record of the ring being sent is finished, the
+**           buffer has to be kept until usart_tx_busy() returns 0
+**           Costat del bucle principal. Envia un registre des del buffer de qui crida
+** Parameters: Pointer to the record, record length
+** Returns: 1 if the record will be sent, 0 if the previous one has not been sent yet
+**---------------------------------------------------------------------------
+*/
+uint8_t usart_tx_send(uint8_t *rec, uint8_t nbytes)
+{
+	if(tx_rec_left) return 0;
+	tx_rec = rec;
+	tx_rec_esc = 0;
+	tx_rec_left = nbytes + 1;	// publish, the TX interrupt can take it from now on
+	PIE1bits.TXIE = 1;
+	return 1;
+}
+#else
+/*
+**---------------------------------------------------------------------------
+** Abstract: Write one byte as 2 ASCII hex characters
+**           Escriu un byte com 2 caracters ASCII hexadecimals
+** Parameters: value
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+static void USART_hex2ascii(uint8_t val)
+{
+	uint8_t ascii1=val;
+	usart_tx_put( ((ascii1>>4)<10)?(ascii1>>4)+48 : (ascii1>>4)+55);
+	usart_tx_put( ((val&0x0f)<10)?(val&0x0f)+48 : (val&0x0f)+55);
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Write a received frame as hex bytes separated by spaces and terminated with CR.
+**           If the whole line does not fit on the ring the frame is dropped and counted
+**           Escriu una trama en hexadecimal separada per espais i acabada amb CR
+** Parameters: Pointer to frame buffer, frame length, status (only J1850_RETURN_CODE_OK is sent), timestamp (not sent)
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+void usart_tx_frame(uint8_t *msg_buf, uint8_t nbytes, uint8_t status, uint32_t timestamp)
+{
+	if(nbytes == 0 || status != J1850_RETURN_CODE_OK) return;
+	if(usart_tx_free() < 3 * nbytes)	// 2 hex characters + space or CR per byte
+	{
+		++usart_tx_dropped;
+		return;
+	}
+	while(--nbytes)
+	{
+		USART_hex2ascii(*msg_buf++);
+		usart_tx_put(0x20);	//space
+	}
+	USART_hex2ascii(*msg_buf);
+	usart_tx_put(0x0D);	//intro
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: The old format only has frames, other records are not sent
+**           El format antic nomes te trames, els altres registres no s'envien
+** Parameters: Pointer to the record, record length
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+void usart_tx_record(uint8_t *rec, uint8_t nbytes)
+{
+}
+
+uint8_t usart_tx_send(uint8_t *rec, uint8_t nbytes)
+{
+	return 1;
+}
+#endif // USART_LOG_BINARY
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: Main loop side. The record given to usart_tx_send() is still being sent
+**           Costat del bucle principal. El registre encara s'esta enviant
+** Parameters: none
+** Returns: 1 while the buffer is in use
+**---------------------------------------------------------------------------
+*/
+uint8_t usart_tx_busy(void)
+{
+	return tx_rec_left != 0;
+}
+
+/*
+**---------------------------------------------------------------------------
+** Abstract: TX part of the low priority ISR, sends one byte each time TXREG is empty
+**           Part de la ISR de baixa prioritat, envia un byte cada cop que TXREG es buit
+** Parameters: none
+** Returns: none
+**---------------------------------------------------------------------------
+*/
+void usart_tx_isr(void)
+{
+	uint8_t ch;
+
+	if(!PIE1bits.TXIE || !PIR1bits.TXIF) return;
+
+	if(tx_rec_left && !tx_ring_open)	// record of the main loop, SLIP encoded here
+	{
+		if(tx_rec_esc)
+		{
+			usart_tx_write(tx_rec_esc);
+			tx_rec_esc = 0;
+			--tx_rec_left;
+		}
+		else if(tx_rec_left == 1)
+		{
+			usart_tx_write(SLIP_END);
+			tx_rec_left = 0;	// the buffer is free
+		}
+		else
+		{
+			ch = *tx_rec++;
+			if(ch == SLIP_END)
+			{
+				usart_tx_write(SLIP_ESC);
+				tx_rec_esc = SLIP_ESC_END;
+			}
+			else if(ch == SLIP_ESC)
+			{
+				usart_tx_write(SLIP_ESC);
+				tx_rec_esc = SLIP_ESC_ESC;
+			}
+			else
+			{
+				usart_tx_write(ch);
+				--tx_rec_left;
+			}
+		}
+		return;
+	}
+
+	if(tx_tail != tx_head)
+	{
+		ch = tx_buf[tx_tail];
+		usart_tx_write(ch);
+		tx_ring_open = (ch != SLIP_END);	// the ring only has whole records, escaped inside
+		tx_tail = (tx_tail + 1) & TX_MASK;
+		return;
+	}
+	PIE1bits.TXIE = 0;	// ring empty
+	if(tx_tail != tx_head || tx_rec_left) PIE1bits.TXIE = 1;	// written meanwhile
+}
@@ -0,0 +1,67 @@
+/*************************************************************************
+**  HARLEY DAVIDSON Sportster 883/1200 - J1850 VPW Interface
+**  Released under GNU GENERAL PUBLIC LICENSE
+**  Main MCU: MICROCHIP PIC18F2553
+**  Homepage: www.momex.cat
+**  Contact: morales.xavier@momex.cat
+**
+**
+**  Revision History
+**  11/06/2016   XM  v1.00   Initial Release on Github
+**
+**
+**   NOTE: USART transmission ring. The high priority ISR writes the frames
+**         on the ring and the low priority TX interrupt (TXIF) sends them, so
+**         the J1850 reception never waits for the USART.
+**         Cua de transmissio de la USART buidada per la interrupcio TXIF.
+**************************************************************************/
+
+#ifndef __USART_TX_H__	//if usart_tx.h has not been defined--> define it || if yes --> do nothing
+#define __USART_TX_H__
+
+#include "macros.h"
+
+#define USART_TX_SIZE	128	// ring size in bytes, has to be a power of 2
+
+// Log format of the received frames
+// 1: binary records with SLIP framing (RFC 1055), see below. Decoded on the PC by host/usart_log.c
+// 0: old format, hex bytes separated by spaces and terminated with CR (only good frames)
+#ifndef USART_LOG_BINARY	// or -DUSART_LOG_BINARY=0
+#define USART_LOG_BINARY	1
+#endif
+
+// Binary record, sent SLIP encoded and terminated with SLIP_END:
+//   byte 0: record type (USART_LOG_FRAME)
+//   byte 1: status, J1850_RETURN_CODE_OK or J1850_RETURN_CODE_DATA_ERROR (wrong CRC)
+//   byte 2: number of frame bytes (0-12)
+//   byte 3-6: timestamp, Timer1 and its overflows (1.6us counts, sched_timestamp) when the frame was
+//             finished, low byte first
+//   byte 7-: frame bytes (CRC included)
+#define USART_LOG_FRAME		0x01
+#define USART_LOG_HEADER	7	// bytes before the frame bytes
+// Other records start with their type and are sent whole with usart_tx_record() (high priority ISR)
+// or usart_tx_send() (main loop):
+#define USART_LOG_CAL		0x02	// thresholds of the receiver, see j1850_cal.h
+#define USART_LOG_STATS		0x03	// answer to STATS_CMD_SEND, see stats.h
+#define USART_LOG_BENCH		0x04	// cycles of the benchmark build, see bench.h
+#define USART_LOG_BLOCK		0x05	// part of a block transfer of the ECM, see block.h
+
+#define SLIP_END	0xC0	// end of record
+#define SLIP_ESC	0xDB	// next byte is escaped
+#define SLIP_ESC_END	0xDC	// escaped SLIP_END
+#define SLIP_ESC_ESC	0xDD	// escaped SLIP_ESC
+
+// Policy when the ring is full: drop the newest frame (the whole record, so the log never has cut frames)
+extern volatile uint8_t usart_tx_dropped;	// frames and records not sent because the ring was full
+
+//Function Prototypes
+extern void usart_tx_init(void);
+extern uint8_t usart_tx_free(void);
+extern void usart_tx_put(uint8_t ch);
+extern void usart_tx_frame(uint8_t *msg_buf, uint8_t nbytes, uint8_t status, uint32_t timestamp);
+extern void usart_tx_record(uint8_t *rec, uint8_t nbytes);
+extern uint8_t usart_tx_send(uint8_t *rec, uint8_t nbytes);
+extern uint8_t usart_tx_busy(void);
+extern void usart_tx_isr(void);
+
+#endif // __USART_TX_H__